@@ -0,0 +1,82 @@
+// This file is a part of "Candle" application.
+// Copyright 2015-2016 Hayrullin Denis Ravilevich
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QByteArrayList>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTextStream>
+#include <functional>
+
+namespace Benchmark
+{
+    inline QTextStream &out()
+    {
+        static QTextStream stream(stdout);
+        return stream;
+    }
+
+    /// \brief best wall time of \a runs calls of \a fn, in milliseconds
+    inline double measure(std::function<void()> const &fn, int runs = 3)
+    {
+        double best = -1;
+        for (int i = 0; i < runs; i++) {
+            QElapsedTimer timer;
+            timer.start();
+            fn();
+            double const elapsed = timer.nsecsElapsed() / 1e6;
+            if (best < 0 || elapsed < best) best = elapsed;
+        }
+        return best;
+    }
+
+    struct Program
+    {
+        QString name;
+        QByteArrayList lines;
+    };
+
+    /// \brief programs from CANDLE_BENCHMARK_CORPUS file or directory, \a synthetic one if not set
+    inline QList<Program> corpus(std::function<Program()> const &synthetic)
+    {
+        QList<Program> programs;
+        QString const path = qEnvironmentVariable("CANDLE_BENCHMARK_CORPUS");
+
+        QStringList files;
+        if (QFileInfo(path).isDir()) {
+            for (QFileInfo const &info : QDir(path).entryInfoList({ "*.nc", "*.ncc", "*.ngc", "*.tap", "*.gc", "*.gcode", "*.txt" }, QDir::Files, QDir::Name))
+                files << info.filePath();
+        } else if (!path.isEmpty()) {
+            files << path;
+        }
+
+        for (QString const &fileName : files) {
+            QFile file(fileName);
+            if (!file.open(QIODevice::ReadOnly)) continue;
+
+            Program program;
+            program.name = QFileInfo(fileName).fileName();
+            while (!file.atEnd()) {
+                QByteArray const line = file.readLine().trimmed();
+                if (!line.isEmpty()) program.lines << line;
+            }
+            programs << program;
+        }
+
+        if (programs.isEmpty()) programs << synthetic();
+        return programs;
+    }
+
+    // Benchmarks, return false on failed result check
+    bool arcTessellation();
+    bool gcodeDrawer();
+    bool heightMapFile();
+    bool renderer();
+    bool sendPreprocessor();
+    bool timeEstimator();
+}
+
+#endif // BENCHMARK_H
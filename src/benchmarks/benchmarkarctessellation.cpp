@@ -0,0 +1,176 @@
+// This file is a part of "Candle" application.
+// Copyright 2015-2016 Hayrullin Denis Ravilevich
+
+#include <QMatrix4x4>
+#include <QtMath>
+#include <memory>
+#include "benchmark.h"
+#include "parser/gcodeparser.h"
+#include "parser/gcodepreprocessorutils.h"
+#include "parser/gcodeviewparse.h"
+
+using namespace Benchmark;
+
+namespace
+{
+    struct Arc
+    {
+        PointSegment::planes plane;
+        QVector3D start;
+        QVector3D end;
+        QVector3D center;
+        bool clockwise;
+        double radius;
+    };
+
+    // Pocket of small arcs in all planes: circles, arc chains and helices
+    Program syntheticProgram()
+    {
+        Program program;
+        program.name = "synthetic";
+        program.lines << "G21" << "G90" << "M3 S10000" << "G0 Z5" << "G0 X0 Y0";
+
+        for (int level = 1; level <= 10; level++) {
+            program.lines << "G17" << QString("G1 Z%1 F300").arg(-0.2 * level).toLatin1();
+            for (int i = 0; i < 2000; i++) {
+                double const r = 0.5 + (i % 37) * 0.25;
+                double const x = (i % 50) * 20.0;
+                double const y = (i / 50) * 20.0;
+                program.lines << QString("G1 X%1 Y%2 F1200").arg(x + r).arg(y).toLatin1();
+                program.lines << QString("G%1 X%2 Y%3 I%4 J0").arg(i % 2 ? 2 : 3).arg(x - r).arg(y).arg(-r).toLatin1();
+                program.lines << QString("G%1 X%2 Y%3 Z%4 I%5 J0").arg(i % 2 ? 2 : 3).arg(x + r).arg(y)
+                                 .arg(-0.2 * level - 0.1).arg(r).toLatin1();
+            }
+            program.lines << "G18" << "G0 X0 Y0 Z0";
+            for (int i = 0; i < 500; i++) program.lines << QString("G2 X%1 Z0 I1 K0").arg(2 * (i % 2 ? 0 : 1)).toLatin1();
+            program.lines << "G19" << "G0 Y0 Z0";
+            for (int i = 0; i < 500; i++) program.lines << QString("G3 Y%1 Z0 J1 K0").arg(2 * (i % 2 ? 0 : 1)).toLatin1();
+            program.lines << "G17" << "G0 Z5";
+        }
+        program.lines << "M5" << "M30";
+
+        return program;
+    }
+
+    std::unique_ptr<GcodeParser> parse(Program const &program)
+    {
+        auto parser = std::make_unique<GcodeParser>();
+        parser->setInteractive(false);
+        for (auto const &line : program.lines) parser->addCommand(GcodePreprocessorUtils::splitCommand(line));
+        return parser;
+    }
+
+    // Tessellation with rotation matrices and trigonometry per point, as it was done before recurrence
+    GcodePreprocessorUtils::vectoContainer referencePoints(Arc const &arc, double minArcLength, double arcPrecision,
+                                                           bool arcDegreeMode)
+    {
+        QMatrix4x4 m;
+        if (arc.plane == PointSegment::ZX) m.rotate(90, 1.0, 0.0, 0.0);
+        else if (arc.plane == PointSegment::YZ) m.rotate(-90, 0.0, 1.0, 0.0);
+
+        QVector3D const start = m.map(arc.start);
+        QVector3D const end = m.map(arc.end);
+        QVector3D const center = m.map(arc.center);
+        if (qIsNaN(center.length())) return {};
+
+        double radius = arc.radius;
+        if (radius == 0) radius = sqrt(pow(start.x() - center.x(), 2.0) + pow(end.y() - center.y(), 2.0));
+
+        double const startAngle = GcodePreprocessorUtils::getAngle(center, start);
+        double const sweep = GcodePreprocessorUtils::calculateSweep(startAngle, GcodePreprocessorUtils::getAngle(center, end),
+                                                                    arc.clockwise);
+        int const numPoints = arcDegreeMode && arcPrecision > 0 ? qMax(1.0, sweep / (M_PI * arcPrecision / 180))
+                                                                : static_cast<int>(ceil(sweep * radius / (arcPrecision > 0 ? arcPrecision : minArcLength)));
+
+        QMatrix4x4 const inverted = m.inverted();
+        GcodePreprocessorUtils::vectoContainer points;
+        for (int i = 1; i < numPoints; i++) {
+            double const angle = startAngle + (arc.clockwise ? -i : i) * sweep / numPoints;
+            points.push_back(inverted.map(QVector3D(cos(angle) * radius + center.x(), sin(angle) * radius + center.y(),
+                                                    start.z() + (end.z() - start.z()) * i / numPoints)));
+        }
+        points.push_back(arc.end);
+
+        return points;
+    }
+}
+
+bool Benchmark::arcTessellation()
+{
+    bool ok = true;
+    double const minArcLength = 0.1;
+
+    for (Program const &source : corpus(syntheticProgram)) {
+        for (double precision : { 0.1, 0.01 }) {
+
+            // Arcs of program
+            std::vector<Arc> arcs;
+            {
+                auto const parser = parse(source);
+                auto &list = parser->getPointSegmentList();
+                for (std::size_t i = 1; i < list.size(); i++) {
+                    if (!list[i].isArc()) continue;
+                    arcs.push_back({ list[i - 1].plane(), list[i - 1].point(), list[i].point(), list[i].center(),
+                                     list[i].isClockwise(), list[i].getRadius() });
+                }
+            }
+
+            // Recurrence against per point trigonometry
+            long long points = 0;
+            double const referenceTime = measure([&] {
+                points = 0;
+                for (auto const &arc : arcs) points += referencePoints(arc, minArcLength, precision, false).size();
+            });
+            double const recurrenceTime = measure([&] {
+                for (auto const &arc : arcs) {
+                    GcodePreprocessorUtils::generatePointsAlongArcBDring(arc.plane, arc.start, arc.end, arc.center,
+                                                                         arc.clockwise, arc.radius, minArcLength, precision, false);
+                }
+            });
+
+            double deviation = 0;
+            bool sameCount = true;
+            for (auto const &arc : arcs) {
+                auto const reference = referencePoints(arc, minArcLength, precision, false);
+                auto const generated = GcodePreprocessorUtils::generatePointsAlongArcBDring(arc.plane, arc.start, arc.end,
+                    arc.center, arc.clockwise, arc.radius, minArcLength, precision, false);
+                sameCount = sameCount && reference.size() == generated.size();
+                for (std::size_t i = 0; sameCount && i < reference.size(); i++) {
+                    deviation = qMax<double>(deviation, (reference[i] - generated[i]).length());
+                }
+            }
+
+            // View parse on load and re-parse with unchanged arcs
+            GcodeViewParse view;
+            auto coldParser = parse(source);
+            double const coldTime = measure([&] {
+                view.reset();
+                view.getLinesFromParser(coldParser.get(), precision, false);
+            }, 1);
+            std::size_t const coldSegments = view.getLineSegmentList().size();
+
+            double warmTime = -1;
+            for (int i = 0; i < 3; i++) {
+                auto warmParser = parse(source);
+                double const time = measure([&] {
+                    view.reset();
+                    view.getLinesFromParser(warmParser.get(), precision, false);
+                }, 1);
+                if (warmTime < 0 || time < warmTime) warmTime = time;
+            }
+
+            bool const valid = sameCount && deviation < 1e-4 && view.getLineSegmentList().size() == coldSegments
+                    && view.arcCache().size() > 0;
+            ok = ok && valid;
+
+            out() << QString("%1, precision %2: %3 arcs, %4 points, trigonometry %5 ms, recurrence %6 ms, "
+                             "max difference %7 mm, view parse %8 ms, re-parse %9 ms, %10")
+                     .arg(source.name).arg(precision).arg(arcs.size()).arg(points)
+                     .arg(referenceTime, 0, 'f', 1).arg(recurrenceTime, 0, 'f', 1).arg(deviation, 0, 'g', 3)
+                     .arg(coldTime, 0, 'f', 1).arg(warmTime, 0, 'f', 1).arg(valid ? "valid" : "INVALID")
+                  << Qt::endl;
+        }
+    }
+
+    return ok;
+}
@@ -0,0 +1,201 @@
+// This file is a part of "Candle" application.
+// Copyright 2015-2016 Hayrullin Denis Ravilevich
+
+#include <cstring>
+#include "benchmark.h"
+#include "drawers/gcodedrawer.h"
+#include "utils/parallel.h"
+
+namespace
+{
+    class VectorsDrawer : public GcodeDrawer
+    {
+    public:
+        VectorsDrawer()
+        {
+            setSimplify(true);
+            setSimplifyPrecision(0.5);
+            setDrawLinearMotion(true);
+            setDrawRapidMotion(true);
+            setDrawRapidMotionDashed(true);
+            setDrawControlPoints(false);
+        }
+
+        QVector<VertexData> const &lines() const { return m_lines; }
+        QVector<VertexData> const &points() const { return m_points; }
+
+        // Vertex generation loop as it was before chunking, baseline for serial and parallel runs
+        void prepareOriginal()
+        {
+            auto &list = viewParser()->getLines();
+            VertexData vertex;
+
+            m_lines.clear();
+            m_points.clear();
+
+            auto const segmentColor = [&](LineSegment const &segment) {
+                if (segment.drawn()) return VertColVec(colorDrawn());
+                else if (segment.isHightlight()) return VertColVec(colorHighlight());
+                else if (segment.isFastTraverse()) return VertColVec(colorRapid());
+                else if (segment.isZMovement()) return VertColVec(colorZMovement());
+                return VertColVec(colorNormal());
+            };
+            auto const segmentType = [](LineSegment const &segment) {
+                return segment.isFastTraverse() + segment.isZMovement() * 2;
+            };
+
+            bool drawFirstPoint = true;
+            for (int i = 0; i < static_cast<int>(list.size()); i++) {
+
+                if (qIsNaN(list.at(i).getEnd().z())) {
+                    continue;
+                }
+
+                // Find first point of toolpath
+                if (drawFirstPoint) {
+
+                    if (qIsNaN(list.at(i).getEnd().x()) || qIsNaN(list.at(i).getEnd().y())) continue;
+
+                    // Draw first toolpath point
+                    vertex.color = VertColVec(colorStart());
+                    vertex.position = list.at(i).getEnd();
+                    vertex.start = QVector3D(sNan, sNan, m_pointSize);
+                    m_points.append(vertex);
+
+                    drawFirstPoint = false;
+                    continue;
+                }
+
+                // Prepare vertices
+                if (list.at(i).isFastTraverse()) vertex.start = list.at(i).getStart();
+                else vertex.start = QVector3D(sNan, sNan, sNan);
+
+                // Simplify geometry
+                int const j = i;
+                if (i < static_cast<int>(list.size()) - 1) {
+                    QVector3D next;
+                    double length = (list.at(i).getEnd() - list.at(i).getStart()).length();
+
+                    auto const currentSegmentType = segmentType(list.at(i));
+                    do {
+                        list[i].setVertexIndex(m_lines.size()); // Store vertex index
+                        i++;
+                        if (i < static_cast<int>(list.size()) - 1) {
+                            next = list.at(i).getEnd() - list.at(i).getStart();
+                            length += next.length();
+                        }
+                    // Split short lines
+                    } while (length < simplifyPrecision() && i < static_cast<int>(list.size())
+                             && segmentType(list.at(i)) == currentSegmentType);
+                    i--;
+                } else {
+                    list[i].setVertexIndex(m_lines.size()); // Store vertex index
+                }
+
+                // Set color
+                vertex.color = segmentColor(list.at(i));
+
+                // Line start
+                vertex.position = list.at(j).getStart();
+                m_lines.append(vertex);
+
+                // Line end
+                vertex.position = list.at(i).getEnd();
+                m_lines.append(vertex);
+
+                // Draw last toolpath point
+                if (i == static_cast<int>(list.size()) - 1) {
+                    vertex.color = VertColVec(colorEnd());
+                    vertex.position = list.at(i).getEnd();
+                    vertex.start = QVector3D(sNan, sNan, m_pointSize);
+                    m_points.append(vertex);
+                }
+            }
+        }
+    };
+
+    // Zig-zag pocket with plunges, retracts and rapids, segments shorter and longer than simplify precision
+    void generateToolpath(LineSegment::Container &list, int count)
+    {
+        list.clear();
+        list.reserve(count);
+
+        QVector3D position(0, 0, 5);
+        for (int i = 0; i < count; i++) {
+            LineSegment segment;
+            QVector3D next = position;
+            int const phase = i % 1000;
+
+            if (phase == 0) next.setZ(-1);
+            else if (phase == 998) next.setZ(5);
+            else if (phase == 999) next = QVector3D(0, position.y() + 1, 5);
+            else next.setX(position.x() + ((i / 7) % 2 ? 0.1 : 0.7));
+
+            segment.setStart(position);
+            segment.setEnd(next);
+            segment.setIsFastTraverse(phase == 999);
+            segment.setIsZMovement(phase == 0 || phase == 998);
+            segment.setSpindleSpeed(i % 256);
+            list.push_back(segment);
+
+            position = next;
+        }
+    }
+
+    bool sameVertices(QVector<VertexData> const &a, QVector<VertexData> const &b)
+    {
+        return a.size() == b.size() && (a.isEmpty() || !std::memcmp(a.constData(), b.constData(), a.size() * sizeof(VertexData)));
+    }
+}
+
+bool Benchmark::gcodeDrawer()
+{
+    bool ok = true;
+    int const maxThreads = Parallel::maxThreads();
+
+    for (int count : { 1000000, 5000000, 20000000 }) {
+        GcodeViewParse parser;
+        generateToolpath(parser.getLines(), count);
+
+        VectorsDrawer original;
+        original.setViewParser(&parser);
+        double const originalTime = measure([&] { original.prepareOriginal(); });
+        std::vector<int> originalIndexes;
+        originalIndexes.reserve(count);
+        for (auto &segment : parser.getLines()) {
+            originalIndexes.push_back(segment.vertexIndex());
+            segment.setVertexIndex(-1);
+        }
+
+        VectorsDrawer serial;
+        serial.setViewParser(&parser);
+        Parallel::maxThreads() = 1;
+        double const serialTime = measure([&] { serial.updateData(); });
+        std::vector<int> serialIndexes;
+        serialIndexes.reserve(count);
+        for (auto &segment : parser.getLines()) {
+            serialIndexes.push_back(segment.vertexIndex());
+            segment.setVertexIndex(-1);
+        }
+
+        VectorsDrawer parallel;
+        parallel.setViewParser(&parser);
+        Parallel::maxThreads() = maxThreads;
+        double const parallelTime = measure([&] { parallel.updateData(); });
+
+        bool identical = sameVertices(original.lines(), serial.lines()) && sameVertices(original.points(), serial.points())
+                && sameVertices(original.lines(), parallel.lines()) && sameVertices(original.points(), parallel.points());
+        for (int i = 0; identical && i < count; i++) {
+            int const index = parser.getLines().at(i).vertexIndex();
+            identical = originalIndexes[i] == serialIndexes[i] && originalIndexes[i] == index;
+        }
+        ok = ok && identical;
+
+        out() << QString("%1 segments: original %2 ms, serial %3 ms, %4 threads %5 ms, speedup %6x, %7")
+                 .arg(count).arg(originalTime, 0, 'f', 1).arg(serialTime, 0, 'f', 1).arg(Parallel::threadCount())
+                 .arg(parallelTime, 0, 'f', 1).arg(originalTime / parallelTime, 0, 'f', 2)
+                 .arg(identical ? "identical" : "MISMATCH") << Qt::endl;
+    }
+
+    return ok;
+}
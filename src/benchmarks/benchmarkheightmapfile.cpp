@@ -0,0 +1,83 @@
+// This file is a part of "Candle" application.
+// Copyright 2015-2016 Hayrullin Denis Ravilevich
+
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <cmath>
+#include "benchmark.h"
+#include "tables/heightmaptablemodel.h"
+#include "utils/heightmapfile.h"
+
+using namespace Benchmark;
+
+namespace
+{
+    HeightMapFile syntheticHeightMap(int size)
+    {
+        HeightMapFile heightMap;
+        heightMap.borderRect = QRectF(0, 0, 500, 500);
+        heightMap.columns = size;
+        heightMap.rows = size;
+        heightMap.zBottom = -1;
+        heightMap.zTop = 1;
+        heightMap.interpolationPointsX = size;
+        heightMap.interpolationPointsY = size;
+
+        heightMap.values.resize(static_cast<std::size_t>(size) * size);
+        for (int i = 0; i < size; i++) for (int j = 0; j < size; j++)
+            heightMap.values[i * size + j] = sin(i * 0.013) * cos(j * 0.017) * 0.4;
+
+        return heightMap;
+    }
+}
+
+bool Benchmark::heightMapFile()
+{
+    bool ok = true;
+
+    QTemporaryDir dir;
+    if (!dir.isValid()) {
+        out() << "can't create temporary directory" << Qt::endl;
+        return false;
+    }
+
+    for (int size : { 100, 1000 }) {
+        HeightMapFile const heightMap = syntheticHeightMap(size);
+        QString const binaryName = dir.filePath(QString("binary%1.map").arg(size));
+        QString const textName = dir.filePath(QString("text%1.map").arg(size));
+
+        double const binarySaveTime = measure([&] { ok = heightMap.save(binaryName) && ok; });
+        double const textSaveTime = measure([&] { ok = heightMap.save(textName, HeightMapFile::Text) && ok; });
+
+        HeightMapFile binary;
+        HeightMapFile text;
+        double const binaryLoadTime = measure([&] { ok = binary.load(binaryName) && ok; });
+        double const textLoadTime = measure([&] { ok = text.load(textName) && ok; });
+
+        // Both formats are exact
+        bool identical = binary.values == heightMap.values && text.values == heightMap.values
+                && binary.columns == size && binary.rows == size && binary.borderRect == heightMap.borderRect;
+        ok = ok && identical;
+
+        // Model fill, per point as previous loader did, then single reset
+        HeightMapTableModel model;
+        double const setDataTime = measure([&] {
+            model.resize(size, size);
+            for (int i = 0; i < size; i++) for (int j = 0; j < size; j++)
+                model.setData(model.index(i, j), heightMap.values[i * size + j], Qt::UserRole);
+        });
+        double const setValuesTime = measure([&] { model.setValues(size, size, heightMap.values); });
+        identical = model.values() == heightMap.values;
+        ok = ok && identical;
+
+        out() << QString("%1x%1 grid: binary %2 KiB save %3 ms load %4 ms, text %5 KiB save %6 ms load %7 ms, "
+                         "model per point %8 ms, bulk %9 ms, %10")
+                 .arg(size)
+                 .arg(QFileInfo(binaryName).size() / 1024).arg(binarySaveTime, 0, 'f', 1).arg(binaryLoadTime, 0, 'f', 1)
+                 .arg(QFileInfo(textName).size() / 1024).arg(textSaveTime, 0, 'f', 1).arg(textLoadTime, 0, 'f', 1)
+                 .arg(setDataTime, 0, 'f', 1).arg(setValuesTime, 0, 'f', 1).arg(identical ? "identical" : "MISMATCH")
+              << Qt::endl;
+    }
+
+    return ok;
+}
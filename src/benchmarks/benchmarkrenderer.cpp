@@ -0,0 +1,248 @@
+// This file is a part of "Candle" application.
+// Copyright 2015-2016 Hayrullin Denis Ravilevich
+
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLFunctions>
+#include <QOpenGLShaderProgram>
+#include <QtMath>
+#include <algorithm>
+#include <vector>
+#include "benchmark.h"
+#include "drawers/gcodedrawer.h"
+#include "drawers/tooldrawer.h"
+#include "drawers/heightmapborderdrawer.h"
+#include "drawers/heightmapgriddrawer.h"
+#include "drawers/heightmapinterpolationdrawer.h"
+#include "parser/gcodeparser.h"
+#include "parser/gcodepreprocessorutils.h"
+#include "parser/gcodeviewparse.h"
+#include "tables/heightmaptablemodel.h"
+
+using namespace Benchmark;
+
+namespace
+{
+    // Spiral pocket of linear moves and arcs with rapid retracts between levels
+    Program syntheticProgram()
+    {
+        Program program;
+        program.name = "synthetic";
+        program.lines << "G21" << "G90" << "M3 S10000" << "G0 Z5" << "G0 X0 Y0";
+
+        for (int level = 1; level <= 20; level++) {
+            program.lines << QString("G1 Z%1 F300").arg(-0.2 * level).toLatin1();
+            for (int ring = 1; ring <= 100; ring++) {
+                double const r = ring * 0.5;
+                program.lines << QString("G1 X%1 Y0 F1200").arg(r).toLatin1();
+                program.lines << QString("G2 X%1 Y0 I%2 J0").arg(-r).arg(-r).toLatin1();
+                program.lines << QString("G2 X%1 Y0 I%2 J0").arg(r).arg(r).toLatin1();
+                for (int i = 0; i < 50; i++) {
+                    double const a = M_PI * 2 * i / 50;
+                    program.lines << QString("G1 X%1 Y%2").arg(r * cos(a), 0, 'f', 3).arg(r * sin(a), 0, 'f', 3).toLatin1();
+                }
+            }
+            program.lines << "G0 Z5" << "G0 X0 Y0";
+        }
+        program.lines << "M5" << "M30";
+
+        return program;
+    }
+
+    double percentile(std::vector<double> values, double p)
+    {
+        if (values.empty()) return 0;
+        std::sort(values.begin(), values.end());
+        return values[qBound<int>(0, qRound(p * (values.size() - 1)), static_cast<int>(values.size()) - 1)];
+    }
+
+    // Orbit camera, same conventions as GLWidget::updateView
+    QMatrix4x4 viewMatrix(QVector3D lookAt, double distance, double xRot, double yRot, double zoom)
+    {
+        QMatrix4x4 matrix;
+
+        double const angY = M_PI / 180 * yRot;
+        double const angX = M_PI / 180 * xRot;
+
+        QVector3D eye(distance * cos(angX) * sin(angY) + lookAt.x(), distance * sin(angX) + lookAt.y(), distance * cos(angX) * cos(angY) + lookAt.z());
+        QVector3D up(fabs(xRot) == 90 ? -sin(angY) : 0, cos(angX), fabs(xRot) == 90 ? -cos(angY) : 0);
+
+        matrix.lookAt(eye, lookAt, up.normalized());
+        matrix.translate(lookAt);
+        matrix.scale(zoom);
+        matrix.translate(-lookAt);
+        matrix.rotate(-90, 1.0, 0.0, 0.0);
+
+        return matrix;
+    }
+}
+
+bool Benchmark::renderer()
+{
+    int const width = 1280;
+    int const height = 720;
+    int const frames = 360;
+
+    QSurfaceFormat format;
+    format.setDepthBufferSize(24);
+
+    QOpenGLContext context;
+    context.setFormat(format);
+    if (!context.create()) {
+        out() << "can't create OpenGL context" << Qt::endl;
+        return false;
+    }
+
+    QOffscreenSurface surface;
+    surface.setFormat(context.format());
+    surface.create();
+    if (!context.makeCurrent(&surface)) {
+        out() << "can't make OpenGL context current" << Qt::endl;
+        return false;
+    }
+
+    QOpenGLFunctions *gl = context.functions();
+    out() << "renderer: " << reinterpret_cast<char const*>(gl->glGetString(GL_RENDERER)) << Qt::endl;
+
+    QOpenGLFramebufferObjectFormat fboFormat;
+    fboFormat.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
+    QOpenGLFramebufferObject fbo(width, height, fboFormat);
+    fbo.bind();
+
+    QOpenGLShaderProgram program;
+    if (!program.addShaderFromSourceFile(QOpenGLShader::Vertex, ":/shaders/vshader.glsl")
+            || !program.addShaderFromSourceFile(QOpenGLShader::Fragment, ":/shaders/fshader.glsl")
+            || !program.link()) {
+        out() << "can't build shader program" << Qt::endl;
+        return false;
+    }
+
+    for (Program const &source : corpus(syntheticProgram)) {
+
+        // Parse
+        QElapsedTimer timer;
+        timer.start();
+
+        GcodeParser gp;
+        for (QByteArray const &line : source.lines) gp.addCommand(GcodePreprocessorUtils::splitCommand(line));
+        GcodeViewParse viewParser;
+        viewParser.getLinesFromParser(&gp, 0.1, false);
+
+        double const parseTime = timer.nsecsElapsed() / 1e6;
+
+        // Drawers
+        GcodeDrawer codeDrawer;
+        codeDrawer.setViewParser(&viewParser);
+        codeDrawer.setSimplify(true);
+        codeDrawer.setSimplifyPrecision(0);
+        codeDrawer.setDrawLinearMotion(true);
+        codeDrawer.setDrawRapidMotion(true);
+        codeDrawer.setDrawRapidMotionDashed(true);
+        codeDrawer.setDrawControlPoints(false);
+        codeDrawer.setColorNormal(Qt::black);
+        codeDrawer.setColorRapid(Qt::gray);
+        codeDrawer.setColorZMovement(Qt::red);
+        codeDrawer.setColorStart(Qt::green);
+        codeDrawer.setColorEnd(Qt::red);
+
+        QVector3D const min = codeDrawer.getMinimumExtremes();
+        QVector3D const max = codeDrawer.getMaximumExtremes();
+        QRectF const border(min.x(), min.y(), max.x() - min.x(), max.y() - min.y());
+
+        ToolDrawer toolDrawer;
+        toolDrawer.setToolDiameter(3);
+        toolDrawer.setToolLength(15);
+        toolDrawer.setToolAngle(180);
+        toolDrawer.setColor(Qt::darkGray);
+
+        HeightMapBorderDrawer borderDrawer;
+        borderDrawer.setBorderRect(border);
+
+        int const gridPoints = 20;
+        HeightMapTableModel heightMapModel;
+        heightMapModel.resize(gridPoints, gridPoints);
+        for (int i = 0; i < gridPoints; i++) for (int j = 0; j < gridPoints; j++)
+            heightMapModel.setData(heightMapModel.index(i, j), sin(i * 0.3) * cos(j * 0.3) * 0.5, Qt::UserRole);
+
+        HeightMapGridDrawer gridDrawer;
+        gridDrawer.setModel(&heightMapModel);
+        gridDrawer.setBorderRect(border);
+        gridDrawer.setGridSize(QPointF(gridPoints, gridPoints));
+        gridDrawer.setZTop(1);
+        gridDrawer.setZBottom(-1);
+
+        int const interpolationPoints = 100;
+        QVector<QVector<double>> interpolationData(interpolationPoints, QVector<double>(interpolationPoints));
+        for (int i = 0; i < interpolationPoints; i++) for (int j = 0; j < interpolationPoints; j++)
+            interpolationData[i][j] = sin(i * 0.06) * cos(j * 0.06) * 0.5;
+
+        HeightMapInterpolationDrawer interpolationDrawer;
+        interpolationDrawer.setBorderRect(border);
+        interpolationDrawer.setData(&interpolationData);
+
+        QList<ShaderDrawable*> drawables = { &codeDrawer, &toolDrawer, &borderDrawer, &gridDrawer, &interpolationDrawer };
+
+        // Build & upload geometry
+        program.bind();
+        timer.start();
+        qint64 uploadBytes = 0;
+        for (ShaderDrawable *drawable : drawables) {
+            drawable->updateGeometry(&program);
+            uploadBytes += static_cast<qint64>(drawable->getVertexCount()) * sizeof(VertexData);
+        }
+        gl->glFinish();
+        double const buildTime = timer.nsecsElapsed() / 1e6;
+
+        // Camera path: orbit with zoom in/out, then view changes top/front/left/isometric
+        QVector3D const lookAt((min.x() + max.x()) / 2, (min.z() + max.z()) / 2, -(min.y() + max.y()) / 2);
+        double const distance = qMax(qMax(border.width(), border.height()) * 2.6, 200.0);
+        QMatrix4x4 projection;
+        projection.frustum(-0.5 * width / height, 0.5 * width / height, -0.5, 0.5, 2, distance * 2);
+
+        std::vector<double> frameTimes;
+        frameTimes.reserve(frames);
+
+        gl->glEnable(GL_PROGRAM_POINT_SIZE);
+        gl->glEnable(GL_DEPTH_TEST);
+        gl->glViewport(0, 0, width, height);
+
+        for (int frame = 0; frame < frames; frame++) {
+            double const t = double(frame) / frames;
+            double xRot = 45, yRot = 360 * t * 2, zoom = 1 + 0.5 * sin(t * M_PI * 4);
+            if (frame >= frames / 2) {
+                static double const views[][2] = { { 90, 0 }, { 0, 0 }, { 0, 90 }, { 45, 45 } };
+                int const view = (frame - frames / 2) * 4 / (frames - frames / 2);
+                xRot = views[view][0];
+                yRot = views[view][1];
+                zoom = 1;
+            }
+            QMatrix4x4 const view = viewMatrix(lookAt, distance, xRot, yRot, zoom);
+
+            timer.start();
+
+            gl->glClearColor(1, 1, 1, 1);
+            gl->glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            program.setUniformValue("mvp_matrix", projection * view);
+            program.setUniformValue("mv_matrix", view);
+            for (ShaderDrawable *drawable : drawables) drawable->draw(&program);
+
+            gl->glFinish();
+            frameTimes.push_back(timer.nsecsElapsed() / 1e6);
+        }
+        program.release();
+
+        interpolationDrawer.setData(NULL);
+
+        out() << QString("%1: %2 lines, %3 segments, parse %4 ms, geometry %5 ms, upload %6 KiB, frame p50 %7 ms, p99 %8 ms")
+                 .arg(source.name).arg(source.lines.size()).arg(viewParser.getLines().size())
+                 .arg(parseTime, 0, 'f', 1).arg(buildTime, 0, 'f', 1).arg(uploadBytes / 1024)
+                 .arg(percentile(frameTimes, 0.5), 0, 'f', 2).arg(percentile(frameTimes, 0.99), 0, 'f', 2) << Qt::endl;
+    }
+
+    fbo.release();
+    context.doneCurrent();
+
+    return true;
+}
@@ -0,0 +1,186 @@
+// This file is a part of "Candle" application.
+// Copyright 2015-2016 Hayrullin Denis Ravilevich
+
+#include <algorithm>
+#include <cmath>
+#include "benchmark.h"
+#include "parser/gcodepreprocessorutils.h"
+#include "parser/sendpreprocessor.h"
+
+using namespace Benchmark;
+
+namespace
+{
+    // CAM style 3D finishing: numbered lines, spaces, 4 decimals, repeated motion mode and feed, comments
+    QByteArrayList syntheticProgram(int count)
+    {
+        QByteArrayList commands;
+        commands.reserve(count);
+
+        commands.append("(Finishing, 3 mm ball)");
+        commands.append("G90 G94 G17");
+        commands.append("G21");
+        commands.append("M3 S12000");
+        commands.append("G0 Z5.0000");
+
+        int const rowLength = 500;
+        for (int i = 0; commands.size() < count; i++) {
+            int const row = i / rowLength;
+            int const column = i % rowLength;
+            double const x = (row % 2 ? rowLength - column - 1 : column) * 0.1;
+            double const y = row * 0.25;
+            double const z = sin(x * 0.3) * cos(y * 0.2) - 1;
+
+            QByteArray line = QString("N%1 ").arg((commands.size() + 1) * 10).toLatin1();
+            if (column == 0) {
+                line += QString("G0 X%1 Y%2 Z5.0000").arg(x, 0, 'f', 4).arg(y, 0, 'f', 4).toLatin1();
+            } else {
+                line += QString("G1 X%1 Y%2 Z%3 F1500.0").arg(x, 0, 'f', 4).arg(y, 0, 'f', 4).arg(z, 0, 'f', 4)
+                        .toLatin1();
+                if (column == 1) line += " (row start)";
+            }
+            commands.append(line);
+        }
+
+        return commands;
+    }
+
+    // Position after every command, coordinates are absolute in synthetic program
+    bool samePositions(QByteArrayList const &original, QByteArrayList const &processed, double tolerance)
+    {
+        double a[3] = {0, 0, 0};
+        double b[3] = {0, 0, 0};
+
+        for (int i = 0; i < original.size(); i++) {
+            for (auto const &arg : GcodePreprocessorUtils::splitCommand(original.at(i))) {
+                if (arg.at(0) >= 'X' && arg.at(0) <= 'Z') a[arg.at(0) - 'X'] = arg.mid(1).toDouble();
+            }
+            for (auto const &arg : GcodePreprocessorUtils::splitCommand(processed.at(i))) {
+                if (arg.at(0) >= 'X' && arg.at(0) <= 'Z') b[arg.at(0) - 'X'] = arg.mid(1).toDouble();
+            }
+            for (int j = 0; j < 3; j++) if (fabs(a[j] - b[j]) > tolerance) return false;
+        }
+
+        return true;
+    }
+
+    // Arcs pass controller radius check: start and end distances to centre differ by 0.005 mm or 0.1% at most
+    bool validArcs(QByteArrayList const &commands)
+    {
+        double position[3] = {0, 0, 0};
+        int motion = 0;
+
+        for (auto const &command : commands) {
+            double target[3] = {position[0], position[1], position[2]};
+            double offset[2] = {0, 0};
+
+            for (auto const &arg : GcodePreprocessorUtils::splitCommand(command)) {
+                double const value = arg.mid(1).toDouble();
+                if (arg.at(0) == 'G' && value >= 0 && value <= 3) motion = qRound(value);
+                else if (arg.at(0) >= 'X' && arg.at(0) <= 'Z') target[arg.at(0) - 'X'] = value;
+                else if (arg.at(0) == 'I' || arg.at(0) == 'J') offset[arg.at(0) - 'I'] = value;
+            }
+
+            if (motion >= 2) {
+                double const centerX = position[0] + offset[0];
+                double const centerY = position[1] + offset[1];
+                double const startRadius = hypot(position[0] - centerX, position[1] - centerY);
+                double const delta = fabs(hypot(target[0] - centerX, target[1] - centerY) - startRadius);
+                if (delta > 0.005 && delta > 0.001 * startRadius) return false;
+            }
+
+            std::copy(std::begin(target), std::end(target), std::begin(position));
+        }
+
+        return true;
+    }
+
+    // Sum of incremental X moves
+    double incrementalDistance(QByteArrayList const &commands)
+    {
+        double distance = 0;
+        for (auto const &command : commands) {
+            for (auto const &arg : GcodePreprocessorUtils::splitCommand(command)) {
+                if (arg.at(0) == 'X') distance += arg.mid(1).toDouble();
+            }
+        }
+        return distance;
+    }
+}
+
+bool Benchmark::sendPreprocessor()
+{
+    bool ok = true;
+
+    // Serial link and GRBL receive buffer
+    double const bytesPerSecond = 115200 / 10.0;
+    int const rxBuffer = 128;
+
+    for (int count : { 100000, 1000000 }) {
+        QByteArrayList const commands = syntheticProgram(count);
+
+        qint64 bytesBefore = 0;
+        for (auto const &command : commands) bytesBefore += command.size() + 1;
+
+        for (bool removeRedundant : { false, true }) {
+            SendPreprocessor preprocessor;
+            preprocessor.setEnabled(true);
+            preprocessor.setDecimals(3);
+            preprocessor.setRemoveRedundant(removeRedundant);
+
+            QByteArrayList processed;
+            double const time = measure([&] {
+                preprocessor.reset();
+                processed.clear();
+                processed.reserve(commands.size());
+                for (auto const &command : commands) processed.append(preprocessor.process(command));
+            }, count > 100000 ? 1 : 3);
+
+            qint64 bytesAfter = 0;
+            for (auto const &command : processed) bytesAfter += command.size() + 1;
+
+            bool const valid = bytesAfter < bytesBefore && samePositions(commands, processed, 0.0005 + 1e-9);
+            ok = ok && valid;
+
+            double const before = static_cast<double>(bytesBefore) / count;
+            double const after = static_cast<double>(bytesAfter) / count;
+            out() << QString("%1 lines%2: %3 ms (%4 lines/s), %5 -> %6 bytes/line, "
+                             "link %7 -> %8 lines/s, %9 -> %10 lines in RX buffer, %11")
+                     .arg(count).arg(removeRedundant ? ", redundant removed" : "")
+                     .arg(time, 0, 'f', 1).arg(count / time * 1000, 0, 'f', 0)
+                     .arg(before, 0, 'f', 1).arg(after, 0, 'f', 1)
+                     .arg(bytesPerSecond / before, 0, 'f', 0).arg(bytesPerSecond / after, 0, 'f', 0)
+                     .arg(rxBuffer / before, 0, 'f', 1).arg(rxBuffer / after, 0, 'f', 1)
+                     .arg(valid ? "valid" : "INVALID")
+                  << Qt::endl;
+        }
+    }
+
+    // Small arc after rounded move and incremental moves below resolution, at 2 decimal places
+    {
+        SendPreprocessor preprocessor;
+        preprocessor.setEnabled(true);
+        preprocessor.setDecimals(2);
+
+        QByteArrayList const arc = { "G21 G90 G17", "G0 X0.004 Y0", "G3 X-0.012 Y0.024 I-0.02 J0.004" };
+        QByteArrayList processedArc;
+        for (auto const &command : arc) processedArc.append(preprocessor.process(command));
+
+        QByteArrayList incremental = { "G91 G1 F100" };
+        for (int i = 0; i < 1000; i++) incremental.append("X0.004");
+        QByteArrayList processedIncremental;
+        for (auto const &command : incremental) processedIncremental.append(preprocessor.process(command));
+
+        bool const arcValid = validArcs(arc) && validArcs(processedArc);
+        bool const incrementalValid = fabs(incrementalDistance(processedIncremental) - incrementalDistance(incremental)) < 1e-6;
+        ok = ok && arcValid && incrementalValid;
+
+        out() << QString("small arc at 2 places: %1, %2").arg(QString(processedArc.join(' ')))
+                 .arg(arcValid ? "valid" : "INVALID") << Qt::endl;
+        out() << QString("incremental moves at 2 places: %1 -> %2 mm, %3")
+                 .arg(incrementalDistance(incremental), 0, 'f', 3).arg(incrementalDistance(processedIncremental), 0, 'f', 3)
+                 .arg(incrementalValid ? "valid" : "INVALID") << Qt::endl;
+    }
+
+    return ok;
+}
@@ -0,0 +1,90 @@
+// This file is a part of "Candle" application.
+// Copyright 2015-2016 Hayrullin Denis Ravilevich
+
+#include <cmath>
+#include "benchmark.h"
+#include "parser/timeestimator.h"
+
+using namespace Benchmark;
+
+namespace
+{
+    // Dense 3D surfacing: raster rows of short segments over wavy surface, rapid between rows
+    LineSegment::Container syntheticProgram(int count)
+    {
+        LineSegment::Container lines;
+        lines.reserve(count);
+
+        int const rowLength = 1000;
+        double const step = 0.1;
+        PointSegment feed;
+        feed.setSpeed(2000);
+        PointSegment rapid;
+        rapid.setIsFastTraverse(true);
+
+        QVector3D point(0, 0, 0);
+        for (int i = 0; static_cast<int>(lines.size()) < count; i++) {
+            int const row = i / rowLength;
+            int const column = i % rowLength;
+            double const x = (row % 2 ? rowLength - column - 1 : column) * step;
+            double const y = row * 0.5;
+            QVector3D const next(x, y, sin(x * 0.3) * cos(y * 0.2));
+
+            lines.push_back(LineSegment(point, next, i, column == 0 ? rapid : feed, true));
+            point = next;
+        }
+
+        return lines;
+    }
+}
+
+bool Benchmark::timeEstimator()
+{
+    bool ok = true;
+
+    TimeEstimator::Machine machine;
+    machine.maxRate = QVector3D(5000, 5000, 1000);
+    machine.acceleration = QVector3D(500, 500, 100);
+    TimeEstimator estimator(machine);
+
+    // Single long move: accelerate, cruise & decelerate at axis limits
+    {
+        PointSegment feed;
+        feed.setSpeed(3000);
+        LineSegment::Container lines;
+        lines.push_back(LineSegment(QVector3D(0, 0, 0), QVector3D(100, 0, 0), 0, feed, true));
+        estimator.estimate(lines);
+
+        double const v = 50;
+        double const expected = 2 * v / 500 + (100 - v * v / 500) / v;
+        bool const exact = fabs(estimator.time() - expected) < 1e-9;
+        ok = ok && exact;
+        out() << QString("single move: %1 s, expected %2 s, %3")
+                 .arg(estimator.time(), 0, 'f', 6).arg(expected, 0, 'f', 6).arg(exact ? "exact" : "MISMATCH")
+              << Qt::endl;
+    }
+
+    for (int count : { 100000, 1000000, 10000000 }) {
+        LineSegment::Container const lines = syntheticProgram(count);
+
+        double naive = 0;
+        for (auto const &line : lines) {
+            double const speed = line.isFastTraverse() ? machine.maxRate.z() : line.getSpeed();
+            naive += (line.getEnd() - line.getStart()).length() / speed * 60;
+        }
+
+        double const time = measure([&] { estimator.estimate(lines); }, count > 1000000 ? 1 : 3);
+
+        // Planner can only be slower than feed rates allow
+        bool const valid = estimator.time() >= naive * 0.99
+                && estimator.timeIndex().lineCount() == count;
+        ok = ok && valid;
+
+        out() << QString("%1 segments: %2 ms, estimated %3 s, length/feed %4 s, %5")
+                 .arg(count).arg(time, 0, 'f', 1).arg(estimator.time(), 0, 'f', 1).arg(naive, 0, 'f', 1)
+                 .arg(valid ? "valid" : "INVALID")
+              << Qt::endl;
+    }
+
+    return ok;
+}
@@ -0,0 +1,38 @@
+// This file is a part of "Candle" application.
+// Copyright 2015-2016 Hayrullin Denis Ravilevich
+
+#include <QApplication>
+#include <QStringList>
+#include <map>
+#include "benchmark.h"
+
+int main(int argc, char *argv[])
+{
+    QApplication a(argc, argv);
+
+    std::map<QString, std::function<bool()>> const benchmarks = {
+        { "arctessellation", Benchmark::arcTessellation },
+        { "gcodedrawer", Benchmark::gcodeDrawer },
+        { "heightmapfile", Benchmark::heightMapFile },
+        { "renderer", Benchmark::renderer },
+        { "sendpreprocessor", Benchmark::sendPreprocessor },
+        { "timeestimator", Benchmark::timeEstimator },
+    };
+
+    QStringList names = a.arguments().mid(1);
+    if (names.isEmpty()) for (auto const &benchmark : benchmarks) names << benchmark.first;
+
+    bool ok = true;
+    for (QString const &name : names) {
+        auto const benchmark = benchmarks.find(name);
+        if (benchmark == benchmarks.end()) {
+            Benchmark::out() << "unknown benchmark: " << name << Qt::endl;
+            ok = false;
+            continue;
+        }
+        Benchmark::out() << "== " << name << Qt::endl;
+        ok = benchmark->second() && ok;
+    }
+
+    return ok ? 0 : 1;
+}
@@ -48,12 +48,21 @@ SOURCES += main.cpp\
     drawers/origindrawer.cpp \
     drawers/shaderdrawable.cpp \
     drawers/tooldrawer.cpp \
+    parser/arcfitter.cpp \
     parser/arcproperties.cpp \
+    parser/arctessellationcache.cpp \
     parser/gcodeparser.cpp \
     parser/gcodepreprocessorutils.cpp \
     parser/gcodeviewparse.cpp \
+    parser/grblchecker.cpp \
+    parser/heightmapcompensator.cpp \
     parser/linesegment.cpp \
+    parser/modalstateindex.cpp \
     parser/pointsegment.cpp \
+    parser/rapidoptimizer.cpp \
+    parser/segmentmerger.cpp \
+    parser/sendpreprocessor.cpp \
+    parser/timeestimator.cpp \
     tables/gcodetablemodel.cpp \
     tables/heightmaptablemodel.cpp \
     widgets/colorpicker.cpp \
@@ -66,7 +75,10 @@ SOURCES += main.cpp\
     widgets/slider.cpp \
     widgets/sliderbox.cpp \
     drawers/selectiondrawer.cpp \
-    widgets/comboboxkey.cpp
+    widgets/comboboxkey.cpp \
+    utils/adaptiveprobing.cpp \
+    utils/heightmapfile.cpp \
+    utils/heightmapsurface.cpp
 
 HEADERS  += frmmain.h \
     frmsettings.h \
@@ -78,15 +90,29 @@ HEADERS  += frmmain.h \
     drawers/origindrawer.h \
     drawers/shaderdrawable.h \
     drawers/tooldrawer.h \
+    parser/arcfitter.h \
     parser/arcproperties.h \
+    parser/arctessellationcache.h \
     parser/gcodeparser.h \
     parser/gcodepreprocessorutils.h \
     parser/gcodeviewparse.h \
+    parser/grblchecker.h \
+    parser/heightmapcompensator.h \
     parser/linesegment.h \
+    parser/modalstateindex.h \
     parser/pointsegment.h \
+    parser/programtimeindex.h \
+    parser/rapidoptimizer.h \
+    parser/segmentmerger.h \
+    parser/sendpreprocessor.h \
+    parser/timeestimator.h \
     tables/gcodetablemodel.h \
     tables/heightmaptablemodel.h \
+    utils/adaptiveprobing.h \
+    utils/heightmapfile.h \
+    utils/heightmapsurface.h \
     utils/interpolation.h \
+    utils/parallel.h \
     utils/util.h \
     widgets/colorpicker.h \
     widgets/combobox.h \
@@ -2,6 +2,10 @@
 // Copyright 2015-2016 Hayrullin Denis Ravilevich
 
 #include "gcodedrawer.h"
+#include "parser/gcodepreprocessorutils.h"
+#include "utils/parallel.h"
+#include <QtMath>
+#include <limits>
 
 GcodeDrawer::GcodeDrawer() : QObject()
 {   
@@ -18,10 +22,16 @@ GcodeDrawer::GcodeDrawer() : QObject()
     m_timerVertexUpdate.start(100);
 }
 
+GcodeDrawer::~GcodeDrawer()
+{
+    stopArcTessellation();
+}
+
 void GcodeDrawer::update()
 {
     m_indexes.clear();
     m_geometryUpdated = false;
+    m_arcGeneration++; // Arcs of previous geometry are dropped
     ShaderDrawable::update();
 }
 
@@ -44,6 +54,7 @@ bool GcodeDrawer::updateData()
 {
     switch (m_drawMode) {
     case GcodeDrawer::Vectors:
+        if (m_arcsChanged && m_geometryUpdated) return updateArcs();
         if (m_indexes.empty()) return prepareVectors(); else return updateVectors();
     case GcodeDrawer::Raster:
         if (m_indexes.empty()) return prepareRaster(); else return updateRaster();
@@ -55,7 +66,7 @@ bool GcodeDrawer::prepareVectors()
     qDebug() << "preparing vectors" << this;
 
     auto &list = m_viewParser->getLines();
-    VertexData vertex;
+    int const count = static_cast<int>(list.size());
 
     qDebug() << "lines count" << list.size();
 
@@ -63,46 +74,129 @@ bool GcodeDrawer::prepareVectors()
     m_lines.clear();
     m_points.clear();
     m_triangles.clear();
+    m_vertices.clear();
+    m_lineIndexes.clear();
+
+    // Delete textures on mode change
+    qDeleteAll(m_textures);
+    m_textures.clear();
+    m_tiles.clear();
+
+    // Find first point of toolpath
+    int firstPoint = 0;
+    while (firstPoint < count && (qIsNaN(list.at(firstPoint).getEnd().z())
+                                  || qIsNaN(list.at(firstPoint).getEnd().x())
+                                  || qIsNaN(list.at(firstPoint).getEnd().y()))) firstPoint++;
+
+    if (firstPoint == count) {
+        clearArcs();
+        m_geometryUpdated = true;
+        m_indexes.clear();
+        return true;
+    }
 
-    // Delete texture on mode change
-    if (m_texture) {
-        m_texture->destroy();
-        delete m_texture;
-        m_texture = NULL;
+    // Split remaining segments to chunks. Simplified line always starts at segment type change,
+    // analytic arc or segment reaching precision alone, chunks start there to never split a line
+    int const chunks = Parallel::chunkCount(count - firstPoint - 1);
+    std::vector<int> bounds = Parallel::splitRange(firstPoint + 1, count, chunks);
+    if (m_simplify) {
+        auto const startsLine = [&](int i) {
+            auto const &segment = list.at(i);
+            return getSegmentType(segment) != getSegmentType(list.at(i - 1)) || segment.isAnalyticArc()
+                    || (i < count - 1 && !((segment.getEnd() - segment.getStart()).length() < m_simplifyPrecision));
+        };
+        for (int c = 1; c < chunks; c++) {
+            int &b = bounds[c];
+            b = qMax(b, bounds[c - 1]);
+            while (b < count && !startsLine(b)) b++;
+        }
     }
 
-    bool drawFirstPoint = true;
-    for (int i = 0; i < static_cast<int>(list.size()); i++) {
+    // Count vertices of each chunk
+    std::vector<int> linesCount(chunks + 1, 0);
+    std::vector<int> pointsCount(chunks + 1, 0);
 
-        if (qIsNaN(list.at(i).getEnd().z())) {
-            continue;
-        }
+    Parallel::forEachChunk(chunks, [&](int c) {
+        generateVectors(list, bounds[c], bounds[c + 1], nullptr, nullptr, 0, linesCount[c + 1], pointsCount[c + 1]);
+    });
 
-        // Find first point of toolpath
-        if (drawFirstPoint) {
+    // Prefix sums give output ranges, first toolpath point goes first
+    pointsCount[0] = 1;
+    for (int c = 0; c < chunks; c++) {
+        linesCount[c + 1] += linesCount[c];
+        pointsCount[c + 1] += pointsCount[c];
+    }
 
-            if (qIsNaN(list.at(i).getEnd().x()) || qIsNaN(list.at(i).getEnd().y())) continue;
+    m_lines.resize(linesCount[chunks]);
+    m_points.resize(pointsCount[chunks]);
 
-            // Draw first toolpath point
-            vertex.color = VertColVec(m_colorStart);
-            vertex.position = list.at(i).getEnd();
-            if (m_ignoreZ) vertex.position.setZ(0);
-            vertex.start = QVector3D(sNan, sNan, m_pointSize);
-            m_points.append(vertex);
+    VertexData *lines = m_lines.data();
+    VertexData *points = m_points.data();
+
+    // Draw first toolpath point
+    points[0].color = VertColVec(m_colorStart);
+    points[0].position = list.at(firstPoint).getEnd();
+    if (m_ignoreZ) points[0].position.setZ(0);
+    points[0].start = QVector3D(sNan, sNan, m_pointSize);
 
-            drawFirstPoint = false;
+    Parallel::forEachChunk(chunks, [&](int c) {
+        int linesWritten = 0;
+        int pointsWritten = 0;
+        generateVectors(list, bounds[c], bounds[c + 1], lines + linesCount[c], points + pointsCount[c],
+                        linesCount[c], linesWritten, pointsWritten);
+    });
+
+    prepareArcs();
+
+    m_geometryUpdated = true;
+    m_indexes.clear();
+    return true;
+}
+
+void GcodeDrawer::generateVectors(LineSegment::Container &list, int first, int last, VertexData *lines, VertexData *points,
+                                  int lineOffset, int &linesCount, int &pointsCount) const
+{
+    int const count = static_cast<int>(list.size());
+    VertexData vertex;
+
+    // Draw last toolpath point
+    auto const addEndPoint = [&](int i) {
+        if (points) {
+            VertexData point;
+            point.color = VertColVec(m_colorEnd);
+            point.position = list.at(i).getEnd();
+            if (m_ignoreZ) point.position.setZ(0);
+            point.start = QVector3D(sNan, sNan, m_pointSize);
+            points[pointsCount] = point;
+        }
+        pointsCount++;
+    };
+
+    for (int i = first; i < last; i++) {
+
+        if (qIsNaN(list.at(i).getEnd().z())) {
             continue;
-        } else if (drawControlPoints()){
+        }
+
+        if (drawControlPoints()) {
             if (qIsNaN(list.at(i).getEnd().x()) || qIsNaN(list.at(i).getEnd().y())) continue;
 
             // Draw toolpath point
-            vertex.color = getSegmentColorVector(list.at(i));
-//
-//            vertex.color = Util::colorToVector(m_colorNormal);
-            vertex.position = list.at(i).getEnd();
-            if (m_ignoreZ) vertex.position.setZ(0);
-            vertex.start = QVector3D(sNan, sNan, m_pointSize/2.0);
-            m_points.append(vertex);
+            if (points) {
+                vertex.color = getSegmentColorVector(list.at(i));
+                vertex.position = list.at(i).getEnd();
+                if (m_ignoreZ) vertex.position.setZ(0);
+                vertex.start = QVector3D(sNan, sNan, m_pointSize/2.0);
+                points[pointsCount] = vertex;
+            }
+            pointsCount++;
+        }
+
+        // Analytic arcs are drawn from arc chunks
+        if (list.at(i).isAnalyticArc()) {
+            if (lines) list[i].setVertexIndex(-1);
+            if (i == count - 1) addEndPoint(i);
+            continue;
         }
 
         // Prepare vertices
@@ -120,7 +214,7 @@ bool GcodeDrawer::prepareVectors()
 
         // Simplify geometry
         int const j = i;
-        if (m_simplify && i < static_cast<int>(list.size()) - 1) {
+        if (m_simplify && i < count - 1) {
             QVector3D start = list.at(i).getEnd() - list.at(i).getStart();
             QVector3D next;
             double length = start.length();
@@ -128,49 +222,39 @@ bool GcodeDrawer::prepareVectors()
 
             auto const currentSegmentType = getSegmentType(list.at(i));
             do {
-                list[i].setVertexIndex(m_lines.size()); // Store vertex index
+                if (lines) list[i].setVertexIndex(lineOffset + linesCount); // Store vertex index
                 i++;
-                if (i < static_cast<int>(list.size()) - 1) {
+                if (i < count - 1) {
                     next = list.at(i).getEnd() - list.at(i).getStart();
                     length += next.length();
 //                    straight = start.crossProduct(start.normalized(), next.normalized()).length() < 0.025;
                 }
             // Split short & straight lines
-            } while ((length < m_simplifyPrecision || straight) && i < static_cast<int>(list.size())
-                     && getSegmentType(list.at(i)) == currentSegmentType);
+            } while ((length < m_simplifyPrecision || straight) && i < count
+                     && getSegmentType(list.at(i)) == currentSegmentType && !list.at(i).isAnalyticArc());
             i--;
-        } else {
-            list[i].setVertexIndex(m_lines.size()); // Store vertex index
+        } else if (lines) {
+            list[i].setVertexIndex(lineOffset + linesCount); // Store vertex index
         }
 
-        // Set color
-        vertex.color = getSegmentColorVector(list.at(i));
-
-//        if (list.at(i).isFastTraverse())
-//            vertex.color.setW(.30);
-
-        // Line start
-        vertex.position = list.at(j).getStart();
-        if (m_ignoreZ) vertex.position.setZ(0);
-        m_lines.append(vertex);
+        if (lines) {
+            // Set color
+            vertex.color = getSegmentColorVector(list.at(i));
 
-        // Line end
-        vertex.position = list.at(i).getEnd();
-        if (m_ignoreZ) vertex.position.setZ(0);
-        m_lines.append(vertex);
+            // Line start
+            vertex.position = list.at(j).getStart();
+            if (m_ignoreZ) vertex.position.setZ(0);
+            lines[linesCount] = vertex;
 
-        // Draw last toolpath point
-        if (i == static_cast<int>(list.size()) - 1) {
-            vertex.color = VertColVec(m_colorEnd);
+            // Line end
             vertex.position = list.at(i).getEnd();
             if (m_ignoreZ) vertex.position.setZ(0);
-            vertex.start = QVector3D(sNan, sNan, m_pointSize);
-            m_points.append(vertex);
+            lines[linesCount + 1] = vertex;
         }
+        linesCount += 2;
+
+        if (i == count - 1) addEndPoint(i);
     }
-    m_geometryUpdated = true;
-    m_indexes.clear();
-    return true;
 }
 
 bool GcodeDrawer::updateVectors()
@@ -182,108 +266,343 @@ bool GcodeDrawer::updateVectors()
     auto data = (VertexData*)m_vbo.map(QOpenGLBuffer::WriteOnly);
 
     // Update vertices for each line segment
-    int vertexIndex;
-    for (auto &i : m_indexes) {
-        // Update vertex pair
-        if (i < 0 || i > static_cast<int>(list.size()) - 1) continue;
-        vertexIndex = list.at(i).vertexIndex();
-        if (vertexIndex >= 0) {
-            // Update vertex array            
-            if (data) {
-                data[vertexIndex].color = getSegmentColorVector(list.at(i));
-                data[vertexIndex + 1].color = data[vertexIndex].color;
-            } else {
-                m_lines[vertexIndex].color = getSegmentColorVector(list.at(i));
-                m_lines[vertexIndex + 1].color = m_lines.at(vertexIndex).color;
-            }
-        }
-    }
+    for (auto &i : m_indexes) updateSegmentColor(list, i, data);
 
     m_indexes.clear();
     if (data) m_vbo.unmap();
     return !data;
 }
 
-bool GcodeDrawer::prepareRaster()
+void GcodeDrawer::updateSegmentColor(LineSegment::Container const &list, int index, VertexData *data)
 {
-    const int maxImageSize = 8192;
+    if (index < 0 || index > static_cast<int>(list.size()) - 1) return;
+    LineSegment const &segment = list.at(index);
 
-    qDebug() << "preparing raster" << this;
+    // Line is vertex pair, arc is range of shared vertices placed after lines & points
+    QVector<VertexData> *vertices = &m_lines;
+    int offset = 0;
+    int first = segment.vertexIndex();
+    int last = first + 2;
+
+    if (segment.isAnalyticArc()) {
+        auto const arc = std::lower_bound(m_arcSegments.begin(), m_arcSegments.end(), index);
+        if (arc == m_arcSegments.end() || *arc != index) return;
+        int const a = static_cast<int>(arc - m_arcSegments.begin());
+        if (a + 1 >= static_cast<int>(m_arcVertexOffsets.size())) return;
+
+        vertices = &m_vertices;
+        offset = verticesOffset();
+        first = m_arcVertexOffsets[a];
+        last = m_arcVertexOffsets[a + 1];
+    } else if (first < 0) {
+        return;
+    }
 
-    // Generate image
-    QImage image;
-    qDebug() << "image info" << m_viewParser->getResolution() << m_viewParser->getMinLength();
+    // Vertex arrays are kept in sync with buffer, whole buffer is uploaded on arcs update
+    VertColVec const color = getSegmentColorVector(segment);
+    for (int v = first; v < last; v++) {
+        (*vertices)[v].color = color;
+        if (data) data[offset + v].color = color;
+    }
+}
 
-    if (m_viewParser->getResolution().width() <= maxImageSize && m_viewParser->getResolution().height() <= maxImageSize)
-    {
-        image = QImage(m_viewParser->getResolution(), QImage::Format_RGB888);
-        image.fill(Qt::white);
+void GcodeDrawer::prepareArcs()
+{
+    clearArcs();
+    if (!drawLinearMotion()) return;
 
-        auto &list = m_viewParser->getLines();
-        qDebug() << "lines count" << list.size();
+    auto &list = m_viewParser->getLines();
+    auto arcs = std::make_shared<std::vector<Arc>>();
 
-        double pixelSize = m_viewParser->getMinLength();
-        QVector3D origin = m_viewParser->getMinimumExtremes();
+    for (auto const &arc : m_viewParser->arcCenters()) {
+        LineSegment const &segment = list.at(arc.segment);
+        if (qIsNaN(segment.getStart().length()) || qIsNaN(segment.getEnd().length())) continue;
 
-        for (auto & i : list) {
-            if (!qIsNaN(i.getEnd().length())) {
-                setImagePixelColor(image, (i.getEnd().x() - origin.x()) / pixelSize,
-                                   (i.getEnd().y() - origin.y()) / pixelSize, getSegmentColor(i).rgb());
+        m_arcSegments.push_back(arc.segment);
+        arcs->push_back({ segment.getStart(), segment.getEnd(), arc.center, segment.plane(), segment.isClockwise() });
+    }
+    if (arcs->empty()) return;
+
+    // Chunk bounds by circles of arcs, as drawn
+    int const arcCount = static_cast<int>(arcs->size());
+    for (int first = 0; first < arcCount; first += arcsPerChunk) {
+        ArcChunk chunk;
+        chunk.first = first;
+        chunk.last = qMin(first + arcsPerChunk, arcCount);
+
+        float constexpr max = std::numeric_limits<float>::max();
+        chunk.min = QVector3D(max, max, max);
+        chunk.max = -chunk.min;
+        for (int a = chunk.first; a < chunk.last; a++) {
+            Arc const &arc = arcs->at(a);
+            QVector3D const radius = QVector3D(1, 1, 1) * (arc.start - arc.center).length();
+            for (QVector3D const &point : { arc.start, arc.end, arc.center - radius, arc.center + radius }) {
+                QVector3D const position(point.x(), point.y(), m_ignoreZ ? 0 : point.z());
+                chunk.min = QVector3D(qMin(chunk.min.x(), position.x()), qMin(chunk.min.y(), position.y()), qMin(chunk.min.z(), position.z()));
+                chunk.max = QVector3D(qMax(chunk.max.x(), position.x()), qMax(chunk.max.y(), position.y()), qMax(chunk.max.z(), position.z()));
             }
         }
+
+        chunk.level = arcLevel(chunk);
+        m_arcLevels.push_back(chunk.level);
+        m_arcChunks.push_back(std::move(chunk));
     }
+    m_arcs = std::move(arcs);
+
+    // First tessellation by current view, in parallel
+    int const chunks = Parallel::chunkCount(m_arcChunks.size(), 1);
+    std::vector<int> const bounds = Parallel::splitRange(0, static_cast<int>(m_arcChunks.size()), chunks);
+    Parallel::forEachChunk(chunks, [&](int c) {
+        for (int i = bounds[c]; i < bounds[c + 1]; i++) tessellateArcs(*m_arcs, m_arcChunks[i]);
+    });
+
+    updateArcVertices();
+}
+
+void GcodeDrawer::clearArcs()
+{
+    stopArcTessellation();
+    m_arcGeneration++;
+
+    m_arcSegments.clear();
+    m_arcs.reset();
+    m_arcChunks.clear();
+    m_arcLevels.clear();
+    m_arcVertexOffsets.clear();
+    m_arcsChanged = false;
+}
+
+int GcodeDrawer::arcLevel(ArcChunk const &chunk) const
+{
+    // Pixel is smallest at nearest corner of chunk bounds
+    double pixel = std::numeric_limits<double>::max();
+    for (int i = 0; i < 8; i++) {
+        QVector3D const corner(i & 1 ? chunk.max.x() : chunk.min.x(), i & 2 ? chunk.max.y() : chunk.min.y(),
+                               i & 4 ? chunk.max.z() : chunk.min.z());
+        pixel = qMin(pixel, m_viewScale.pixelSize(corner));
+    }
+
+    double const deviation = pixel > 0 && m_arcTolerance > 0 ? pixel * m_arcTolerance : defaultArcDeviation;
+    return qFloor(log2(qMax(deviation, minArcDeviation)));
+}
+
+void GcodeDrawer::updateArcLevels()
+{
+    if (m_arcChunks.empty() || !m_geometryUpdated || m_drawMode != GcodeDrawer::Vectors) return;
+
+    std::vector<int> levels(m_arcChunks.size());
+    for (std::size_t c = 0; c < m_arcChunks.size(); c++) levels[c] = arcLevel(m_arcChunks[c]);
+    if (levels == m_arcLevels) return;
+
+    // Restart worker with chunks of new levels only
+    stopArcTessellation();
+    int const generation = ++m_arcGeneration;
+    m_arcLevels = levels;
+
+    std::vector<ArcChunk> jobs;
+    for (std::size_t c = 0; c < m_arcChunks.size(); c++) {
+        if (levels[c] == m_arcChunks[c].level) continue;
+        jobs.push_back({ m_arcChunks[c].first, m_arcChunks[c].last, m_arcChunks[c].min, m_arcChunks[c].max, levels[c], {}, {} });
+    }
+    if (jobs.empty()) return;
+
+    // Result is dropped if geometry or levels were changed meanwhile
+    m_arcCancelled = false;
+    m_arcThread = std::thread([this, generation, arcs = m_arcs, jobs = std::move(jobs)]() mutable {
+        for (auto &job : jobs) {
+            if (m_arcCancelled) return;
+            tessellateArcs(*arcs, job);
+        }
+
+        QMetaObject::invokeMethod(this, [this, generation, jobs = std::move(jobs)]() mutable {
+            if (generation != m_arcGeneration) return;
+
+            for (auto &job : jobs) {
+                ArcChunk &chunk = m_arcChunks[job.first / arcsPerChunk];
+                chunk.level = job.level;
+                chunk.points.swap(job.points);
+                chunk.offsets.swap(job.offsets);
+            }
+            m_arcsChanged = true;
+            ShaderDrawable::update();
+        }, Qt::QueuedConnection);
+    });
+}
+
+void GcodeDrawer::tessellateArcs(std::vector<Arc> const &arcs, ArcChunk &chunk)
+{
+    double const deviation = ldexp(1.0, chunk.level);
+
+    chunk.points.clear();
+    chunk.offsets.clear();
+    chunk.offsets.reserve(chunk.last - chunk.first + 1);
+
+    for (int a = chunk.first; a < chunk.last; a++) {
+        Arc const &arc = arcs[a];
+        auto const points = GcodePreprocessorUtils::generatePointsAlongArcByDeviation(arc.plane, arc.start, arc.end,
+                                                                                      arc.center, arc.clockwise, deviation);
+        chunk.offsets.push_back(static_cast<int>(chunk.points.size()));
+        chunk.points.push_back(arc.start);
+        chunk.points.insert(chunk.points.end(), points.begin(), points.end());
+    }
+    chunk.offsets.push_back(static_cast<int>(chunk.points.size()));
+}
+
+void GcodeDrawer::updateArcVertices()
+{
+    auto &list = m_viewParser->getLines();
+
+    int vertexCount = 0;
+    for (auto const &chunk : m_arcChunks) vertexCount += static_cast<int>(chunk.points.size());
+
+    m_vertices.clear();
+    m_lineIndexes.clear();
+    m_vertices.reserve(vertexCount);
+    m_lineIndexes.reserve((vertexCount - static_cast<int>(m_arcSegments.size())) * 2);
+    m_arcVertexOffsets.clear();
+    m_arcVertexOffsets.reserve(m_arcSegments.size() + 1);
+
+    // Arc is polyline of indexed lines, vertices are not shared between arcs
+    VertexData vertex;
+    vertex.start = QVector3D(sNan, sNan, sNan);
+
+    for (auto const &chunk : m_arcChunks) {
+        for (int a = chunk.first; a < chunk.last; a++) {
+            m_arcVertexOffsets.push_back(m_vertices.size());
+
+            int const segment = m_arcSegments[a];
+            if (segment < static_cast<int>(list.size())) vertex.color = getSegmentColorVector(list.at(segment));
+
+            for (int p = chunk.offsets[a - chunk.first]; p < chunk.offsets[a - chunk.first + 1]; p++) {
+                if (p > chunk.offsets[a - chunk.first]) m_lineIndexes << m_vertices.size() - 1 << m_vertices.size();
+
+                vertex.position = chunk.points[p];
+                if (m_ignoreZ) vertex.position.setZ(0);
+                m_vertices.append(vertex);
+            }
+        }
+    }
+    m_arcVertexOffsets.push_back(m_vertices.size());
+}
+
+bool GcodeDrawer::updateArcs()
+{
+    m_arcsChanged = false;
+
+    // Pending colors go to vertex arrays, whole buffer is uploaded
+    auto &list = m_viewParser->getLines();
+    for (auto &i : m_indexes) updateSegmentColor(list, i, nullptr);
+    m_indexes.clear();
+
+    updateArcVertices();
+    return true;
+}
+
+void GcodeDrawer::stopArcTessellation()
+{
+    if (!m_arcThread.joinable()) return;
+
+    m_arcCancelled = true;
+    m_arcThread.join();
+}
+
+bool GcodeDrawer::prepareRaster()
+{
+    qDebug() << "preparing raster" << this;
+
+    auto &list = m_viewParser->getLines();
+    qDebug() << "lines count" << list.size();
 
-    // Create vertices array
     // Clear all vertex data
     m_lines.clear();
     m_points.clear();
     m_triangles.clear();
+    m_vertices.clear();
+    m_lineIndexes.clear();
+    clearArcs();
+
+    qDeleteAll(m_textures);
+    m_textures.clear();
+    m_tiles.clear();
+
+    // Pixel size, limited by total raster size
+    QVector3D origin = getMinimumExtremes();
+    QVector3D sizes = getSizes();
+    m_rasterPixelSize = qMax(m_viewParser->getMinLength(), sqrt((double)sizes.x() * sizes.y() / maxRasterPixels));
+    if (!(m_rasterPixelSize > 0) || qIsNaN(origin.x()) || qIsNaN(origin.y())) {
+        m_geometryUpdated = true;
+        m_indexes.clear();
+        return true;
+    }
+
+    m_rasterOrigin = QPointF(origin.x(), origin.y());
+    m_rasterSize = QSize(sizes.x() / m_rasterPixelSize + 1, sizes.y() / m_rasterPixelSize + 1);
+    qDebug() << "raster info" << m_rasterSize << m_rasterPixelSize;
+
+    // Split raster to tiles
+    m_tilesX = (m_rasterSize.width() + rasterTileSize - 1) / rasterTileSize;
+    int const tilesY = (m_rasterSize.height() + rasterTileSize - 1) / rasterTileSize;
 
-    if (m_texture) {
-        m_texture->destroy();
-        delete m_texture;
-        m_texture = NULL;
+    for (int ty = 0; ty < tilesY; ty++) for (int tx = 0; tx < m_tilesX; tx++) {
+        QImage tile(qMin(rasterTileSize, m_rasterSize.width() - tx * rasterTileSize),
+                    qMin(rasterTileSize, m_rasterSize.height() - ty * rasterTileSize), QImage::Format_RGB888);
+        tile.fill(Qt::white);
+        m_tiles.append(tile);
     }
 
-    QVector<VertexData> vertices;
-    VertexData vertex;
+    // Rasterize segments in parallel, each chunk owns band of tile rows
+    int const chunks = qMin(Parallel::threadCount(), tilesY);
+    std::vector<int> bands = Parallel::splitRange(0, tilesY, chunks);
+
+    Parallel::forEachChunk(chunks, [&](int c) {
+        int const top = bands[c] * rasterTileSize;
+        int const bottom = qMin(bands[c + 1] * rasterTileSize, m_rasterSize.height());
+        auto const &arcs = m_viewParser->arcCenters();
+        auto arc = arcs.begin();
+        for (int i = 0; i < static_cast<int>(list.size()); i++) {
+            while (arc != arcs.end() && arc->segment < i) ++arc;
+            rasterizeSegment(list.at(i), arc != arcs.end() && arc->segment == i ? arc->center : QVector3D(), top, bottom);
+        }
+    });
 
-    // Set color
+    // Create textured quad for each tile
+    VertexData vertex;
     vertex.color = VertColVec{Qt::red};
 
-    // Rect
-    vertex.start = QVector3D(sNan, 0, 0);
-    vertex.position = QVector3D(getMinimumExtremes().x(), getMinimumExtremes().y(), 0);
-    vertices.append(vertex);
-
-    vertex.start = QVector3D(sNan, 1, 1);
-    vertex.position = QVector3D(getMaximumExtremes().x(), getMaximumExtremes().y(), 0);
-    vertices.append(vertex);
-
-    vertex.start = QVector3D(sNan, 0, 1);
-    vertex.position = QVector3D(getMinimumExtremes().x(), getMaximumExtremes().y(), 0);
-    vertices.append(vertex);
-
-    vertex.start = QVector3D(sNan, 0, 0);
-    vertex.position = QVector3D(getMinimumExtremes().x(), getMinimumExtremes().y(), 0);
-    vertices.append(vertex);
-
-    vertex.start = QVector3D(sNan, 1, 0);
-    vertex.position = QVector3D(getMaximumExtremes().x(), getMinimumExtremes().y(), 0);
-    vertices.append(vertex);
-
-    vertex.start = QVector3D(sNan, 1, 1);
-    vertex.position = QVector3D(getMaximumExtremes().x(), getMaximumExtremes().y(), 0);
-    vertices.append(vertex);
-
-    if (!image.isNull()) {
-        m_texture = new QOpenGLTexture(image);
-        m_triangles += vertices;
-        m_image = image;
-    } else {
-        for (auto & vertex : vertices) vertex.start = QVector3D(sNan, sNan, sNan);
-        m_lines += vertices;
-        m_image = QImage();
+    for (int i = 0; i < m_tiles.size(); i++) {
+        QImage const &tile = m_tiles.at(i);
+        double const x0 = m_rasterOrigin.x() + (i % m_tilesX) * rasterTileSize * m_rasterPixelSize;
+        double const y0 = m_rasterOrigin.y() + (i / m_tilesX) * rasterTileSize * m_rasterPixelSize;
+        double const x1 = x0 + tile.width() * m_rasterPixelSize;
+        double const y1 = y0 + tile.height() * m_rasterPixelSize;
+
+        vertex.start = QVector3D(sNan, 0, 0);
+        vertex.position = QVector3D(x0, y0, 0);
+        m_triangles.append(vertex);
+
+        vertex.start = QVector3D(sNan, 1, 1);
+        vertex.position = QVector3D(x1, y1, 0);
+        m_triangles.append(vertex);
+
+        vertex.start = QVector3D(sNan, 0, 1);
+        vertex.position = QVector3D(x0, y1, 0);
+        m_triangles.append(vertex);
+
+        vertex.start = QVector3D(sNan, 0, 0);
+        vertex.position = QVector3D(x0, y0, 0);
+        m_triangles.append(vertex);
+
+        vertex.start = QVector3D(sNan, 1, 0);
+        vertex.position = QVector3D(x1, y0, 0);
+        m_triangles.append(vertex);
+
+        vertex.start = QVector3D(sNan, 1, 1);
+        vertex.position = QVector3D(x1, y1, 0);
+        m_triangles.append(vertex);
+
+        // Mipmapped texture
+        m_textures.append(new QOpenGLTexture(tile));
+        m_textures.last()->setWrapMode(QOpenGLTexture::ClampToEdge);
     }
 
     m_geometryUpdated = true;
@@ -293,43 +612,128 @@ bool GcodeDrawer::prepareRaster()
 
 bool GcodeDrawer::updateRaster()
 {
-    if (!m_image.isNull()) {
+    if (!m_tiles.isEmpty()) {
 
         auto &list = m_viewParser->getLines();
+        QVector<bool> dirty(m_tiles.size(), false);
+
+        foreach (int i, m_indexes) {
+            LineSegment const &segment = list.at(i);
+            QVector3D const center = segment.isAnalyticArc() ? m_viewParser->arcCenter(i) : QVector3D();
+            rasterizeSegment(segment, center, 0, m_rasterSize.height());
+
+            // Mark tiles under segment bounds, arc bulge included
+            QVector3D lower(qMin(segment.getStart().x(), segment.getEnd().x()), qMin(segment.getStart().y(), segment.getEnd().y()), 0);
+            QVector3D upper(qMax(segment.getStart().x(), segment.getEnd().x()), qMax(segment.getStart().y(), segment.getEnd().y()), 0);
+            if (segment.isAnalyticArc()) {
+                for (auto const &point : GcodePreprocessorUtils::getArcExtremePoints(segment.plane(), segment.getStart(),
+                                                                                     segment.getEnd(), center,
+                                                                                     segment.isClockwise())) {
+                    lower = QVector3D(qMin(lower.x(), point.x()), qMin(lower.y(), point.y()), 0);
+                    upper = QVector3D(qMax(upper.x(), point.x()), qMax(upper.y(), point.y()), 0);
+                }
+            }
 
-        double pixelSize = m_viewParser->getMinLength();
-        QVector3D origin = m_viewParser->getMinimumExtremes();
+            QPointF const start = (QPointF(lower.x(), lower.y()) - m_rasterOrigin) / m_rasterPixelSize;
+            QPointF const end = (QPointF(upper.x(), upper.y()) - m_rasterOrigin) / m_rasterPixelSize;
+            if (qIsNaN(start.x()) || qIsNaN(start.y()) || qIsNaN(end.x()) || qIsNaN(end.y())) continue;
 
-        foreach (int i, m_indexes) setImagePixelColor(m_image, (list.at(i).getEnd().x() - origin.x()) / pixelSize,
-                                                      (list.at(i).getEnd().y() - origin.y()) / pixelSize, getSegmentColor(list.at(i)).rgb());
+            int const tilesY = m_tiles.size() / m_tilesX;
+            int const tx0 = qBound(0, (int)qMin(start.x(), end.x()) / rasterTileSize, m_tilesX - 1);
+            int const tx1 = qBound(0, (int)qMax(start.x(), end.x()) / rasterTileSize, m_tilesX - 1);
+            int const ty0 = qBound(0, (int)qMin(start.y(), end.y()) / rasterTileSize, tilesY - 1);
+            int const ty1 = qBound(0, (int)qMax(start.y(), end.y()) / rasterTileSize, tilesY - 1);
+            for (int ty = ty0; ty <= ty1; ty++) for (int tx = tx0; tx <= tx1; tx++) dirty[ty * m_tilesX + tx] = true;
+        }
 
-        if (m_texture) m_texture->setData(QOpenGLTexture::RGB, QOpenGLTexture::UInt8, m_image.constBits());
+        // Upload dirty tiles only
+        for (int i = 0; i < m_tiles.size() && i < m_textures.size(); i++) if (dirty.at(i)) {
+            m_textures[i]->setData(QOpenGLTexture::RGB, QOpenGLTexture::UInt8, m_tiles.at(i).constBits());
+            m_textures[i]->generateMipMaps();
+        }
     }
 
     m_indexes.clear();
     return false;
 }
 
-void GcodeDrawer::setImagePixelColor(QImage &image, double x, double y, QRgb color) const
+void GcodeDrawer::rasterizeSegment(LineSegment const &segment, QVector3D const &center, int top, int bottom)
 {
-    if (qIsNaN(x) || qIsNaN(y)) {
-        qDebug() << "Error updating pixel" << x << y;
+    if (segment.isFastTraverse() ? !drawRapidMotion() : !drawLinearMotion()) return;
+
+    QRgb const color = getSegmentColor(segment).rgb();
+
+    if (!segment.isAnalyticArc()) {
+        rasterizeLine(segment.getStart(), segment.getEnd(), color, top, bottom);
         return;
-    };
+    }
+
+    // Arc chords deviate by half of pixel at most
+    QVector3D start = segment.getStart();
+    for (auto const &end : segment.arcPoints(center, m_rasterPixelSize / 2)) {
+        rasterizeLine(start, end, color, top, bottom);
+        start = end;
+    }
+}
 
-    uchar* pixel = image.scanLine((int)y);
+void GcodeDrawer::rasterizeLine(QVector3D const &start, QVector3D const &end, QRgb color, int top, int bottom)
+{
+    double x0 = (start.x() - m_rasterOrigin.x()) / m_rasterPixelSize;
+    double y0 = (start.y() - m_rasterOrigin.y()) / m_rasterPixelSize;
+    double const x1 = (end.x() - m_rasterOrigin.x()) / m_rasterPixelSize;
+    double const y1 = (end.y() - m_rasterOrigin.y()) / m_rasterPixelSize;
+
+    if (qIsNaN(x1) || qIsNaN(y1)) return;
+
+    // First segment could have undefined start
+    if (qIsNaN(x0) || qIsNaN(y0)) {
+        x0 = x1;
+        y0 = y1;
+    }
+
+    // Skip segments outside of band
+    if (qMax(y0, y1) < top || qMin(y0, y1) >= bottom) return;
+
+    // Walk along major axis, one pixel per step
+    int const steps = qCeil(qMax(qAbs(x1 - x0), qAbs(y1 - y0)));
+    double const dx = steps ? (x1 - x0) / steps : 0;
+    double const dy = steps ? (y1 - y0) / steps : 0;
+
+    // Clip steps to band
+    int first = 0;
+    int last = steps;
+    if (dy != 0) {
+        double const t0 = (top - y0) / dy;
+        double const t1 = (bottom - y0) / dy;
+        first = qMax(first, (int)floor(qMin(t0, t1)));
+        last = qMin(last, (int)ceil(qMax(t0, t1)));
+    }
 
-    *(pixel + (int)x * 3) = qRed(color);
-    *(pixel + (int)x * 3 + 1) = qGreen(color);
-    *(pixel + (int)x * 3 + 2) = qBlue(color);
+    for (int i = first; i <= last; i++) {
+        int const y = (int)(y0 + dy * i);
+        if (y < top || y >= bottom) continue;
+        setRasterPixel((int)(x0 + dx * i), y, color);
+    }
 }
 
-VertColVec GcodeDrawer::getSegmentColorVector(LineSegment const &segment)
+void GcodeDrawer::setRasterPixel(int x, int y, QRgb color)
+{
+    if (x < 0 || y < 0 || x >= m_rasterSize.width() || y >= m_rasterSize.height()) return;
+
+    uchar* pixel = m_tiles[(y / rasterTileSize) * m_tilesX + x / rasterTileSize].scanLine(y % rasterTileSize)
+            + (x % rasterTileSize) * 3;
+
+    *pixel = qRed(color);
+    *(pixel + 1) = qGreen(color);
+    *(pixel + 2) = qBlue(color);
+}
+
+VertColVec GcodeDrawer::getSegmentColorVector(LineSegment const &segment) const
 {
     return VertColVec{getSegmentColor(segment)};
 }
 
-QColor GcodeDrawer::getSegmentColor(LineSegment const &segment)
+QColor GcodeDrawer::getSegmentColor(LineSegment const &segment) const
 {
     if (segment.drawn()) return m_colorDrawn;//QVector3D(0.85, 0.85, 0.85);
     else if (segment.isHightlight()) return m_colorHighlight;//QVector3D(0.57, 0.51, 0.9);
@@ -354,13 +758,16 @@ QVector3D GcodeDrawer::getSizes()
     QVector3D min = m_viewParser->getMinimumExtremes();
     QVector3D max = m_viewParser->getMaximumExtremes();
 
-    return QVector3D(max.x() - min.x(), max.y() - min.y(), max.z() - min.z());
+    // Heightmap offset is applied in vertex shader
+    return QVector3D(max.x() - min.x(), max.y() - min.y(),
+                     max.z() - min.z() + heightMapOffsetMaximum() - heightMapOffsetMinimum());
 }
 
 QVector3D GcodeDrawer::getMinimumExtremes()
 {
     QVector3D v = m_viewParser->getMinimumExtremes();
     if (m_ignoreZ) v.setZ(0);
+    v.setZ(v.z() + heightMapOffsetMinimum());
 
     return v;
 }
@@ -369,6 +776,7 @@ QVector3D GcodeDrawer::getMaximumExtremes()
 {
     QVector3D v = m_viewParser->getMaximumExtremes();
     if (m_ignoreZ) v.setZ(0);
+    v.setZ(v.z() + heightMapOffsetMaximum());
 
     return v;
 }
@@ -481,6 +889,23 @@ void GcodeDrawer::setIgnoreZ(bool ignoreZ)
     m_ignoreZ = ignoreZ;
 }
 
+double GcodeDrawer::arcTolerance() const
+{
+    return m_arcTolerance;
+}
+
+void GcodeDrawer::setArcTolerance(double arcTolerance)
+{
+    m_arcTolerance = arcTolerance;
+    updateArcLevels();
+}
+
+void GcodeDrawer::setViewScale(ViewScale const &scale)
+{
+    m_viewScale = scale;
+    updateArcLevels();
+}
+
 void GcodeDrawer::onTimerVertexUpdate()
 {
     if (!m_indexes.empty()) ShaderDrawable::update();
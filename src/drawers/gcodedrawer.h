@@ -9,6 +9,9 @@
 #include "parser/linesegment.h"
 #include "parser/gcodeviewparse.h"
 #include "shaderdrawable.h"
+#include <atomic>
+#include <memory>
+#include <thread>
 #include <vector>
 
 
@@ -26,6 +29,7 @@ public:
     enum DrawMode { Vectors, Raster };
 
     explicit GcodeDrawer();
+    ~GcodeDrawer() override;
 
     void update();
     void update(int index);
@@ -95,6 +99,12 @@ public:
     bool drawControlPoints() const;
     void setDrawControlPoints(bool value);
 
+    /// \brief chord deviation of analytic arcs on screen, pixels
+    double arcTolerance() const;
+    void setArcTolerance(double arcTolerance);
+
+    void setViewScale(ViewScale const &scale) override;
+
 signals:
 
 public slots:
@@ -130,19 +140,80 @@ private:
 
     QTimer m_timerVertexUpdate;
 
-    QImage m_image;
+    // Raster mode tiles, each tile has own texture
+    static constexpr int rasterTileSize = 1024;
+    static constexpr double maxRasterPixels = 64e6;
+    QVector<QImage> m_tiles;
+    int m_tilesX = 0;
+    QSize m_rasterSize;
+    QPointF m_rasterOrigin;
+    double m_rasterPixelSize = 0;
+
     indexContainer m_indexes;
     bool m_geometryUpdated;
 
+    // Analytic arcs of view parser, copied for tessellation worker
+    struct Arc
+    {
+        QVector3D start;
+        QVector3D end;
+        QVector3D center;
+        PointSegment::planes plane;
+        bool clockwise;
+    };
+
+    // Consecutive arcs tessellated with chord deviation of 2^level
+    struct ArcChunk
+    {
+        int first;
+        int last;
+        QVector3D min;
+        QVector3D max;
+        int level;
+        std::vector<QVector3D> points;  // Arc points including start one
+        std::vector<int> offsets;       // First point of each arc, last - first + 1 items
+    };
+
+    static constexpr int arcsPerChunk = 1024;
+    static constexpr double defaultArcDeviation = 0.01;
+    static constexpr double minArcDeviation = 0.0001;
+
+    double m_arcTolerance = 0.5;
+    ViewScale m_viewScale;
+    std::vector<int> m_arcSegments;                 // Segment index of each arc, ascending
+    std::shared_ptr<std::vector<Arc> const> m_arcs;
+    std::vector<ArcChunk> m_arcChunks;
+    std::vector<int> m_arcLevels;                   // Levels requested from worker
+    std::vector<int> m_arcVertexOffsets;            // First vertex of each arc in m_vertices, arcs + 1 items
+    bool m_arcsChanged = false;
+
+    std::thread m_arcThread;
+    std::atomic<bool> m_arcCancelled{false};
+    int m_arcGeneration = 0;
+
     bool prepareVectors();
+    void generateVectors(LineSegment::Container &list, int first, int last, VertexData *lines, VertexData *points,
+                         int lineOffset, int &linesCount, int &pointsCount) const;
     bool updateVectors();
+    void updateSegmentColor(LineSegment::Container const &list, int index, VertexData *data);
+    void prepareArcs();
+    void clearArcs();
+    int arcLevel(ArcChunk const &chunk) const;
+    void updateArcLevels();
+    static void tessellateArcs(std::vector<Arc> const &arcs, ArcChunk &chunk);
+    void updateArcVertices();
+    bool updateArcs();
+    void stopArcTessellation();
     bool prepareRaster();
     bool updateRaster();
 
     static int getSegmentType(LineSegment const &segment);
-    VertColVec getSegmentColorVector(LineSegment const &segment);
-    QColor getSegmentColor(LineSegment const &segment);
-    void setImagePixelColor(QImage &image, double x, double y, QRgb color) const;
+    VertColVec getSegmentColorVector(LineSegment const &segment) const;
+    QColor getSegmentColor(LineSegment const &segment) const;
+    /// \brief \a center is centre of analytic arc segment
+    void rasterizeSegment(LineSegment const &segment, QVector3D const &center, int top, int bottom);
+    void rasterizeLine(QVector3D const &start, QVector3D const &end, QRgb color, int top, int bottom);
+    void setRasterPixel(int x, int y, QRgb color);
 };
 
 #endif // GCODEDRAWER_H
@@ -6,80 +6,165 @@
 HeightMapInterpolationDrawer::HeightMapInterpolationDrawer()
 {
     m_data = NULL;
+    m_pointsX = 0;
+    m_pointsY = 0;
+    m_surfaceVisible = false;
+    m_wireframeVisible = true;
 }
 
 bool HeightMapInterpolationDrawer::updateData()
 {
     // Check if data is present
-    if (!m_data || m_data->count() == 0) {
-        m_lines.clear();
+    if (!m_data || m_data->count() == 0 || m_data->at(0).count() == 0) {
+        m_vertices.clear();
+        m_triangleIndexes.clear();
+        m_lineIndexes.clear();
+        m_region = QRect();
+        m_pointsX = 0;
+        m_pointsY = 0;
         return true;
     }
 
-    QColor color;
+    if (!m_region.isEmpty() && m_data->count() == m_pointsY && m_data->at(0).count() == m_pointsX) return updateMesh();
 
-    // Clear data
-    m_lines.clear();
+    return prepareMesh();
+}
 
-    // Prepare vertex
-    VertexData vertex;
-    vertex.start = QVector3D(sNan, sNan, sNan);
+bool HeightMapInterpolationDrawer::prepareMesh()
+{
+    m_region = QRect();
 
     // Calculate grid parameters
-    int interpolationPointsX = m_data->at(0).size();
-    int interpolationPointsY = m_data->count();
+    m_pointsX = m_data->at(0).size();
+    m_pointsY = m_data->count();
 
-    double interpolationStepX = interpolationPointsX > 1 ? m_borderRect.width() / (interpolationPointsX - 1) : 0;
-    double interpolationStepY = interpolationPointsY > 1 ? m_borderRect.height() / (interpolationPointsY - 1) : 0;
+    // Vertex per grid point, row by row
+    m_vertices.resize(m_pointsX * m_pointsY);
+    m_valid.resize(m_vertices.size());
 
-    // Find min & max values for coloring
-    double min = m_data->at(0).at(0);
-    double max = min;
-
-    for (int i = 0; i < interpolationPointsY; i++) {
-        for (int j = 0; j < interpolationPointsX; j++) {
-            min = Util::nMin(min, m_data->at(i).at(j));
-            max = Util::nMax(max, m_data->at(i).at(j));
+    for (int i = 0; i < m_pointsY; i++) {
+        for (int j = 0; j < m_pointsX; j++) {
+            m_vertices[i * m_pointsX + j] = vertex(j, i);
+            m_valid[i * m_pointsX + j] = !qIsNaN(m_data->at(i).at(j));
         }
     }
 
-    // Horizontal lines
-    for (int i = 0; i < interpolationPointsY; i++) {
-        for (int j = 1; j < interpolationPointsX; j++) {
-            if (qIsNaN(m_data->at(i).at(j))) continue;
-            color.setHsvF(0.67 * (max - m_data->at(i).at(j - 1)) / (max - min), 1.0, 1.0);
-            vertex.color = VertColVec(color);
+    m_rowMinimum.resize(m_pointsY);
+    m_rowMaximum.resize(m_pointsY);
+    updateRange(0, m_pointsY - 1);
 
-            vertex.position = QVector3D(m_borderRect.x() + interpolationStepX * (j - 1), m_borderRect.y() + interpolationStepY * i, m_data->at(i).at(j - 1));
-            m_lines.append(vertex);
+    prepareIndexes();
 
-            color.setHsvF(0.67 * (max - m_data->at(i).at(j)) / (max - min), 1.0, 1.0);
-            vertex.color = VertColVec(color);
+    return true;
+}
 
-            vertex.position = QVector3D(m_borderRect.x() + interpolationStepX * j, m_borderRect.y() + interpolationStepY * i, m_data->at(i).at(j));
-            m_lines.append(vertex);
+bool HeightMapInterpolationDrawer::updateMesh()
+{
+    QRect const region = m_region.intersected(QRect(0, 0, m_pointsX, m_pointsY));
+    m_region = QRect();
+    if (region.isEmpty()) return false;
+
+    // Map buffer
+    auto data = (VertexData*)m_vbo.map(QOpenGLBuffer::WriteOnly);
+    int const offset = verticesOffset();
+    bool validChanged = false;
+
+    for (int i = region.top(); i <= region.bottom(); i++) {
+        for (int j = region.left(); j <= region.right(); j++) {
+            int const index = i * m_pointsX + j;
+            char const valid = !qIsNaN(m_data->at(i).at(j));
+
+            validChanged |= m_valid[index] != valid;
+            m_valid[index] = valid;
+            m_vertices[index] = vertex(j, i);
+            if (data) data[offset + index] = m_vertices.at(index);
         }
     }
 
-    // Vertical lines
-    for (int j = 0; j < interpolationPointsX; j++) {
-        for (int i = 1; i < interpolationPointsY; i++) {
-            if (qIsNaN(m_data->at(i).at(j))) continue;
-            color.setHsvF(0.67 * (max - m_data->at(i - 1).at(j)) / (max - min), 1.0, 1.0);
-            vertex.color = VertColVec(color);
+    updateRange(region.top(), region.bottom());
+
+    if (data) m_vbo.unmap();
 
-            vertex.position = QVector3D(m_borderRect.x() + interpolationStepX * j, m_borderRect.y() + interpolationStepY * (i - 1), m_data->at(i - 1).at(j));
-            m_lines.append(vertex);
+    // Primitives are drawn between interpolated points only
+    if (validChanged) {
+        prepareIndexes();
+        if (data) updateIndexes();
+    }
 
-            color.setHsvF(0.67 * (max - m_data->at(i).at(j)) / (max - min), 1.0, 1.0);
-            vertex.color = VertColVec(color);
+    return !data;
+}
 
-            vertex.position = QVector3D(m_borderRect.x() + interpolationStepX * j, m_borderRect.y() + interpolationStepY * i, m_data->at(i).at(j));
-            m_lines.append(vertex);
+void HeightMapInterpolationDrawer::prepareIndexes()
+{
+    m_triangleIndexes.clear();
+    m_lineIndexes.clear();
+
+    auto const valid = [&](int column, int row) { return m_valid[row * m_pointsX + column] != 0; };
+    auto const index = [&](int column, int row) { return static_cast<GLuint>(row * m_pointsX + column); };
+
+    if (m_surfaceVisible) {
+        for (int i = 1; i < m_pointsY; i++) {
+            for (int j = 1; j < m_pointsX; j++) {
+                if (!valid(j - 1, i - 1) || !valid(j, i - 1) || !valid(j - 1, i) || !valid(j, i)) continue;
+                m_triangleIndexes += { index(j - 1, i - 1), index(j, i - 1), index(j, i),
+                                       index(j - 1, i - 1), index(j, i), index(j - 1, i) };
+            }
         }
     }
 
-    return true;
+    if (m_wireframeVisible) {
+        // Horizontal lines
+        for (int i = 0; i < m_pointsY; i++) {
+            for (int j = 1; j < m_pointsX; j++) {
+                if (valid(j - 1, i) && valid(j, i)) m_lineIndexes += { index(j - 1, i), index(j, i) };
+            }
+        }
+
+        // Vertical lines
+        for (int j = 0; j < m_pointsX; j++) {
+            for (int i = 1; i < m_pointsY; i++) {
+                if (valid(j, i - 1) && valid(j, i)) m_lineIndexes += { index(j, i - 1), index(j, i) };
+            }
+        }
+    }
+}
+
+void HeightMapInterpolationDrawer::updateRange(int firstRow, int lastRow)
+{
+    // Rescan changed rows only, coloring range is combined from row ranges
+    for (int i = firstRow; i <= lastRow; i++) {
+        double min = qQNaN();
+        double max = qQNaN();
+        for (double value : m_data->at(i)) {
+            min = Util::nMin(min, value);
+            max = Util::nMax(max, value);
+        }
+        m_rowMinimum[i] = min;
+        m_rowMaximum[i] = max;
+    }
+
+    double min = qQNaN();
+    double max = qQNaN();
+    for (int i = 0; i < m_pointsY; i++) {
+        min = Util::nMin(min, m_rowMinimum[i]);
+        max = Util::nMax(max, m_rowMaximum[i]);
+    }
+
+    if (qIsNaN(min)) resetZColorRange(); else setZColorRange(min, max);
+}
+
+VertexData HeightMapInterpolationDrawer::vertex(int column, int row) const
+{
+    double const stepX = m_pointsX > 1 ? m_borderRect.width() / (m_pointsX - 1) : 0;
+    double const stepY = m_pointsY > 1 ? m_borderRect.height() / (m_pointsY - 1) : 0;
+    double const z = m_data->at(row).at(column);
+
+    VertexData vertex;
+    vertex.position = QVector3D(m_borderRect.x() + stepX * column, m_borderRect.y() + stepY * row, qIsNaN(z) ? 0 : z);
+    vertex.color = VertColVec(QColor(Qt::white));
+    vertex.start = QVector3D(sNan, sNan, sNan);
+
+    return vertex;
 }
 
 QVector<QVector<double> > *HeightMapInterpolationDrawer::data() const
@@ -90,6 +175,15 @@ QVector<QVector<double> > *HeightMapInterpolationDrawer::data() const
 void HeightMapInterpolationDrawer::setData(QVector<QVector<double> > *data)
 {
     m_data = data;
+    m_pointsX = 0;
+    m_pointsY = 0;
+    m_region = QRect();
+    update();
+}
+
+void HeightMapInterpolationDrawer::updateRegion(QRect const &region)
+{
+    m_region = m_region.united(region);
     update();
 }
 QRectF HeightMapInterpolationDrawer::borderRect() const
@@ -102,6 +196,35 @@ void HeightMapInterpolationDrawer::setBorderRect(const QRectF &borderRect)
     m_borderRect = borderRect;
 }
 
+bool HeightMapInterpolationDrawer::surfaceVisible() const
+{
+    return m_surfaceVisible;
+}
+
+void HeightMapInterpolationDrawer::setSurfaceVisible(bool visible)
+{
+    if (m_surfaceVisible == visible) return;
+
+    // Indexes are rebuilt with full mesh
+    m_surfaceVisible = visible;
+    m_region = QRect();
+    update();
+}
+
+bool HeightMapInterpolationDrawer::wireframeVisible() const
+{
+    return m_wireframeVisible;
+}
+
+void HeightMapInterpolationDrawer::setWireframeVisible(bool visible)
+{
+    if (m_wireframeVisible == visible) return;
+
+    // Indexes are rebuilt with full mesh
+    m_wireframeVisible = visible;
+    m_region = QRect();
+    update();
+}
 
 
 
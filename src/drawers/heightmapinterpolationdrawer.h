@@ -8,9 +8,14 @@
 #include <QVector>
 #include <QVector3D>
 #include <QColor>
+#include <QRect>
 #include "shaderdrawable.h"
 #include "utils/util.h"
+#include <vector>
 
+/// \brief Interpolated heightmap as shared vertex mesh
+/// Grid points are vertices, triangles & wireframe are drawn by indexes. Colors are
+/// calculated in shader from Z, so data updates touch changed vertices only.
 class HeightMapInterpolationDrawer : public ShaderDrawable
 {
 public:
@@ -18,19 +23,38 @@ public:
 
     QVector<QVector<double> > *data() const;
     void setData(QVector<QVector<double> > *data);
+    /// \brief vertices of points in region of data (x - column, y - row) are patched in place on next update
+    void updateRegion(QRect const &region);
 
     QRectF borderRect() const;
     void setBorderRect(const QRectF &borderRect);
 
+    bool surfaceVisible() const;
+    void setSurfaceVisible(bool visible);
+    bool wireframeVisible() const;
+    void setWireframeVisible(bool visible);
+
 protected:
     bool updateData();
 
 private:
     QRectF m_borderRect;
-    double m_gridSize;
     QVector<QVector<double>> *m_data;
-    double Min(double v1, double v2);
-    double Max(double v1, double v2);
+    QRect m_region;
+    int m_pointsX;
+    int m_pointsY;
+    bool m_surfaceVisible;
+    bool m_wireframeVisible;
+
+    std::vector<char> m_valid; // Point is interpolated, by vertex
+    std::vector<double> m_rowMinimum;
+    std::vector<double> m_rowMaximum;
+
+    bool prepareMesh();
+    bool updateMesh();
+    void prepareIndexes();
+    void updateRange(int firstRow, int lastRow);
+    VertexData vertex(int column, int row) const;
 };
 
 #endif // HEIGHTMAPINTERPOLATIONDRAWER_H
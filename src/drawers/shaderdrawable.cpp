@@ -1,20 +1,48 @@
 ﻿//#define sNan qQNaN();
 
 #include "shaderdrawable.h"
+#include "utils/heightmapsurface.h"
+#include <QVector4D>
 #include <cstddef>
 ShaderDrawable::ShaderDrawable()
+    : m_ibo(QOpenGLBuffer::IndexBuffer)
 {
     m_needsUpdateGeometry = true;
+    m_needsRepaint = true;
     m_visible = true;
     m_lineWidth = 1.0;
     m_pointSize = 1.0;
-    m_texture = NULL;
+
+    m_heightMapTexture = nullptr;
+    m_heightMapMinimum = 0;
+    m_heightMapRange = 0;
+    m_heightMapEnabled = false;
+    m_heightMapChanged = false;
+
+    m_zColorMinimum = 0;
+    m_zColorMaximum = 0;
+    m_zColorEnabled = false;
 }
 
 ShaderDrawable::~ShaderDrawable()
 {
-    if (!m_vao.isCreated()) m_vao.destroy();
-    if (!m_vbo.isCreated()) m_vbo.destroy();
+    // Objects of destroyed context are already freed with it
+    if (!m_context) {
+        qDeleteAll(m_textures);
+        delete m_heightMapTexture;
+        return;
+    }
+
+    bool const current = QOpenGLContext::currentContext() == m_context;
+    if (!current) m_context->makeCurrent(m_surface);
+
+    qDeleteAll(m_textures);
+    delete m_heightMapTexture;
+    if (m_vao.isCreated()) m_vao.destroy();
+    if (m_vbo.isCreated()) m_vbo.destroy();
+    if (m_ibo.isCreated()) m_ibo.destroy();
+
+    if (!current) m_context->doneCurrent();
 }
 
 void ShaderDrawable::init()
@@ -22,9 +50,13 @@ void ShaderDrawable::init()
     // Init openGL functions
     initializeOpenGLFunctions();
 
+    m_context = QOpenGLContext::currentContext();
+    m_surface = m_context ? m_context->surface() : nullptr;
+
     // Create buffers
     m_vao.create();
     m_vbo.create();
+    m_ibo.create();
 }
 
 void ShaderDrawable::update()
@@ -78,10 +110,14 @@ void ShaderDrawable::updateGeometry(QOpenGLShaderProgram *shaderProgram)
         QVector<VertexData> vertexData(m_triangles);
         vertexData += m_lines;
         vertexData += m_points;
+        vertexData += m_vertices;
         m_vbo.allocate(vertexData.constData(), vertexData.size() * sizeof(VertexData));
+
+        // Index buffer binding is stored in vao
+        updateIndexes();
     } else {
         m_vbo.release();
-        if (m_vao.isCreated()) m_vao.release();
+        if (m_vao.isCreated()) m_vao.release(); else if (m_ibo.isCreated()) m_ibo.release();
         m_needsUpdateGeometry = false;
         return;
     }
@@ -90,13 +126,33 @@ void ShaderDrawable::updateGeometry(QOpenGLShaderProgram *shaderProgram)
         setAttributes(shaderProgram);
 
         m_vao.release();
-    }
+    } else if (m_ibo.isCreated()) m_ibo.release();
 
     m_vbo.release();
 
     m_needsUpdateGeometry = false;
 }
 
+int ShaderDrawable::verticesOffset() const
+{
+    return m_triangles.size() + m_lines.size() + m_points.size();
+}
+
+void ShaderDrawable::updateIndexes()
+{
+    if (m_triangleIndexes.isEmpty() && m_lineIndexes.isEmpty()) return;
+
+    // Indexes are relative to m_vertices
+    QVector<GLuint> indexes(m_triangleIndexes);
+    indexes += m_lineIndexes;
+
+    GLuint const offset = verticesOffset();
+    if (offset > 0) for (GLuint &index : indexes) index += offset;
+
+    m_ibo.bind();
+    m_ibo.allocate(indexes.constData(), indexes.size() * sizeof(GLuint));
+}
+
 bool ShaderDrawable::updateData()
 {
     // Test data
@@ -117,8 +173,15 @@ bool ShaderDrawable::needsUpdateGeometry() const
     return m_needsUpdateGeometry;
 }
 
+bool ShaderDrawable::needsRepaint() const
+{
+    return m_needsRepaint || m_needsUpdateGeometry;
+}
+
 void ShaderDrawable::draw(QOpenGLShaderProgram *shaderProgram)
 {
+    m_needsRepaint = false;
+
     if (!m_visible) return;
 
     if (m_vao.isCreated()) {
@@ -127,16 +190,25 @@ void ShaderDrawable::draw(QOpenGLShaderProgram *shaderProgram)
     } else {
         // Prepare vbo
         m_vbo.bind();
+        if (m_ibo.isCreated()) m_ibo.bind();
 
         setAttributes(shaderProgram);
     }
 
+    setHeightMapUniforms(shaderProgram);
+    shaderProgram->setUniformValue("z_color", QVector3D(m_zColorMinimum, m_zColorMaximum, m_zColorEnabled ? 1 : 0));
+
     if (!m_triangles.isEmpty()) {
-        if (m_texture) {
-            m_texture->bind();
+        if (m_textures.isEmpty()) {
+            glDrawArrays(GL_TRIANGLES, 0, m_triangles.size());
+        } else {
+            // Each texture covers own quad
             shaderProgram->setUniformValue("texture", 0);
+            for (int i = 0; i < m_textures.size(); i++) {
+                m_textures.at(i)->bind();
+                glDrawArrays(GL_TRIANGLES, i * 6, 6);
+            }
         }
-        glDrawArrays(GL_TRIANGLES, 0, m_triangles.size());
     }
 
     if (!m_lines.isEmpty()) {
@@ -148,7 +220,20 @@ void ShaderDrawable::draw(QOpenGLShaderProgram *shaderProgram)
         glDrawArrays(GL_POINTS, m_triangles.size() + m_lines.size(), m_points.size());
     }
 
-    if (m_vao.isCreated()) m_vao.release(); else m_vbo.release();
+    if (!m_triangleIndexes.isEmpty()) {
+        glDrawElements(GL_TRIANGLES, m_triangleIndexes.size(), GL_UNSIGNED_INT, nullptr);
+    }
+
+    if (!m_lineIndexes.isEmpty()) {
+        glLineWidth(m_lineWidth);
+        glDrawElements(GL_LINES, m_lineIndexes.size(), GL_UNSIGNED_INT,
+                       reinterpret_cast<void*>(static_cast<quintptr>(m_triangleIndexes.size()) * sizeof(GLuint)));
+    }
+
+    if (m_vao.isCreated()) m_vao.release(); else {
+        m_vbo.release();
+        if (m_ibo.isCreated()) m_ibo.release();
+    }
 }
 
 QVector3D ShaderDrawable::getSizes()
@@ -168,7 +253,12 @@ QVector3D ShaderDrawable::getMaximumExtremes()
 
 int ShaderDrawable::getVertexCount()
 {
-    return m_lines.size() + m_points.size() + m_triangles.size();
+    return m_lines.size() + m_points.size() + m_triangles.size() + m_vertices.size();
+}
+
+void ShaderDrawable::setViewScale(ViewScale const &scale)
+{
+    Q_UNUSED(scale)
 }
 
 double ShaderDrawable::lineWidth() const
@@ -178,6 +268,7 @@ double ShaderDrawable::lineWidth() const
 
 void ShaderDrawable::setLineWidth(double lineWidth)
 {
+    if (m_lineWidth != lineWidth) m_needsRepaint = true;
     m_lineWidth = lineWidth;
 }
 
@@ -188,6 +279,7 @@ bool ShaderDrawable::visible() const
 
 void ShaderDrawable::setVisible(bool visible)
 {
+    if (m_visible != visible) m_needsRepaint = true;
     m_visible = visible;
 }
 
@@ -198,7 +290,120 @@ double ShaderDrawable::pointSize() const
 
 void ShaderDrawable::setPointSize(double pointSize)
 {
+    if (m_pointSize != pointSize) m_needsRepaint = true;
     m_pointSize = pointSize;
 }
 
+void ShaderDrawable::setHeightMap(HeightMapSurface const &surface)
+{
+    int const columns = surface.columns();
+    int const rows = surface.rows();
+
+    m_heightMapRect = surface.borderRect();
+    m_heightMapSize = QSize(columns, rows);
+
+    // Heights are packed relative to range of probed points, so 8 bit texture keeps 24 bit precision
+    double minimum = qQNaN();
+    double maximum = qQNaN();
+    for (int row = 0; row < rows; row++) for (int column = 0; column < columns; column++) {
+        minimum = Util::nMin(minimum, surface.value(column, row));
+        maximum = Util::nMax(maximum, surface.value(column, row));
+    }
+    m_heightMapMinimum = qIsNaN(minimum) ? 0 : minimum;
+    m_heightMapRange = qIsNaN(maximum) ? 0 : maximum - minimum;
+
+    m_heightMapData.resize(columns * rows * 4);
+    uchar *data = reinterpret_cast<uchar*>(m_heightMapData.data());
+
+    for (int row = 0; row < rows; row++) for (int column = 0; column < columns; column++) {
+        double const value = surface.value(column, row);
+
+        // Not probed points are marked by zero alpha
+        quint32 packed = 0;
+        if (!qIsNaN(value) && m_heightMapRange > 0) packed = qRound((value - m_heightMapMinimum) / m_heightMapRange * 16777215.0);
+
+        data[0] = packed >> 16;
+        data[1] = (packed >> 8) & 0xff;
+        data[2] = packed & 0xff;
+        data[3] = qIsNaN(value) ? 0 : 0xff;
+        data += 4;
+    }
+
+    m_heightMapChanged = true;
+    m_needsRepaint = true;
+}
+
+bool ShaderDrawable::heightMapEnabled() const
+{
+    return m_heightMapEnabled;
+}
+
+void ShaderDrawable::setHeightMapEnabled(bool enabled)
+{
+    if (m_heightMapEnabled != enabled) m_needsRepaint = true;
+    m_heightMapEnabled = enabled;
+}
+
+double ShaderDrawable::heightMapOffsetMinimum() const
+{
+    return m_heightMapEnabled ? m_heightMapMinimum : 0;
+}
+
+double ShaderDrawable::heightMapOffsetMaximum() const
+{
+    return m_heightMapEnabled ? m_heightMapMinimum + m_heightMapRange : 0;
+}
+
+void ShaderDrawable::setZColorRange(double minimum, double maximum)
+{
+    if (!m_zColorEnabled || m_zColorMinimum != minimum || m_zColorMaximum != maximum) m_needsRepaint = true;
+    m_zColorMinimum = minimum;
+    m_zColorMaximum = maximum;
+    m_zColorEnabled = true;
+}
+
+void ShaderDrawable::resetZColorRange()
+{
+    if (m_zColorEnabled) m_needsRepaint = true;
+    m_zColorEnabled = false;
+}
+
+void ShaderDrawable::setHeightMapUniforms(QOpenGLShaderProgram *shaderProgram)
+{
+    // Upload changed base points in current context
+    if (m_heightMapChanged && !m_heightMapData.isEmpty()) {
+        if (m_heightMapTexture && (m_heightMapTexture->width() != m_heightMapSize.width()
+                                   || m_heightMapTexture->height() != m_heightMapSize.height())) {
+            delete m_heightMapTexture;
+            m_heightMapTexture = nullptr;
+        }
+
+        if (m_heightMapTexture == nullptr) {
+            m_heightMapTexture = new QOpenGLTexture(QOpenGLTexture::Target2D);
+            m_heightMapTexture->setSize(m_heightMapSize.width(), m_heightMapSize.height());
+            m_heightMapTexture->setFormat(QOpenGLTexture::RGBA8_UNorm);
+            m_heightMapTexture->setMinMagFilters(QOpenGLTexture::Nearest, QOpenGLTexture::Nearest);
+            m_heightMapTexture->setWrapMode(QOpenGLTexture::ClampToEdge);
+            m_heightMapTexture->allocateStorage();
+        }
+
+        m_heightMapTexture->setData(QOpenGLTexture::RGBA, QOpenGLTexture::UInt8, m_heightMapData.constData());
+        m_heightMapChanged = false;
+    }
+
+    bool const enabled = m_heightMapEnabled && m_heightMapTexture != nullptr
+            && m_heightMapSize.width() > 1 && m_heightMapSize.height() > 1;
+
+    shaderProgram->setUniformValue("height_map_enabled", enabled ? 1 : 0);
+    if (!enabled) return;
+
+    m_heightMapTexture->bind(1, QOpenGLTexture::ResetTextureUnit);
+    shaderProgram->setUniformValue("height_map", 1);
+    shaderProgram->setUniformValue("height_map_rect", QVector4D(m_heightMapRect.x(), m_heightMapRect.y(),
+                                                                m_heightMapRect.width() / (m_heightMapSize.width() - 1),
+                                                                m_heightMapRect.height() / (m_heightMapSize.height() - 1)));
+    shaderProgram->setUniformValue("height_map_grid", QVector4D(m_heightMapSize.width(), m_heightMapSize.height(),
+                                                                m_heightMapMinimum, m_heightMapRange));
+}
+
 
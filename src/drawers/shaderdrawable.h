@@ -7,8 +7,14 @@
 #include <QOpenGLBuffer>
 #include <QOpenGLVertexArrayObject>
 #include <QOpenGLTexture>
+#include <QOpenGLContext>
+#include <QPointer>
+#include <QMatrix4x4>
+#include <QRectF>
 #include "utils/util.h"
 
+class HeightMapSurface;
+
 #define sNan 65536.0
 
 struct VertexData
@@ -18,6 +24,19 @@ struct VertexData
     QVector3D start;
 };
 
+/// \brief scale of perspective view, world size of screen pixel grows linearly with depth of point
+struct ViewScale
+{
+    QMatrix4x4 view;            // World to eye space
+    double depthScale = 0;      // Pixel size at unit depth, 0 - view is not known
+    double nearDepth = 0;
+
+    [[nodiscard]] double pixelSize(QVector3D const &point) const
+    {
+        return qMax<double>(-view.map(point).z(), nearDepth) * depthScale;
+    }
+};
+
 class ShaderDrawable : protected QOpenGLFunctions
 {
 public:
@@ -27,6 +46,7 @@ public:
     void draw(QOpenGLShaderProgram *shaderProgram);
 
     bool needsUpdateGeometry() const;
+    bool needsRepaint() const;
     void updateGeometry(QOpenGLShaderProgram *shaderProgram = 0);
 
     virtual QVector3D getSizes();
@@ -34,6 +54,9 @@ public:
     virtual QVector3D getMaximumExtremes();
     virtual int getVertexCount();
 
+    /// \brief called by widget on view change, geometry may be refined for new scale
+    virtual void setViewScale(ViewScale const &scale);
+
     double lineWidth() const;
     void setLineWidth(double lineWidth);
 
@@ -43,6 +66,18 @@ public:
     double pointSize() const;
     void setPointSize(double pointSize);
 
+    /// \brief base points of surface are uploaded as texture, vertex shader offsets Z by bicubic lookup
+    void setHeightMap(HeightMapSurface const &surface);
+    bool heightMapEnabled() const;
+    void setHeightMapEnabled(bool enabled);
+    /// \brief range of Z offsets by probed base points, 0 if heightmap is disabled
+    double heightMapOffsetMinimum() const;
+    double heightMapOffsetMaximum() const;
+
+    /// \brief vertex colors are replaced in shader with hue by Z, from blue at minimum to red at maximum
+    void setZColorRange(double minimum, double maximum);
+    void resetZColorRange();
+
 signals:
 
 public slots:
@@ -54,18 +89,46 @@ protected:
     QVector<VertexData> m_lines;
     QVector<VertexData> m_points;
     QVector<VertexData> m_triangles;
-    QOpenGLTexture *m_texture;
+    QVector<QOpenGLTexture*> m_textures; // Textures of consecutive 6-vertex quads of m_triangles
+    QVector<VertexData> m_vertices; // Shared vertices of indexed primitives
+    QVector<GLuint> m_triangleIndexes; // Indexes of m_vertices
+    QVector<GLuint> m_lineIndexes;
 
     QOpenGLBuffer m_vbo; // Protected for direct vbo access
 
     virtual bool updateData();
     void init();
+    /// \brief first vertex of m_vertices in vertex buffer
+    int verticesOffset() const;
+    /// \brief upload indexes only, vertices are kept
+    void updateIndexes();
 
 private:
     void setAttributes(QOpenGLShaderProgram *shaderProgram);
+    void setHeightMapUniforms(QOpenGLShaderProgram *shaderProgram);
     QOpenGLVertexArrayObject m_vao;
+    QOpenGLBuffer m_ibo;
+
+    // Context of GL objects, made current to free them on destruction
+    QPointer<QOpenGLContext> m_context;
+    QSurface *m_surface = nullptr;
+
+    // Heightmap base points, 24 bit fixed point packed to RGB, row by row
+    QByteArray m_heightMapData;
+    QOpenGLTexture *m_heightMapTexture;
+    QRectF m_heightMapRect;
+    QSize m_heightMapSize;
+    double m_heightMapMinimum;
+    double m_heightMapRange;
+    bool m_heightMapEnabled;
+    bool m_heightMapChanged;
+
+    double m_zColorMinimum;
+    double m_zColorMaximum;
+    bool m_zColorEnabled;
 
     bool m_needsUpdateGeometry;
+    bool m_needsRepaint;
 };
 
 #endif // SHADERDRAWABLE_H
@@ -26,6 +26,7 @@
 #include <QStringList>
 #include <QTextBlock>
 #include <QTextCursor>
+#include <QInputDialog>
 #include <QMessageBox>
 #include <QComboBox>
 #include <QScrollBar>
@@ -33,8 +34,10 @@
 #include <QAction>
 #include <QLayout>
 #include <QMimeData>
+#include <algorithm>
 #include <array>
 #include <QBuffer>
+#include "utils/heightmapfile.h"
 #include "utils/profile.h"
 #include "frmmain.h"
 #include "ui_frmmain.h"
@@ -160,10 +163,10 @@ frmMain::frmMain(QWidget *parent) :
     ui->slbFeedOverride->setSuffix("%");
     connect(ui->slbFeedOverride, &SliderBox::toggled, this, &frmMain::onOverridingToggled);
     connect(ui->slbFeedOverride, &SliderBox::toggled, [=] {
-        updateProgramEstimatedTime(m_currentDrawer->viewParser()->getLineSegmentList());
+        updateEstimatedTime();
     });
     connect(ui->slbFeedOverride, &SliderBox::valueChanged, [=] {
-        updateProgramEstimatedTime(m_currentDrawer->viewParser()->getLineSegmentList());
+        updateEstimatedTime();
     });
 
     ui->slbRapidOverride->setRatio(50);
@@ -174,10 +177,10 @@ frmMain::frmMain(QWidget *parent) :
     ui->slbRapidOverride->setSuffix("%");
     connect(ui->slbRapidOverride, &SliderBox::toggled, this, &frmMain::onOverridingToggled);
     connect(ui->slbRapidOverride, &SliderBox::toggled, [=] {
-        updateProgramEstimatedTime(m_currentDrawer->viewParser()->getLineSegmentList());
+        updateEstimatedTime();
     });
     connect(ui->slbRapidOverride, &SliderBox::valueChanged, [=] {
-        updateProgramEstimatedTime(m_currentDrawer->viewParser()->getLineSegmentList());
+        updateEstimatedTime();
     });
 
     ui->slbSpindleOverride->setRatio(1);
@@ -225,7 +228,6 @@ frmMain::frmMain(QWidget *parent) :
     connect(ui->glwVisualizer, &GLWidget::rotationChanged, this, &frmMain::onVisualizatorRotationChanged);
     connect(ui->glwVisualizer, &GLWidget::resized, this, &frmMain::placeVisualizerButtons);
     connect(&m_programModel, &GCodeTableModel::dataChanged, this,  &frmMain::onTableCellChanged);
-    connect(&m_programHeightmapModel, &GCodeTableModel::dataChanged, this, &frmMain::onTableCellChanged);
     connect(&m_probeModel, &GCodeTableModel::dataChanged, this, &frmMain::onTableCellChanged);
     connect(&m_heightMapModel, &HeightMapTableModel::dataChangedByUserInput, this, [=](){updateHeightMapInterpolationDrawer();});
 
@@ -304,6 +306,7 @@ frmMain::frmMain(QWidget *parent) :
 
 frmMain::~frmMain()
 {    
+    stopProgramTimeEstimation();
     saveSettings();
 
     delete m_senderErrorBox;
@@ -362,6 +365,9 @@ void frmMain::loadSettings()
     m_settings->setBaud(set.value("baud").toInt());
     m_settings->setIgnoreErrors(set.value("ignoreErrors", false).toBool());
     m_settings->setAutoLine(set.value("autoLine", true).toBool());
+    m_settings->setCompactCommands(set.value("compactCommands", false).toBool());
+    m_settings->setCompactDecimals(set.value("compactDecimals", -1).toInt());
+    m_settings->setRemoveRedundantWords(set.value("removeRedundantWords", true).toBool());
     m_settings->setToolDiameter(set.value("toolDiameter", 3).toDouble());
     m_settings->setToolLength(set.value("toolLength", 15).toDouble());
     m_settings->setAntialiasing(set.value("antialiasing", true).toBool());
@@ -379,6 +385,8 @@ void frmMain::loadSettings()
     m_settings->setArcLength(set.value("arcLength", 0).toDouble());
     m_settings->setArcDegree(set.value("arcDegree", 0).toDouble());
     m_settings->setArcDegreeMode(set.value("arcDegreeMode", true).toBool());
+    m_settings->setAdaptiveArcs(set.value("adaptiveArcs", false).toBool());
+    m_settings->setArcTolerance(set.value("arcTolerance", 0.5).toDouble());
     m_settings->setShowProgramCommands(set.value("showProgramCommands", 0).toBool());
     m_settings->setShowUICommands(set.value("showUICommands", 0).toBool());
     m_settings->setSpindleSpeedMin(set.value("spindleSpeedMin", 0).toInt());
@@ -391,6 +399,7 @@ void frmMain::loadSettings()
     m_settings->setToolAngle(set.value("toolAngle", 0).toDouble());
     m_settings->setToolType(set.value("toolType", 0).toInt());
     m_settings->setFps(set.value("fps", 60).toInt());
+    m_settings->setIdleFps(set.value("idleFps", 1).toInt());
     m_settings->setQueryStateTime(set.value("queryStateTime", 250).toInt());
 
     m_settings->setShowLinearMotion(set.value("showLinearMotion", true).toBool());//chkRapidMotion
@@ -476,11 +485,18 @@ void frmMain::loadSettings()
     ui->txtHeightMapGridZTop->setValue(set.value("heightmapGridZTop", 1).toDouble());
     ui->txtHeightMapGridZBottom->setValue(set.value("heightmapGridZBottom", -1).toDouble());
     ui->chkHeightMapGridShow->setChecked(set.value("heightmapGridShow", false).toBool());
+    ui->chkHeightMapAdaptive->setChecked(set.value("heightmapAdaptive", false).toBool());
+    ui->txtHeightMapAdaptiveTolerance->setValue(set.value("heightmapAdaptiveTolerance", 0.02).toDouble());
 
     ui->txtHeightMapInterpolationStepX->setValue(set.value("heightmapInterpolationStepX", 1).toDouble());
     ui->txtHeightMapInterpolationStepY->setValue(set.value("heightmapInterpolationStepY", 1).toDouble());
     ui->cboHeightMapInterpolationType->setCurrentIndex(set.value("heightmapInterpolationType", 0).toInt());
     ui->chkHeightMapInterpolationShow->setChecked(set.value("heightmapInterpolationShow", false).toBool());
+    ui->chkHeightMapInterpolationSurface->setChecked(set.value("heightmapInterpolationSurface", false).toBool());
+    ui->chkHeightMapInterpolationWireframe->setChecked(set.value("heightmapInterpolationWireframe", true).toBool());
+    m_heightMapInterpolationDrawer.setSurfaceVisible(ui->chkHeightMapInterpolationSurface->isChecked());
+    m_heightMapInterpolationDrawer.setWireframeVisible(ui->chkHeightMapInterpolationWireframe->isChecked());
+    ui->txtHeightMapTolerance->setValue(set.value("heightmapTolerance", 0.005).toDouble());
 
     foreach (ColorPicker* pick, m_settings->colors()) {
             auto colorName = pick->objectName().mid(3);
@@ -524,6 +540,9 @@ void frmMain::saveSettings()
     set.setValue("baud", m_settings->baud());
     set.setValue("ignoreErrors", m_settings->ignoreErrors());
     set.setValue("autoLine", m_settings->autoLine());
+    set.setValue("compactCommands", m_settings->compactCommands());
+    set.setValue("compactDecimals", m_settings->compactDecimals());
+    set.setValue("removeRedundantWords", m_settings->removeRedundantWords());
     set.setValue("toolDiameter", m_settings->toolDiameter());
     set.setValue("toolLength", m_settings->toolLength());
     set.setValue("antialiasing", m_settings->antialiasing());
@@ -541,6 +560,8 @@ void frmMain::saveSettings()
     set.setValue("arcLength", m_settings->arcLength());
     set.setValue("arcDegree", m_settings->arcDegree());
     set.setValue("arcDegreeMode", m_settings->arcDegreeMode());
+    set.setValue("adaptiveArcs", m_settings->adaptiveArcs());
+    set.setValue("arcTolerance", m_settings->arcTolerance());
     set.setValue("showProgramCommands", m_settings->showProgramCommands());
     set.setValue("showUICommands", m_settings->showUICommands());
     set.setValue("spindleSpeedMin", m_settings->spindleSpeedMin());
@@ -555,6 +576,7 @@ void frmMain::saveSettings()
     set.setValue("toolAngle", m_settings->toolAngle());
     set.setValue("toolType", m_settings->toolType());
     set.setValue("fps", m_settings->fps());
+    set.setValue("idleFps", m_settings->idleFps());
     set.setValue("queryStateTime", m_settings->queryStateTime());
     set.setValue("autoScroll", ui->chkAutoScroll->isChecked());
     set.setValue("header", ui->tblProgram->horizontalHeader()->saveState());
@@ -618,11 +640,16 @@ void frmMain::saveSettings()
     set.setValue("heightmapGridZTop", ui->txtHeightMapGridZTop->value());
     set.setValue("heightmapGridZBottom", ui->txtHeightMapGridZBottom->value());
     set.setValue("heightmapGridShow", ui->chkHeightMapGridShow->isChecked());
+    set.setValue("heightmapAdaptive", ui->chkHeightMapAdaptive->isChecked());
+    set.setValue("heightmapAdaptiveTolerance", ui->txtHeightMapAdaptiveTolerance->value());
 
     set.setValue("heightmapInterpolationStepX", ui->txtHeightMapInterpolationStepX->value());
     set.setValue("heightmapInterpolationStepY", ui->txtHeightMapInterpolationStepY->value());
     set.setValue("heightmapInterpolationType", ui->cboHeightMapInterpolationType->currentIndex());
     set.setValue("heightmapInterpolationShow", ui->chkHeightMapInterpolationShow->isChecked());
+    set.setValue("heightmapInterpolationSurface", ui->chkHeightMapInterpolationSurface->isChecked());
+    set.setValue("heightmapInterpolationWireframe", ui->chkHeightMapInterpolationWireframe->isChecked());
+    set.setValue("heightmapTolerance", ui->txtHeightMapTolerance->value());
 
     foreach (ColorPicker* pick, m_settings->colors()) {
         set.setValue(pick->objectName().mid(3), pick->color().name(QColor::HexArgb));
@@ -696,6 +723,10 @@ void frmMain::updateControlsState() {
                                                       || (m_recentHeightmaps.size() > 0 && m_heightMapMode)));
     ui->actFileSave->setEnabled(m_programModel.rowCount() > 1);
     ui->actFileSaveAs->setEnabled(m_programModel.rowCount() > 1);
+    ui->actFileCheck->setEnabled(!m_processingFile && !m_heightMapMode && m_programModel.rowCount() > 1);
+    ui->actProgramFitArcs->setEnabled(!m_processingFile && !m_heightMapMode && m_programModel.rowCount() > 1);
+    ui->actProgramMergeSegments->setEnabled(!m_processingFile && !m_heightMapMode && m_programModel.rowCount() > 1);
+    ui->actProgramReorderRapids->setEnabled(!m_processingFile && !m_heightMapMode && m_programModel.rowCount() > 1);
 
     ui->tblProgram->setEditTriggers(m_processingFile ? QAbstractItemView::NoEditTriggers :
                                                          QAbstractItemView::DoubleClicked | QAbstractItemView::SelectedClicked
@@ -796,6 +827,9 @@ void frmMain::sendCommand(QString command, int tableIndex, bool showInConsole)
         return;
     }
 
+    // Modal state and position known to preprocessor are lost on commands bypassing it
+    if (tableIndex < 0 && command != "$G" && command != "$#") m_sendPreprocessor.reset();
+
     CommandAttributes ca;
 
 //    if (!(command == "$G" && tableIndex < -1) && !(command == "$#" && tableIndex < -1)
@@ -952,6 +986,7 @@ void frmMain::onSerialPortReadyRead()
                     int elapsed = m_startTime.elapsed();
                     ui->glwVisualizer->setSpendTime(time.addMSecs(elapsed));
                 }
+                updateEstimatedTime();
 
                 // Test for job complete
                 if (m_processingFile && m_transferCompleted &&
@@ -1060,7 +1095,7 @@ void frmMain::onSerialPortReadyRead()
                 for (int i = m_lastDrawnLineIndex; i < static_cast<int>(list.size())
                      && list[i].getLineNumber()
                      <= (m_currentModel->data(m_currentModel->index(m_fileProcessedCommandIndex, 4)).toInt() + 1); i++) {
-                    if (list[i].contains(toolPosition)) {
+                    if (list[i].contains(toolPosition, parser->arcCenter(i))) {
                         toolOntoolpath = true;
                         m_lastDrawnLineIndex = i;
                         break;
@@ -1209,6 +1244,32 @@ void frmMain::onSerialPortReadyRead()
                         }
                     }
 
+                    // Store machine limits for time estimation and program check
+                    if (ca.command == "$$" && ca.tableIndex == -2) {
+                        static QRegularExpression const rx("\\$(\\d+)=([-\\d\\.]+)");
+                        auto it = rx.globalMatch(response);
+                        while (it.hasNext()) {
+                            auto const match = it.next();
+                            int const number = match.captured(1).toInt();
+                            double const value = match.captured(2).toDouble();
+
+                            if (number == 11) m_machine.junctionDeviation = value;
+                            else if (number == 12) m_machine.arcTolerance = value;
+                            else if (number >= 110 && number <= 112) m_machine.maxRate[number - 110] = value;
+                            else if (number >= 120 && number <= 122) m_machine.acceleration[number - 120] = value;
+                            else {
+                                if (number == 20) m_softLimits = value != 0;
+                                else if (number >= 100 && number <= 102) m_stepsPerMm[number - 100] = value;
+                                else if (number >= 130 && number <= 132) m_maxTravel[number - 130] = value;
+                                continue;
+                            }
+
+                            m_machineReceived = true;
+                        }
+                        if (m_machineReceived) updateProgramEstimatedTime(m_currentDrawer->viewParser());
+                        updateSendPreprocessor();
+                    }
+
                     // Homing response
                     if ((ca.command.toUpper() == "$H" || ca.command.toUpper() == "$T") && m_homing) m_homing = false;
 
@@ -1216,6 +1277,7 @@ void frmMain::onSerialPortReadyRead()
                     if (ca.command == "[CTRL+X]") {
                         m_resetCompleted = true;
                         m_updateParserStatus = true;
+                        sendCommand("$$", -2, m_settings->showUICommands());
                     }
 
                     // Clear command buffer on "M2" & "M30" command (old firmwares)
@@ -1244,15 +1306,23 @@ void frmMain::onSerialPortReadyRead()
                             // Calculate delta Z
                             z -= firstZ;
 
-                            // Calculate table indexes
-                            int row = trunc(m_probeIndex / m_heightMapModel.columnCount());
-                            int column = m_probeIndex - row * m_heightMapModel.columnCount();
-                            if (row % 2) column = m_heightMapModel.columnCount() - 1 - column;
-
-                            // Store Z in table
-                            m_heightMapModel.setData(m_heightMapModel.index(row, column), z, Qt::UserRole);
-                            ui->tblHeightMap->update(m_heightMapModel.index(m_heightMapModel.rowCount() - 1 - row, column));
-                            updateHeightMapInterpolationDrawer();
+                            // Table indexes of probed point
+                            if (m_probeIndex < static_cast<int>(m_probePoints.size())) {
+                                QPoint const point = m_probePoints[m_probeIndex];
+                                int const row = point.y();
+                                int const column = point.x();
+
+                                // Store Z in table
+                                m_heightMapModel.setData(m_heightMapModel.index(row, column), z, Qt::UserRole);
+                                ui->tblHeightMap->update(m_heightMapModel.index(m_heightMapModel.rowCount() - 1 - row, column));
+                                updateHeightMapInterpolationPoint(column, row);
+
+                                // Queue next level points when current level is probed
+                                if (m_adaptiveProbing.isValid()) {
+                                    m_adaptiveProbing.setValue(point, z);
+                                    if (m_probeIndex == static_cast<int>(m_probePoints.size()) - 1) refineAdaptiveProbing();
+                                }
+                            }
                         }
 
                         m_probeIndex++;
@@ -1296,8 +1366,10 @@ void frmMain::onSerialPortReadyRead()
                     // Add response to table, send next program commands
                     if (m_processingFile) {
 
-                        // Only if command from table
-                        if (ca.tableIndex > -1) {
+                        // Only if command from table, row is processed with last of its compensated commands
+                        if (ca.tableIndex > -1 && ca.tableIndex < m_fileCommandIndex
+                                && std::none_of(m_commands.cbegin(), m_commands.cend(),
+                                                [&](CommandAttributes const &c) { return c.tableIndex == ca.tableIndex; })) {
                             m_currentModel->setData(m_currentModel->index(ca.tableIndex, 2), GCodeItem::Processed);
                             m_currentModel->setData(m_currentModel->index(ca.tableIndex, 3), response.toUtf8());
 
@@ -1412,6 +1484,8 @@ void frmMain::onSerialPortReadyRead()
 
                     m_commands.clear();
                     m_queue.clear();
+                    m_compensatedCommands.clear();
+                    m_sendPreprocessor.reset();
 
                     updateControlsState();
                 }
@@ -1710,7 +1784,8 @@ void frmMain::loadFile(QIODevice &data, qint64 bytesAvailable)
     // Reset tables
     clearTable();
     m_probeModel.clear();
-    m_programHeightmapModel.clear();
+    m_viewParser.setSubdivisionStep(QSizeF());
+    m_codeDrawer->setHeightMapEnabled(false);
     m_currentModel = &m_programModel;
 
     // Reset parsers
@@ -1721,7 +1796,7 @@ void frmMain::loadFile(QIODevice &data, qint64 bytesAvailable)
     m_currentDrawer = m_codeDrawer;
     m_codeDrawer->update();
     ui->glwVisualizer->fitDrawable(m_codeDrawer);
-    updateProgramEstimatedTime(LineSegment::Container());
+    updateProgramEstimatedTime(&m_viewParser);
 
     // Update interface
     ui->chkHeightMapUse->setChecked(false);
@@ -1747,6 +1822,7 @@ void frmMain::loadFile(QIODevice &data, qint64 bytesAvailable)
     // Prepare model
     auto &model_data = m_programModel.data();
     model_data.clear();
+    m_modalStateIndex.clear();
 
     QProgressDialog progress(tr("Opening file..."), tr("Abort"), 0, 0, this);
     if (bytesAvailable == 0) {
@@ -1779,6 +1855,7 @@ void frmMain::loadFile(QIODevice &data, qint64 bytesAvailable)
             auto &args = item.args;
             args = GcodePreprocessorUtils::splitCommand(trimmed);
             gp.addCommand(args);
+            m_modalStateIndex.addCommand(args);
 
             item.state = GCodeItem::InQueue;
             item.line = gp.getCommandNumber();
@@ -1801,7 +1878,8 @@ void frmMain::loadFile(QIODevice &data, qint64 bytesAvailable)
 
     PROFILE_SCOPE_RESTART("view parser filled")
 
-    updateProgramEstimatedTime(m_viewParser.getLinesFromParser(&gp, m_settings->arcPrecision(), m_settings->arcDegreeMode()));
+    m_viewParser.getLinesFromParser(&gp, m_settings->arcPrecision(), m_settings->arcDegreeMode());
+    updateProgramEstimatedTime(&m_viewParser);
 
     m_programLoading = false;
 
@@ -1855,37 +1933,76 @@ void frmMain::loadFile(const QString& fileName)
     loadFile(file);
 }
 
-QTime frmMain::updateProgramEstimatedTime(LineSegment::Container const &lines)
+void frmMain::updateProgramEstimatedTime(GcodeViewParse *parser)
 {
-    double time = 0;
+    stopProgramTimeEstimation();
+
+    ui->glwVisualizer->setSpendTime(QTime(0, 0, 0));
+
+    parser->setTimeIndex(ProgramTimeIndex());
+    int const generation = ++m_estimationGeneration;
+    updateEstimatedTime();
+
+    if (parser->getLineSegmentList().empty()) return;
+
+    // Simulate planner on worker, result is dropped if estimation was restarted meanwhile
+    m_estimationCancelled = false;
+    // Compensated program is estimated, as it's sent
+    TimeEstimator estimator(estimationMachine());
+    if (parser == m_codeDrawer->viewParser() && m_codeDrawer->heightMapEnabled())
+        estimator.setHeightMap(m_heightMapCompensator.surface());
+
+    m_estimationThread = std::thread([this, parser, generation, estimator = std::move(estimator),
+                                      lines = parser->sharedLines(), arcs = parser->sharedArcCenters()]() mutable {
+        if (!estimator.estimate(*lines, *arcs, &m_estimationCancelled)) return;
 
-    for (auto const &ls : lines) {
-    //    foreach (LineSegment *ls, lines) {
-        double length = (ls.getEnd() - ls.getStart()).length();
+        QMetaObject::invokeMethod(this, [this, parser, generation, timeIndex = estimator.timeIndex()]() mutable {
+            if (generation != m_estimationGeneration) return;
 
-        if (!qIsNaN(length) && !qIsNaN(ls.getSpeed()) && ls.getSpeed() != 0) time +=
-                length / ((ui->slbFeedOverride->isChecked() && !ls.isFastTraverse())
-                          ? (ls.getSpeed() * ui->slbFeedOverride->value() / 100) :
-                            (ui->slbRapidOverride->isChecked() && ls.isFastTraverse())
-                             ? (ls.getSpeed() * ui->slbRapidOverride->value() / 100) : ls.getSpeed());        // TODO: Update for rapid override
+            parser->setTimeIndex(std::move(timeIndex));
+            updateEstimatedTime();
+        }, Qt::QueuedConnection);
+    });
+}
 
-//        qDebug() << "length/time:" << length << ((ui->chkFeedOverride->isChecked() && !ls.isFastTraverse())
-//                                                 ? (ls.getSpeed() * ui->txtFeed->value() / 100) : ls.getSpeed())
-//                 << time;
+void frmMain::updateEstimatedTime()
+{
+    // Overrides scale stored feed & rapid times, no simulation needed
+    ProgramTimeIndex const &timeIndex = m_currentDrawer->viewParser()->timeIndex();
+    double const feed = ui->slbFeedOverride->isChecked() ? ui->slbFeedOverride->value() / 100.0 : 1.0;
+    double const rapid = ui->slbRapidOverride->isChecked() ? ui->slbRapidOverride->value() / 100.0 : 1.0;
 
-//        if (qIsNaN(length)) qDebug() << "length nan:" << i << ls.getLineNumber() << ls.getStart() << ls.getEnd();
-//        if (qIsNaN(ls.getSpeed())) qDebug() << "speed nan:" << ls.getSpeed();
+    ui->glwVisualizer->setEstimatedTime(QTime(0, 0, 0).addSecs(qRound(timeIndex.total(feed, rapid))));
+
+    if (m_processingFile && !timeIndex.isEmpty()) {
+        // Acknowledged commands wait in planner buffer, time is left from line of segment tool is on
+        auto const &list = m_currentDrawer->viewParser()->getLineSegmentList();
+        int const line = m_lastDrawnLineIndex < static_cast<int>(list.size()) ? list[m_lastDrawnLineIndex].getLineNumber()
+                                                                              : timeIndex.lineCount();
+        ui->glwVisualizer->setRemainingTime(QTime(0, 0, 0).addSecs(qRound(timeIndex.remaining(line - 1, feed, rapid))));
+    } else {
+        ui->glwVisualizer->setRemainingTime(QTime());
     }
+}
 
-    time *= 60;
+void frmMain::stopProgramTimeEstimation()
+{
+    if (!m_estimationThread.joinable()) return;
 
-    QTime t(0,0,0);
+    m_estimationCancelled = true;
+    m_estimationThread.join();
+}
+
+TimeEstimator::Machine frmMain::estimationMachine() const
+{
+    if (m_machineReceived) return m_machine;
 
-    ui->glwVisualizer->setSpendTime(t);
-    t = t.addSecs(time);
-    ui->glwVisualizer->setEstimatedTime(t);
+    // Same limits on all axes from settings until controller reports its own
+    TimeEstimator::Machine machine;
+    if (m_settings->rapidSpeed() > 0) machine.maxRate = QVector3D(1, 1, 1) * m_settings->rapidSpeed();
+    if (m_settings->acceleration() > 0) machine.acceleration = QVector3D(1, 1, 1) * m_settings->acceleration();
 
-    return t;
+    return machine;
 }
 
 void frmMain::clearTable()
@@ -1940,6 +2057,7 @@ void frmMain::onActSendFromLineTriggered()
     int commandIndex = ui->tblProgram->currentIndex().row();
 
     // Set parser state
+    m_resumeMotion.clear();
     if (m_settings->autoLine()) {
         GcodeViewParse *parser = m_currentDrawer->viewParser();
         auto const & list = parser->getLineSegmentList();
@@ -1948,39 +2066,33 @@ void frmMain::onActSendFromLineTriggered()
         int lineNumber = m_currentModel->data(m_currentModel->index(commandIndex, 4)).toInt();
         LineSegment const * firstSegment = &list.at(lineIndexes.at(lineNumber).front());
         int segmentIndex = lineIndexes.at(lineNumber).back();
-        LineSegment const * lastSegment = &list.at(segmentIndex);
-        LineSegment const * feedSegment = lastSegment;
-//#if 1
-//        int segmentIndex = -1;
-//        auto it = std::find(list.begin(), list.end(), feedSegment);
-//        if(it != list.end())
-//            segmentIndex = std::distance(list.begin(), it);
-//#else
-//        int segmentIndex = list.indexOf(feedSegment);
-//#endif
+        LineSegment const * feedSegment = &list.at(segmentIndex);
         while (feedSegment->isFastTraverse() && segmentIndex > 0) feedSegment = &list.at(--segmentIndex);
 
-        QStringList commands;
+        // Segments Z is offset by heightmap on sending
+        QVector3D firstStart = firstSegment->getStart();
+        if (isHeightMapCompensated()) firstStart = m_heightMapCompensator.map(firstStart);
 
-        commands.append(QString("M3 S%1").arg(qMax<double>(lastSegment->getSpindleSpeed(), ui->slbSpindle->value())));
+        // Modal state before selected line, other models are applied from start
+        auto const &modelData = m_currentModel->data();
+        ModalStateIndex const empty;
+        ModalStateIndex const &index = m_currentModel == &m_programModel ? m_modalStateIndex : empty;
+        ModalStateIndex::State const state = index.state(commandIndex, [&](int i) -> QByteArrayList const & {
+            return modelData.at(i).args;
+        });
 
+        // Plunge at program feed, mm/min
+        double const feed = state.feed > 0 && state.feedMode == 940
+                ? (state.units == 200 ? state.feed * 25.4 : state.feed) : feedSegment->getSpeed();
+
+        QStringList commands = state.setupCommands();
         commands.append(QString("G21 G90 G0 X%1 Y%2")
-                        .arg(firstSegment->getStart().x())
-                        .arg(firstSegment->getStart().y()));
-        commands.append(QString("G1 Z%1 F%2")
-                        .arg(firstSegment->getStart().z())
-                        .arg(feedSegment->getSpeed()));
-
-        commands.append(QString("%1 %2 %3 F%4")
-                        .arg(lastSegment->isMetric() ? "G21" : "G20")
-                        .arg(lastSegment->isAbsolute() ? "G90" : "G91")
-                        .arg(lastSegment->isFastTraverse() ? "G0" : "G1")
-                        .arg(lastSegment->isMetric() ? feedSegment->getSpeed() : feedSegment->getSpeed() / 25.4));
-
-        if (lastSegment->isArc()) {
-            commands.append(lastSegment->plane() == PointSegment::XY ? "G17"
-            : lastSegment->plane() == PointSegment::ZX ? "G18" : "G19");
-        }
+                        .arg(firstStart.x())
+                        .arg(firstStart.y()));
+        commands.append(QString("G94 G1 Z%1 F%2")
+                        .arg(firstStart.z())
+                        .arg(feed));
+        commands.append(state.motionCommand());
 
         QMessageBox box(this);
         box.setIcon(QMessageBox::Information);
@@ -1995,6 +2107,9 @@ void frmMain::onActSendFromLineTriggered()
             for (auto const & command : commands) {
                 sendCommand(command, -1, m_settings->showUICommands());
             }
+
+            // Implicit arc move of selected line needs arc motion mode
+            m_resumeMotion = state.arcMotionWord().toLatin1();
         }
     }
 
@@ -2002,13 +2117,17 @@ void frmMain::onActSendFromLineTriggered()
     m_fileProcessedCommandIndex = commandIndex;
     m_lastDrawnLineIndex = 0;
     m_probeIndex = -1;
+    resetHeightMapCompensator(commandIndex);
 
     auto & list = m_viewParser.getLineSegmentList();
 
+    // Only segments changing drawn state are updated
     indexContainer indexes;
     auto &modelData = m_currentModel->data();
     for (int i = 0; i < static_cast<int>(list.size()); i++) {
-        list[i].setDrawn(list[i].getLineNumber() < modelData[commandIndex].line);
+        bool const drawn = list[i].getLineNumber() < modelData[commandIndex].line;
+        if (list[i].drawn() == drawn) continue;
+        list[i].setDrawn(drawn);
         indexes.push_back(i);
     }
     m_codeDrawer->update(indexes);
@@ -2091,18 +2210,50 @@ void frmMain::restoreOffsets()
 void frmMain::sendNextFileCommands() {
     if (m_queue.length() > 0) return;
 
-    QString command = feedOverride(m_currentModel->data(m_currentModel->index(m_fileCommandIndex, 1)).toString());
+    // Preprocessor state is committed only when compacted command is sent, commands bypassing
+    // preprocessor may reset it while next command waits for buffer space
+    SendPreprocessor preprocessor;
+    QString command = nextFileCommand(preprocessor);
 
     while ((bufferLength() + command.length() + 1) <= BUFFERLENGTH
            && m_fileCommandIndex < m_currentModel->rowCount() - 1
            && !(!m_commands.isEmpty() && m_commands.last().command.contains(QRegularExpression("M0*2|M30")))) {
         m_currentModel->setData(m_currentModel->index(m_fileCommandIndex, 2), GCodeItem::Sent);
+        m_sendPreprocessor = preprocessor;
         sendCommand(command, m_fileCommandIndex, m_settings->showProgramCommands());
-        m_fileCommandIndex++;
-        command = feedOverride(m_currentModel->data(m_currentModel->index(m_fileCommandIndex, 1)).toString());
+
+        // Row is done when all its compensated commands are sent
+        m_compensatedCommands.removeFirst();
+        if (m_compensatedCommands.isEmpty()) m_fileCommandIndex++;
+
+        command = nextFileCommand(preprocessor);
     }
 }
 
+QString frmMain::nextFileCommand(SendPreprocessor &preprocessor)
+{
+    if (m_fileCommandIndex >= m_currentModel->rowCount() - 1) return QString();
+
+    // Compensate one row ahead of sending
+    if (m_compensatedCommands.isEmpty()) {
+        auto const &item = m_currentModel->data().at(m_fileCommandIndex);
+        if (isHeightMapCompensated()) {
+            m_compensatedCommands = m_heightMapCompensator.compensate(item.command, item.args);
+        } else if (!m_resumeMotion.isEmpty() && !ModalStateIndex::hasMotionWord(item.args)) {
+            m_compensatedCommands.append(m_resumeMotion + item.command);
+        } else {
+            m_compensatedCommands.append(item.command);
+        }
+        m_resumeMotion.clear();
+    }
+
+    // Compact against state of commands actually sent
+    preprocessor = m_sendPreprocessor;
+    if (m_currentModel != &m_programModel) return feedOverride(m_compensatedCommands.first());
+
+    return feedOverride(preprocessor.process(m_compensatedCommands.first()));
+}
+
 void frmMain::onTableCellChanged(QModelIndex i1, QModelIndex i2)
 {
     Q_UNUSED(i2)
@@ -2126,9 +2277,6 @@ void frmMain::onTableCellChanged(QModelIndex i1, QModelIndex i2)
         // Clear cached args
         model->setData(model->index(i1.row(), 5), QVariant());
 
-        // Drop heightmap cache
-        if (m_currentModel == &m_programModel) m_programHeightmapModel.clear();
-
         // Update visualizer
         updateParser();
 
@@ -2219,9 +2367,6 @@ void frmMain::onTableDeleteLines()
         m_currentModel->removeRows(firstRow.row(), rowsCount);
     } else return;
 
-    // Drop heightmap cache
-    if (m_currentModel == &m_programModel) m_programHeightmapModel.clear();
-
     updateParser();
     m_cellChanged = true;
     ui->tblProgram->selectRow(firstRow.row());
@@ -2275,6 +2420,7 @@ void frmMain::applySettings() {
     ui->glwVisualizer->setZBuffer(m_settings->zBuffer());
     ui->glwVisualizer->setVsync(m_settings->vsync());
     ui->glwVisualizer->setFps(m_settings->fps());
+    ui->glwVisualizer->setIdleFps(m_settings->idleFps());
     ui->glwVisualizer->setColorBackground(m_settings->colors("VisualizerBackground"));
     ui->glwVisualizer->setColorText(m_settings->colors("VisualizerText"));
 
@@ -2312,10 +2458,16 @@ void frmMain::applySettings() {
     m_codeDrawer->setDrawRapidMotion(m_settings->showRapidMotion());
     m_codeDrawer->setDrawRapidMotionDashed(m_settings->showRapidMotionDashed());
     m_codeDrawer->setDrawControlPoints(m_settings->showControlPoints());
+    m_codeDrawer->setArcTolerance(m_settings->arcTolerance());
     m_codeDrawer->update();
 
+    // Applied on next parse, as arc precision
+    m_viewParser.setAnalyticArcs(m_settings->adaptiveArcs());
+
     m_selectionDrawer.setColor(m_settings->colors("ToolpathHighlight"));
 
+    updateSendPreprocessor();
+
     // Adapt visualizer buttons colors
     const int LIGHTBOUND = 127;
     const int NORMALSHIFT = 40;
@@ -2367,11 +2519,14 @@ void frmMain::updateParser()
 
     GcodeParser gp;
     gp.setTraverseSpeed(m_settings->rapidSpeed());
+    m_heightMapCompensator.setArcPrecision(m_settings->arcPrecision(), m_settings->arcDegreeMode());
     if (m_codeDrawer->getIgnoreZ()) gp.reset(QVector3D(qQNaN(), qQNaN(), 0));
 
     ui->tblProgram->setUpdatesEnabled(false);
 
     QByteArrayList args;
+    bool const indexModalState = m_currentModel == &m_programModel;
+    if (indexModalState) m_modalStateIndex.clear();
 
     QProgressDialog progress(tr("Updating..."), tr("Abort"), 0, m_currentModel->rowCount() - 2, this);
     progress.setWindowModality(Qt::WindowModal);
@@ -2392,6 +2547,7 @@ void frmMain::updateParser()
 
         // Add command to parser
         gp.addCommand(args);
+        if (indexModalState) m_modalStateIndex.addCommand(args);
 
         // Update table model
         m_currentModel->data()[i].state = GCodeItem::InQueue;
@@ -2413,7 +2569,8 @@ void frmMain::updateParser()
 
     parser->reset();
 
-    updateProgramEstimatedTime(parser->getLinesFromParser(&gp, m_settings->arcPrecision(), m_settings->arcDegreeMode()));
+    parser->getLinesFromParser(&gp, m_settings->arcPrecision(), m_settings->arcDegreeMode());
+    updateProgramEstimatedTime(parser);
     m_currentDrawer->update();
     ui->glwVisualizer->updateExtremes(m_currentDrawer);
     updateControlsState();
@@ -2555,6 +2712,7 @@ void frmMain::on_cmdFileReset_clicked()
     m_fileProcessedCommandIndex = 0;
     m_lastDrawnLineIndex = 0;
     m_probeIndex = -1;
+    resetHeightMapCompensator(0);
 
     if (!m_heightMapMode) {
         QElapsedTimer time;
@@ -2613,7 +2771,8 @@ void frmMain::on_actFileNew_triggered()
         // Reset tables
         clearTable();
         m_probeModel.clear();
-        m_programHeightmapModel.clear();
+        m_viewParser.setSubdivisionStep(QSizeF());
+        m_codeDrawer->setHeightMapEnabled(false);
         m_currentModel = &m_programModel;
 
         // Reset parsers
@@ -2624,7 +2783,7 @@ void frmMain::on_actFileNew_triggered()
         m_codeDrawer->update();
         m_currentDrawer = m_codeDrawer;
         ui->glwVisualizer->fitDrawable();
-        updateProgramEstimatedTime(LineSegment::Container());
+        updateProgramEstimatedTime(&m_viewParser);
 
         m_programFileName = "";
         ui->chkHeightMapUse->setChecked(false);
@@ -2669,7 +2828,7 @@ void frmMain::on_cmdClearConsole_clicked()
     ui->txtConsole->clear();
 }
 
-bool frmMain::saveProgramToFile(QString const &fileName, GCodeTableModel *model)
+bool frmMain::saveProgramToFile(QString const &fileName, GCodeTableModel *model, HeightMapCompensator *compensator)
 {
     QFile file(fileName);
     QDir dir;
@@ -2682,7 +2841,12 @@ bool frmMain::saveProgramToFile(QString const &fileName, GCodeTableModel *model)
     QTextStream textStream(&file);
 
     for (int i = 0; i < model->rowCount() - 1; i++) {
-        textStream << model->data(model->index(i, 1)).toString() << '\n';
+        if (compensator) {
+            auto const &item = model->data().at(i);
+            for (auto const &command : compensator->compensate(item.command, item.args)) textStream << command << '\n';
+        } else {
+            textStream << model->data(model->index(i, 1)).toString() << '\n';
+        }
     }
 
     file.close();
@@ -2695,8 +2859,249 @@ void frmMain::on_actFileSaveTransformedAs_triggered()
     QString fileName = (QFileDialog::getSaveFileName(this, tr("Save file as"), m_lastFolder, tr("G-Code files (*.nc *.ncc *.ngc *.tap *.gcode *.txt)")));
 
     if (!fileName.isEmpty()) {
-        saveProgramToFile(fileName, &m_programHeightmapModel);
+        HeightMapCompensator compensator = createHeightMapCompensator();
+        saveProgramToFile(fileName, &m_programModel, &compensator);
+    }
+}
+
+void frmMain::on_actFileCheck_triggered()
+{
+    auto const &data = m_programModel.data();
+    int const count = static_cast<int>(data.size()) - 1;
+    if (count <= 0) return;
+
+    GrblChecker checker;
+
+    // Continue from current machine state if controller is connected
+    if (m_serialPort.isOpen() && m_statusReceived) {
+        QVector3D const machinePosition(toMetric(ui->txtMPosX->text().toDouble()),
+                                        toMetric(ui->txtMPosY->text().toDouble()),
+                                        toMetric(ui->txtMPosZ->text().toDouble()));
+        QVector3D const workPosition(toMetric(ui->txtWPosX->text().toDouble()),
+                                     toMetric(ui->txtWPosY->text().toDouble()),
+                                     toMetric(ui->txtWPosZ->text().toDouble()));
+        checker.setStartPosition(machinePosition, machinePosition - workPosition);
+        checker.setSoftLimits(m_softLimits, m_maxTravel);
+    }
+
+    QProgressDialog progress(tr("Checking program..."), tr("Abort"), 0, count, this);
+    progress.setWindowModality(Qt::WindowModal);
+    progress.setFixedSize(progress.sizeHint());
+    progress.show();
+
+    try {
+        runInBackground(progress, [&](Parallel::Progress &state) {
+            checker.check(count, [&](int i) -> QByteArray const & { return data[i].command; }, &state);
+        });
+    } catch (CancelException &) {
+        return;
+    }
+    progress.close();
+
+    // Fill responses as controller check mode does, lines after alarm aren't processed
+    auto const &errors = checker.errors();
+    int const processed = !errors.empty() && errors.back().isAlarm ? errors.back().line + 1 : count;
+
+    // Responses are written in place, views are notified once
+    for (int i = 0; i < count; i++) {
+        m_programModel.data()[i].response = i < processed ? QByteArray("ok") : QByteArray();
+    }
+    for (auto const &error : errors) m_programModel.data()[error.line].response = GrblChecker::response(error);
+    m_programModel.emitDataChanged(0, count - 1, 3);
+
+    if (errors.empty()) {
+        QMessageBox::information(this, this->windowTitle(), tr("No errors found"));
+        return;
+    }
+
+    ui->tblProgram->scrollTo(m_programModel.index(errors.front().line, 0));
+    ui->tblProgram->selectRow(errors.front().line);
+
+    int const listed = 10;
+    QStringList messages;
+    for (int i = 0; i < qMin(listed, static_cast<int>(errors.size())); i++) {
+        messages << tr("Line %1: %2 %3").arg(errors[i].line + 1)
+                    .arg(QString(GrblChecker::response(errors[i]))).arg(GrblChecker::message(errors[i]));
+    }
+    if (static_cast<int>(errors.size()) > listed) messages << "...";
+
+    QMessageBox::warning(this, this->windowTitle(), tr("Errors found: %1").arg(static_cast<int>(errors.size())) + "\n\n" + messages.join("\n"));
+}
+
+void frmMain::on_actProgramFitArcs_triggered()
+{
+    auto const &data = m_programModel.data();
+    int const count = static_cast<int>(data.size()) - 1;
+    if (count <= 0) return;
+
+    bool ok;
+    double const tolerance = QInputDialog::getDouble(this, this->windowTitle(), tr("Arc fitting tolerance, mm:"),
+                                                     0.01, 0.001, 1.0, 3, &ok);
+    if (!ok) return;
+
+    ArcFitter fitter;
+    fitter.setTolerance(tolerance);
+
+    QProgressDialog progress(tr("Fitting arcs..."), tr("Abort"), 0, count, this);
+    progress.setWindowModality(Qt::WindowModal);
+    progress.setFixedSize(progress.sizeHint());
+    progress.show();
+
+    try {
+        runInBackground(progress, [&](Parallel::Progress &state) {
+            for (int i = 0; i < count && !state.cancelled; i++) {
+                fitter.addCommand(data[i].command, data[i].args);
+                if ((i & 0xffff) == 0) state.done = i;
+            }
+            fitter.finish();
+        });
+    } catch (CancelException &) {
+        return;
+    }
+    progress.close();
+
+    if (fitter.arcCount() == 0) {
+        QMessageBox::information(this, this->windowTitle(), tr("No arcs fitted"));
+        return;
+    }
+
+    replaceProgram(fitter.commands(), tr("Arcs fitted: %1\nLines removed: %2\nBytes removed: %3")
+                   .arg(fitter.arcCount()).arg(fitter.linesRemoved()).arg(fitter.bytesRemoved()));
+}
+
+void frmMain::on_actProgramMergeSegments_triggered()
+{
+    auto const &data = m_programModel.data();
+    int const count = static_cast<int>(data.size()) - 1;
+    if (count <= 0) return;
+
+    bool ok;
+    double const tolerance = QInputDialog::getDouble(this, this->windowTitle(), tr("Merging tolerance, mm:"),
+                                                     0.005, 0.001, 1.0, 3, &ok);
+    if (!ok) return;
+
+    SegmentMerger merger;
+
+    {
+        QProgressDialog progress(tr("Analyzing program..."), tr("Abort"), 0, count, this);
+        progress.setWindowModality(Qt::WindowModal);
+        progress.setFixedSize(progress.sizeHint());
+        progress.show();
+
+        try {
+            runInBackground(progress, [&](Parallel::Progress &state) {
+                merger.load(count, [&](int i) -> QByteArray const & { return data[i].command; },
+                            [&](int i) -> QByteArrayList const & { return data[i].args; }, &state);
+            });
+        } catch (CancelException &) {
+            return;
+        }
+    }
+
+    {
+        QProgressDialog progress(tr("Merging moves..."), tr("Abort"), 0, merger.segmentsBefore(), this);
+        progress.setWindowModality(Qt::WindowModal);
+        progress.setFixedSize(progress.sizeHint());
+        progress.show();
+
+        try {
+            runInBackground(progress, [&](Parallel::Progress &state) {
+                merger.simplify(tolerance, &state);
+            });
+        } catch (CancelException &) {
+            return;
+        }
+    }
+
+    if (merger.segmentsAfter() == merger.segmentsBefore()) {
+        QMessageBox::information(this, this->windowTitle(), tr("No moves merged"));
+        return;
+    }
+
+    replaceProgram(merger.commands(), tr("Linear moves: %1 -> %2 (%3% removed)\nMax deviation: %4 mm")
+                   .arg(merger.segmentsBefore()).arg(merger.segmentsAfter())
+                   .arg(100.0 * (merger.segmentsBefore() - merger.segmentsAfter()) / merger.segmentsBefore(), 0, 'f', 1)
+                   .arg(merger.maxDeviation(), 0, 'f', 4));
+}
+
+void frmMain::on_actProgramReorderRapids_triggered()
+{
+    auto const &data = m_programModel.data();
+    int const count = static_cast<int>(data.size()) - 1;
+    if (count <= 0) return;
+
+    RapidOptimizer optimizer;
+    optimizer.setMachine(estimationMachine());
+
+    {
+        QProgressDialog progress(tr("Analyzing program..."), tr("Abort"), 0, count, this);
+        progress.setWindowModality(Qt::WindowModal);
+        progress.setFixedSize(progress.sizeHint());
+        progress.show();
+
+        try {
+            runInBackground(progress, [&](Parallel::Progress &state) {
+                optimizer.load(count, [&](int i) -> QByteArray const & { return data[i].command; },
+                               [&](int i) -> QByteArrayList const & { return data[i].args; }, &state);
+            });
+        } catch (CancelException &) {
+            return;
+        }
     }
+
+    if (qIsNaN(optimizer.defaultSafeZ())) {
+        QMessageBox::information(this, this->windowTitle(), tr("No feed moves found"));
+        return;
+    }
+
+    bool ok;
+    double const safeZ = QInputDialog::getDouble(this, this->windowTitle(), tr("Safe Z of travels between islands:"),
+                                                 optimizer.defaultSafeZ(), -10000, 10000, 3, &ok);
+    if (!ok) return;
+
+    {
+        QProgressDialog progress(tr("Reordering islands..."), tr("Abort"), 0, 0, this);
+        progress.setWindowModality(Qt::WindowModal);
+        progress.setFixedSize(progress.sizeHint());
+        progress.show();
+
+        try {
+            runInBackground(progress, [&](Parallel::Progress &state) {
+                optimizer.optimize(safeZ, &state);
+            });
+        } catch (CancelException &) {
+            return;
+        }
+    }
+
+    if (optimizer.movedCount() == 0) {
+        QMessageBox::information(this, this->windowTitle(), tr("Islands found: %1\nOrder can't be improved")
+                                 .arg(optimizer.islandCount()));
+        return;
+    }
+
+    replaceProgram(optimizer.commands(), tr("Islands found: %1, moved: %2\n"
+                                            "Rapid distance: %3 -> %4 mm\n"
+                                            "Rapid time: %5 -> %6 s, saved %7 s")
+                   .arg(optimizer.islandCount()).arg(optimizer.movedCount())
+                   .arg(optimizer.distanceBefore(), 0, 'f', 1).arg(optimizer.distanceAfter(), 0, 'f', 1)
+                   .arg(optimizer.timeBefore(), 0, 'f', 1).arg(optimizer.timeAfter(), 0, 'f', 1)
+                   .arg(optimizer.timeBefore() - optimizer.timeAfter(), 0, 'f', 1));
+}
+
+bool frmMain::replaceProgram(QByteArrayList const &commands, QString const &report)
+{
+    if (QMessageBox::question(this, this->windowTitle(), report + "\n\n" + tr("Replace program?"),
+                              QMessageBox::Yes | QMessageBox::No) != QMessageBox::Yes) return false;
+
+    // Reload as unsaved program, file name is kept
+    QByteArray text = commands.join('\n');
+    QBuffer textStream(&text);
+    textStream.open(QIODevice::ReadOnly);
+    loadFile(textStream, text.size());
+    m_fileChanged = true;
+
+    return true;
 }
 
 void frmMain::on_actFileSaveAs_triggered()
@@ -3216,6 +3621,10 @@ bool frmMain::updateHeightMapGrid()
     int gridPointsX = ui->txtHeightMapGridX->value();
     int gridPointsY = ui->txtHeightMapGridY->value();
 
+    // Adaptive probing starts from power of 2 stride subgrid, grid without one is probed in full
+    bool const adaptive = AdaptiveProbing::coarseStride(gridPointsX, gridPointsY) > 1;
+    ui->chkHeightMapAdaptive->setEnabled(adaptive);
+
     m_heightMapModel.resize(gridPointsX, gridPointsY);
     ui->tblHeightMap->setModel(NULL);
     ui->tblHeightMap->setModel(&m_heightMapModel);
@@ -3225,9 +3634,6 @@ bool frmMain::updateHeightMapGrid()
     updateHeightMapInterpolationDrawer(true);
 
     // Generate probe program
-    double gridStepX = gridPointsX > 1 ? borderRect.width() / (gridPointsX - 1) : 0;
-    double gridStepY = gridPointsY > 1 ? borderRect.height() / (gridPointsY - 1) : 0;
-
     qDebug() << "generating probe program";
 
     m_programLoading = true;
@@ -3243,19 +3649,20 @@ bool frmMain::updateHeightMapGrid()
     m_probeModel.setData(m_probeModel.index(m_probeModel.rowCount() - 1, 1), QString("G0Z%1")
                          .arg(ui->txtHeightMapGridZTop->value()));
 
-    double x, y;
-
-    for (int i = 0; i < gridPointsY; i++) {
-        y = borderRect.top() + gridStepY * i;
-        for (int j = 0; j < gridPointsX; j++) {
-            x = borderRect.left() + gridStepX * (i % 2 ? gridPointsX - 1 - j : j);
-            m_probeModel.setData(m_probeModel.index(m_probeModel.rowCount() - 1, 1), QString("G0X%1Y%2")
-                                 .arg(x, 0, 'f', 3).arg(y, 0, 'f', 3));
-            m_probeModel.setData(m_probeModel.index(m_probeModel.rowCount() - 1, 1), QString("G38.2Z%1")
-                                 .arg(ui->txtHeightMapGridZBottom->value()));
-            m_probeModel.setData(m_probeModel.index(m_probeModel.rowCount() - 1, 1), QString("G0Z%1")
-                                 .arg(ui->txtHeightMapGridZTop->value()));
+    // Probe points, coarse grid first on adaptive probing
+    m_probePoints.clear();
+    if (adaptive && ui->chkHeightMapAdaptive->isChecked()) {
+        m_adaptiveProbing = AdaptiveProbing(borderRect, gridPointsX, gridPointsY, ui->txtHeightMapAdaptiveTolerance->value());
+        appendProbeCommands(m_adaptiveProbing.points());
+    } else {
+        m_adaptiveProbing = AdaptiveProbing();
+
+        std::vector<QPoint> points;
+        points.reserve(gridPointsX * gridPointsY);
+        for (int i = 0; i < gridPointsY; i++) {
+            for (int j = 0; j < gridPointsX; j++) points.emplace_back(i % 2 ? gridPointsX - 1 - j : j, i);
         }
+        appendProbeCommands(points);
     }
 
     m_programLoading = false;
@@ -3266,6 +3673,47 @@ bool frmMain::updateHeightMapGrid()
     return true;
 }
 
+void frmMain::appendProbeCommands(std::vector<QPoint> const &points)
+{
+    QRectF borderRect = borderRectFromTextboxes();
+    int const gridPointsX = m_heightMapModel.columnCount();
+    int const gridPointsY = m_heightMapModel.rowCount();
+    double const gridStepX = gridPointsX > 1 ? borderRect.width() / (gridPointsX - 1) : 0;
+    double const gridStepY = gridPointsY > 1 ? borderRect.height() / (gridPointsY - 1) : 0;
+
+    bool const programLoading = m_programLoading;
+    m_programLoading = true;
+
+    for (auto const &point : points) {
+        double const x = borderRect.left() + gridStepX * point.x();
+        double const y = borderRect.top() + gridStepY * point.y();
+        m_probeModel.setData(m_probeModel.index(m_probeModel.rowCount() - 1, 1), QString("G0X%1Y%2")
+                             .arg(x, 0, 'f', 3).arg(y, 0, 'f', 3));
+        m_probeModel.setData(m_probeModel.index(m_probeModel.rowCount() - 1, 1), QString("G38.2Z%1")
+                             .arg(ui->txtHeightMapGridZBottom->value()));
+        m_probeModel.setData(m_probeModel.index(m_probeModel.rowCount() - 1, 1), QString("G0Z%1")
+                             .arg(ui->txtHeightMapGridZTop->value()));
+        m_probePoints.push_back(point);
+    }
+
+    m_programLoading = programLoading;
+}
+
+void frmMain::refineAdaptiveProbing()
+{
+    bool const refined = m_adaptiveProbing.refine();
+
+    qDebug() << "adaptive probing: stride" << m_adaptiveProbing.stride() << "probed" << m_adaptiveProbing.probedCount()
+             << "queued" << m_adaptiveProbing.points().size();
+
+    // Points not probed are predicted from coarser level
+    m_heightMapModel.setValues(m_adaptiveProbing.columns(), m_adaptiveProbing.rows(), m_adaptiveProbing.values());
+    updateHeightMapInterpolationDrawer();
+
+    // Probe program is extended while it's being sent
+    if (refined) appendProbeCommands(m_adaptiveProbing.points());
+}
+
 void frmMain::updateHeightMapInterpolationDrawer(bool reset)
 {
     if (m_settingsLoading) return;
@@ -3283,15 +3731,21 @@ void frmMain::updateHeightMapInterpolationDrawer(bool reset)
     double interpolationStepX = interpolationPointsX > 1 ? borderRect.width() / (interpolationPointsX - 1) : 0;
     double interpolationStepY = interpolationPointsY > 1 ? borderRect.height() / (interpolationPointsY - 1) : 0;
 
+    // Swap compensator surface, program is compensated on sending so nothing to rebuild
+    updateHeightMapCompensator();
+    auto const surface = m_heightMapCompensator.surface();
+    std::vector<double> xs(interpolationPointsX);
+    std::vector<double> ys(interpolationPointsX);
+    std::vector<double> zs;
+
+    for (int j = 0; j < interpolationPointsX; j++) xs[j] = interpolationStepX * j + borderRect.x();
+
     for (int i = 0; i < interpolationPointsY; i++) {
         QVector<double> row;
-        for (int j = 0; j < interpolationPointsX; j++) {
+        std::fill(ys.begin(), ys.end(), interpolationStepY * i + borderRect.y());
+        surface->evaluate(xs, ys, zs);
 
-            double x = interpolationStepX * j + borderRect.x();
-            double y = interpolationStepY * i + borderRect.y();
-
-            row.append(reset ? qQNaN() : Interpolation::bicubicInterpolate(borderRect, &m_heightMapModel, x, y));
-        }
+        for (int j = 0; j < interpolationPointsX; j++) row.append(reset ? qQNaN() : zs[j]);
         interpolationData->append(row);
     }
 
@@ -3305,9 +3759,6 @@ void frmMain::updateHeightMapInterpolationDrawer(bool reset)
 
     // Heightmap changed by table user input
     if (sender() == &m_heightMapModel) m_heightMapChanged = true;
-
-    // Reset heightmapped program model
-    m_programHeightmapModel.clear();
 }
 
 void frmMain::on_chkHeightMapBorderShow_toggled(bool checked)
@@ -3358,6 +3809,21 @@ void frmMain::on_txtHeightMapGridY_valueChanged(double arg1)
     updateHeightMapGrid(arg1);
 }
 
+void frmMain::on_chkHeightMapAdaptive_toggled(bool checked)
+{
+    // Probe program is changed
+    if (!updateHeightMapGrid()) {
+        QSignalBlocker blocker(ui->chkHeightMapAdaptive);
+        ui->chkHeightMapAdaptive->setChecked(!checked);
+    }
+}
+
+void frmMain::on_txtHeightMapAdaptiveTolerance_valueChanged(double arg1)
+{
+    // Applied from next refinement
+    m_adaptiveProbing.setTolerance(arg1);
+}
+
 void frmMain::on_txtHeightMapGridZBottom_valueChanged(double arg1)
 {
     updateHeightMapGrid(arg1);
@@ -3403,7 +3869,7 @@ void frmMain::on_cmdHeightMapMode_toggled(bool checked)
 
             if (!ui->chkHeightMapUse->isChecked()) {
                 ui->glwVisualizer->updateExtremes(m_codeDrawer);
-                updateProgramEstimatedTime(m_currentDrawer->viewParser()->getLineSegmentList());
+                updateProgramEstimatedTime(m_currentDrawer->viewParser());
             }
         }
     }
@@ -3426,33 +3892,18 @@ void frmMain::on_cmdHeightMapMode_toggled(bool checked)
 
 bool frmMain::saveHeightMap(QString const &fileName)
 {
-    QFile file(fileName);
-    QDir dir;
-
-    if (file.exists()) dir.remove(file.fileName());
-    if (!file.open(QIODevice::WriteOnly)) return false;
-
-    QTextStream textStream(&file);
-    textStream << ui->txtHeightMapBorderX->text() << ";"
-               << ui->txtHeightMapBorderY->text() << ";"
-               << ui->txtHeightMapBorderWidth->text() << ";"
-               << ui->txtHeightMapBorderHeight->text() << '\n';
-    textStream << ui->txtHeightMapGridX->text() << ";"
-               << ui->txtHeightMapGridY->text() << ";"
-               << ui->txtHeightMapGridZBottom->text() << ";"
-               << ui->txtHeightMapGridZTop->text() << '\n';
-    textStream << ui->cboHeightMapInterpolationType->currentIndex() << ";"
-               << ui->txtHeightMapInterpolationStepX->text() << ";"
-                << ui->txtHeightMapInterpolationStepY->text() << '\n';
-
-    for (int i = 0; i < m_heightMapModel.rowCount(); i++) {
-        for (int j = 0; j < m_heightMapModel.columnCount(); j++) {
-            textStream << m_heightMapModel.data(m_heightMapModel.index(i, j), Qt::UserRole).toString() << ((j == m_heightMapModel.columnCount() - 1) ? "" : ";");
-        }
-        textStream << '\n';
-    }
+    HeightMapFile heightMap;
+    heightMap.borderRect = borderRectFromTextboxes();
+    heightMap.columns = m_heightMapModel.columnCount();
+    heightMap.rows = m_heightMapModel.rowCount();
+    heightMap.zBottom = ui->txtHeightMapGridZBottom->value();
+    heightMap.zTop = ui->txtHeightMapGridZTop->value();
+    heightMap.interpolationType = ui->cboHeightMapInterpolationType->currentIndex();
+    heightMap.interpolationPointsX = ui->txtHeightMapInterpolationStepX->value();
+    heightMap.interpolationPointsY = ui->txtHeightMapInterpolationStepY->value();
+    heightMap.values = m_heightMapModel.values();
 
-    file.close();
+    if (!heightMap.save(fileName)) return false;
 
     m_heightMapChanged = false;
 
@@ -3461,17 +3912,23 @@ bool frmMain::saveHeightMap(QString const &fileName)
 
 void frmMain::loadHeightMap(QString const &fileName)
 {
-    QFile file(fileName);
+    HeightMapFile heightMap;
 
-    if (!file.open(QIODevice::ReadOnly)) {
+    if (!heightMap.load(fileName)) {
         QMessageBox::critical(this, this->windowTitle(), tr("Can't open file:\n") + fileName);
         return;
     }
+
+    // Model is sized by grid textboxes, so grid out of their range can't be loaded
+    if (heightMap.columns < ui->txtHeightMapGridX->minimum() || heightMap.columns > ui->txtHeightMapGridX->maximum()
+            || heightMap.rows < ui->txtHeightMapGridY->minimum() || heightMap.rows > ui->txtHeightMapGridY->maximum()) {
+        QMessageBox::critical(this, this->windowTitle(), tr("Heightmap grid %1x%2 isn't supported:\n")
+                              .arg(heightMap.columns).arg(heightMap.rows) + fileName);
+        return;
+    }
     addRecentHeightmap(fileName);
     updateRecentFilesMenu();
 
-    QTextStream textStream(&file);
-
     m_settingsLoading = true;
 
     // Storing previous values
@@ -3485,17 +3942,15 @@ void frmMain::loadHeightMap(QString const &fileName)
     ui->txtHeightMapGridZBottom->setValue(qQNaN());
     ui->txtHeightMapGridZTop->setValue(qQNaN());
 
-    QStringList list = textStream.readLine().split(";");
-    ui->txtHeightMapBorderX->setValue(list[0].toDouble());
-    ui->txtHeightMapBorderY->setValue(list[1].toDouble());
-    ui->txtHeightMapBorderWidth->setValue(list[2].toDouble());
-    ui->txtHeightMapBorderHeight->setValue(list[3].toDouble());
+    ui->txtHeightMapBorderX->setValue(heightMap.borderRect.x());
+    ui->txtHeightMapBorderY->setValue(heightMap.borderRect.y());
+    ui->txtHeightMapBorderWidth->setValue(heightMap.borderRect.width());
+    ui->txtHeightMapBorderHeight->setValue(heightMap.borderRect.height());
 
-    list = textStream.readLine().split(";");
-    ui->txtHeightMapGridX->setValue(list[0].toDouble());
-    ui->txtHeightMapGridY->setValue(list[1].toDouble());
-    ui->txtHeightMapGridZBottom->setValue(list[2].toDouble());
-    ui->txtHeightMapGridZTop->setValue(list[3].toDouble());
+    ui->txtHeightMapGridX->setValue(heightMap.columns);
+    ui->txtHeightMapGridY->setValue(heightMap.rows);
+    ui->txtHeightMapGridZBottom->setValue(heightMap.zBottom);
+    ui->txtHeightMapGridZTop->setValue(heightMap.zTop);
 
     m_settingsLoading = false;
 
@@ -3504,36 +3959,20 @@ void frmMain::loadHeightMap(QString const &fileName)
     m_heightMapModel.clear();   // To avoid probe data wipe message
     updateHeightMapGrid();
 
-    list = textStream.readLine().split(";");
-
-//    ui->chkHeightMapBorderAuto->setChecked(false);
-//    ui->chkHeightMapBorderAuto->setEnabled(false);
-//    ui->txtHeightMapBorderX->setEnabled(false);
-//    ui->txtHeightMapBorderY->setEnabled(false);
-//    ui->txtHeightMapBorderWidth->setEnabled(false);
-//    ui->txtHeightMapBorderHeight->setEnabled(false);
-
-//    ui->txtHeightMapGridX->setEnabled(false);
-//    ui->txtHeightMapGridY->setEnabled(false);
-//    ui->txtHeightMapGridZBottom->setEnabled(false);
-//    ui->txtHeightMapGridZTop->setEnabled(false);
-
-    for (int i = 0; i < m_heightMapModel.rowCount(); i++) {
-        QStringList row = textStream.readLine().split(";");
-        for (int j = 0; j < m_heightMapModel.columnCount(); j++) {
-            m_heightMapModel.setData(m_heightMapModel.index(i, j), row[j].toDouble(), Qt::UserRole);
-        }
+    // Probe data is replaced with one model reset
+    if (m_heightMapModel.columnCount() != heightMap.columns || m_heightMapModel.rowCount() != heightMap.rows) {
+        QMessageBox::critical(this, this->windowTitle(), tr("Heightmap grid doesn't match grid settings:\n") + fileName);
+        return;
     }
-
-    file.close();
+    m_heightMapModel.setValues(heightMap.columns, heightMap.rows, heightMap.values);
 
     ui->txtHeightMap->setText(fileName.mid(fileName.lastIndexOf("/") + 1));
     m_heightMapFileName = fileName;
     m_heightMapChanged = false;
 
-    ui->cboHeightMapInterpolationType->setCurrentIndex(list[0].toInt());
-    ui->txtHeightMapInterpolationStepX->setValue(list[1].toDouble());
-    ui->txtHeightMapInterpolationStepY->setValue(list[2].toDouble());
+    ui->cboHeightMapInterpolationType->setCurrentIndex(heightMap.interpolationType);
+    ui->txtHeightMapInterpolationStepX->setValue(heightMap.interpolationPointsX);
+    ui->txtHeightMapInterpolationStepY->setValue(heightMap.interpolationPointsY);
 
     updateHeightMapInterpolationDrawer();
 }
@@ -3545,6 +3984,16 @@ void frmMain::on_chkHeightMapInterpolationShow_toggled(bool checked)
     updateControlsState();
 }
 
+void frmMain::on_chkHeightMapInterpolationSurface_toggled(bool checked)
+{
+    m_heightMapInterpolationDrawer.setSurfaceVisible(checked);
+}
+
+void frmMain::on_chkHeightMapInterpolationWireframe_toggled(bool checked)
+{
+    m_heightMapInterpolationDrawer.setWireframeVisible(checked);
+}
+
 void frmMain::on_cmdHeightMapLoad_clicked()
 {
     if (!saveChanges(true)) {
@@ -3558,9 +4007,7 @@ void frmMain::on_cmdHeightMapLoad_clicked()
 
         // If using heightmap
         if (ui->chkHeightMapUse->isChecked() && !m_heightMapMode) {
-            // Restore original file
-            on_chkHeightMapUse_clicked(false);
-            // Apply heightmap
+            // Apply new heightmap
             on_chkHeightMapUse_clicked(true);
         }
 
@@ -3574,6 +4021,7 @@ void frmMain::on_txtHeightMapInterpolationStepX_valueChanged(double arg1)
     Q_UNUSED(arg1)
 
     updateHeightMapInterpolationDrawer();
+    if (updateHeightMapSubdivision()) updateHeightMapCompensatedSize();
 }
 
 void frmMain::on_txtHeightMapInterpolationStepY_valueChanged(double arg1)
@@ -3581,314 +4029,285 @@ void frmMain::on_txtHeightMapInterpolationStepY_valueChanged(double arg1)
     Q_UNUSED(arg1)
 
     updateHeightMapInterpolationDrawer();
+    if (updateHeightMapSubdivision()) updateHeightMapCompensatedSize();
 }
 
-void frmMain::on_chkHeightMapUse_clicked(bool checked)
+void frmMain::on_txtHeightMapTolerance_valueChanged(double arg1)
 {
-//    static bool fileChanged;
+    Q_UNUSED(arg1)
 
+    if (m_settingsLoading || !ui->chkHeightMapUse->isChecked()) return;
+
+    // Tolerance changes sent commands only, preview is subdivided by step
+    m_heightMapCompensator.setTolerance(ui->txtHeightMapTolerance->value());
+    updateHeightMapCompensatedSize();
+}
+
+void frmMain::on_chkHeightMapUse_clicked(bool checked)
+{
     // Reset table view
     QByteArray headerState = ui->tblProgram->horizontalHeader()->saveState();
     ui->tblProgram->setModel(NULL);
 
-    CancelException cancel;
+    // Program is compensated on sending, preview Z is offset by drawer vertex shader
+    if (checked) updateHeightMapCompensator();
 
-    if (checked) try {
-
-        // Prepare progress dialog
-        QProgressDialog progress(tr("Applying heightmap..."), tr("Abort"), 0, 0, this);
-        progress.setWindowModality(Qt::WindowModal);
-        progress.setFixedHeight(progress.sizeHint().height());
-        progress.show();
-        progress.setStyleSheet("QProgressBar {text-align: center; qproperty-format: \"\"}");
+    // Offset is undefined near unprobed points, such moves can't be sent
+    if (checked && !m_heightMapCompensator.isActive()) {
+        QMessageBox::warning(this, this->windowTitle(), tr("Heightmap has unprobed points, probe it before use"));
+        ui->chkHeightMapUse->setChecked(false);
+        checked = false;
+    }
+    m_codeDrawer->setHeightMapEnabled(checked);
 
-        // Performance test
-        QElapsedTimer time;
+    m_currentModel = &m_programModel;
+    m_currentDrawer = m_codeDrawer;
 
-        // Store fileChanged state
-//        fileChanged = m_fileChanged;
+    ui->tblProgram->setModel(&m_programModel);
+    ui->tblProgram->horizontalHeader()->restoreState(headerState);
 
-        // Set current model to prevent reseting heightmap cache
-        m_currentModel = &m_programHeightmapModel;
+    connect(ui->tblProgram->selectionModel(), &QItemSelectionModel::currentChanged, this, &frmMain::onTableCurrentChanged);
 
-        // Update heightmap-modificated program if not cached
-        if (m_programHeightmapModel.rowCount() == 0) {
+    // Store changes flag
+    bool fileChanged = m_fileChanged;
 
-            // Modifying linesegments
-            auto & list = m_viewParser.getLines();
-            QRectF borderRect = borderRectFromTextboxes();
-            double x, y, z;
-            QVector3D point;
+    // Subdivision is kept on heightmap disabling, extremes & time change by Z offset only
+    if (!checked || !updateHeightMapSubdivision()) {
+        ui->glwVisualizer->updateExtremes(m_codeDrawer);
+        updateProgramEstimatedTime(&m_viewParser);
+    }
 
-            progress.setLabelText(tr("Subdividing segments..."));
-            progress.setMaximum(static_cast<int>(list.size()) - 1);
-            time.start();
+    updateHeightMapCompensatedSize();
 
-            for (int i = 0; i < static_cast<int>(list.size()); i++) {
-                if (!list[i].isZMovement()) {
-                    LineSegment::Container subSegments = subdivideSegment(list[i]);
+    // Select first row
+    ui->tblProgram->selectRow(0);
 
-                    if (!subSegments.empty()) {
-                        //delete list[i];
-                        list.erase(list.begin() + i); // list.removeAt(i);
-#ifdef USE_STD_CONTAINERS
-                        list.insert(list.begin() + i, subSegments.begin(), subSegments.end());
-                        i += subSegments.size() - 1;
-#else
-                        for (LineSegment& subSegment : subSegments){ list.insert(i++, subSegment);}
-                        i--;
-#endif
-                    }
-                }
+    // Restore changes flag
+    m_fileChanged = fileChanged;
 
-                if (progress.isVisible() && (time.elapsed() % PROGRESSSTEP == 0)) {
-                    progress.setMaximum(static_cast<int>(list.size()) - 1);
-                    progress.setValue(i);
-                    qApp->processEvents();
-                    if (progress.wasCanceled()) throw cancel;
-                }
-            }
+    // Update groupbox title
+    ui->grpHeightMap->setProperty("overrided", checked);
+    style()->unpolish(ui->grpHeightMap);
+    ui->grpHeightMap->ensurePolished();
 
-            qDebug() << "Subdivide time: " << time.restart();
+    // Update menu
+    ui->actFileSaveTransformedAs->setVisible(checked);
+}
 
-            progress.setLabelText(tr("Updating Z-coordinates..."));
-            progress.setMaximum(static_cast<int>(list.size()) - 1);
+void frmMain::updateHeightMapCompensatedSize()
+{
+    if (!ui->chkHeightMapUse->isChecked() || m_heightMapMode) {
+        ui->chkHeightMapUse->setToolTip(QString());
+        return;
+    }
 
-            for (int i = 0; i < static_cast<int>(list.size()); i++) {
-                if (i == 0) {
-                    x = list[i].getStart().x();
-                    y = list[i].getStart().y();
-                    z = list[i].getStart().z() + Interpolation::bicubicInterpolate(borderRect, &m_heightMapModel, x, y);
-                    list[i].setStart(QVector3D(x, y, z));
-                } else list[i].setStart(list.at(i - 1).getEnd());
+    auto const &modelData = m_programModel.data();
+    int const rows = m_programModel.rowCount() - 1;
+    int const chunks = Parallel::chunkCount(rows, 4096);
+    auto const bounds = Parallel::splitRange(0, rows, chunks);
 
-                x = list[i].getEnd().x();
-                y = list[i].getEnd().y();
-                z = list[i].getEnd().z() + Interpolation::bicubicInterpolate(borderRect, &m_heightMapModel, x, y);
-                list[i].setEnd(QVector3D(x, y, z));
+    // Compensator reads settings, so is created here
+    HeightMapCompensator start = createHeightMapCompensator();
+    std::vector<HeightMapCompensator> compensators;
+    compensators.reserve(chunks);
+    std::vector<long long> commands(chunks, 0);
 
-                if (progress.isVisible() && (time.elapsed() % PROGRESSSTEP == 0)) {
-                    progress.setValue(i);
-                    qApp->processEvents();
-                    if (progress.wasCanceled()) throw cancel;
+    QProgressDialog progress(tr("Compensating program..."), tr("Abort"), 0, rows, this);
+    progress.setWindowModality(Qt::WindowModal);
+    progress.setFixedSize(progress.sizeHint());
+    progress.show();
+
+    try {
+        // Program state at chunk starts is taken in single pass of advancing, which doesn't subdivide moves
+        runInBackground(progress, [&](Parallel::Progress &state) {
+            for (int chunk = 0; chunk < chunks && !state.cancelled; chunk++) {
+                for (int i = chunk > 0 ? bounds[chunk - 1] : 0; i < bounds[chunk] && !state.cancelled; i++) {
+                    start.advance(modelData.at(i).args);
+                    state.done++;
                 }
+                compensators.push_back(start);
             }
+        });
 
-            qDebug() << "Z update time (interpolation): " << time.restart();
-
-            progress.setLabelText(tr("Modifying G-code program..."));
-            progress.setMaximum(m_programModel.rowCount() - 2);
-
-            // Modifying g-code program
-//            QString command;
-//            QStringList args;
-            GCodeItem item;
-            int lastSegmentIndex = 0;
-            int lastCommandIndex = -1;
-
-            // Search strings
-            QByteArray coords("XxYyZzIiJjKkRr");
-            QByteArray g("Gg");
-            QByteArray m("Mm");
-
-            char codeChar;          // Single code char G1 -> G
-            float codeNum;          // Code number      G1 -> 1
-
-            QString lastCode;
-            bool isLinearMove;
-            bool hasCommand;
-
-            m_programLoading = true;
-            for (int i = 0; i < m_programModel.rowCount() - 1; i++) {
-                auto command = m_programModel.data().at(i).command;
-                int line = m_programModel.data().at(i).line;
-                isLinearMove = false;
-                hasCommand = false;
-
-                auto &modelData = m_programHeightmapModel.data();
-                if (line < 0 || line == lastCommandIndex || lastSegmentIndex == static_cast<int>(list.size()) - 1) {
-                    item.command = command;
-                    modelData.push_back(item);
-                } else {
-                    // Get commands args
-                    auto const &args = m_programModel.data().at(i).args;
-                    QByteArray newCommand;
-
-                    // Parse command args
-                    for (auto &arg : args) {                   // arg examples: G1, G2, M3, X100...
-                        codeChar = arg.at(0);                  // codeChar: G, M, X...
-                        if (!coords.contains(codeChar)) {           // Not parameter
-                            if (g.contains(codeChar)) {             // 'G'-command
-                                codeNum = GcodePreprocessorUtils::AtoF(arg.data()+1);
-                                // Store 'G0' & 'G1'
-                                if (codeNum == 0.0f || codeNum == 1.0f) {
-                                    lastCode = arg;
-                                    isLinearMove = true;            // Store linear move
-                                }
-
-                                // Replace 'G2' & 'G3' with 'G1'
-                                if (codeNum == 2.0f || codeNum == 3.0f) {
-                                    newCommand.append("G1");
-                                    isLinearMove = true;
-                                // Drop plane command for arcs
-                                } else if (codeNum != 17.0f && codeNum != 18.0f && codeNum != 19.0f) {
-                                    newCommand.append(arg);
-                                }
-
-                                hasCommand = true;                  // Command has 'G'
-                            } else {
-                                if (m.contains(codeChar))
-                                    hasCommand = true;              // Command has 'M'
-                                newCommand.append(arg);       // Other commands
-                            }
-                        }
-                    }
+        runParallel(progress, chunks, [&](int chunk, Parallel::Progress &state) {
+            auto &compensator = compensators[chunk];
+            for (int i = bounds[chunk]; i < bounds[chunk + 1] && !state.cancelled; i++) {
+                commands[chunk] += compensator.skip(modelData.at(i).args);
+                state.done++;
+            }
+        });
+    } catch (CancelException &) {
+        ui->chkHeightMapUse->setToolTip(QString());
+        return;
+    }
+    progress.close();
 
-                    // Find first linesegment by command index
-                    for (int j = lastSegmentIndex; j < static_cast<int>(list.size()); j++) {
-                        if (list.at(j).getLineNumber() == line) {
-                            if (!qIsNaN(list.at(j).getEnd().length()) && (isLinearMove || (!hasCommand && !lastCode.isEmpty()))) {
-                                // Create new commands for each linesegment with given command index
-                                while ((j < static_cast<int>(list.size())) && (list.at(j).getLineNumber() == line)) {
-
-                                    point = list.at(j).getEnd();
-                                    if (!list.at(j).isAbsolute()) point -= list.at(j).getStart();
-                                    if (!list.at(j).isMetric()) point /= 25.4;
-                                    auto coords = QString("X%1Y%2Z%3")
-                                            .arg(point.x(), 0, 'f', 3).arg(point.y(), 0, 'f', 3).arg(point.z(), 0, 'f', 3);
-                                    item.command = newCommand + coords.toUtf8();
-                                    modelData.push_back(item);
-
-                                    newCommand.clear();
-                                    j++;
-                                }
-                            // Copy original command if not G0 or G1
-                            } else {
-                                item.command = command;
-                                modelData.push_back(item);
-                            }
+    long long total = 0;
+    for (auto count : commands) total += count;
 
-                            lastSegmentIndex = j;
-                            break;
-                        }
-                    }
-                }
-                lastCommandIndex = line;
+    ui->chkHeightMapUse->setToolTip(tr("Program is sent as %1 commands, tolerance %2 mm")
+                                    .arg(total).arg(m_heightMapCompensator.tolerance(), 0, 'f', 3));
+}
 
-                if (progress.isVisible() && (time.elapsed() % PROGRESSSTEP == 0)) {
-                    progress.setValue(i);
-                    qApp->processEvents();
-                    if (progress.wasCanceled()) throw cancel;
-                }
-            }
-            m_programHeightmapModel.insertRow(m_programHeightmapModel.rowCount());
-        }
-        progress.close();
+bool frmMain::updateHeightMapSubdivision()
+{
+    // Segments are subdivided by interpolation step, so preview is offset at same points as sent
+    if (!ui->chkHeightMapUse->isChecked() || m_heightMapMode
+            || m_viewParser.subdivisionStep() == m_heightMapCompensator.step()) return false;
 
-        qDebug() << "Program modification time: " << time.elapsed();
+    bool const fileChanged = m_fileChanged;
+    m_viewParser.setSubdivisionStep(m_heightMapCompensator.step());
+    updateParser();
+    m_fileChanged = fileChanged;
 
-        ui->tblProgram->setModel(&m_programHeightmapModel);
-        ui->tblProgram->horizontalHeader()->restoreState(headerState);
+    return true;
+}
 
-        connect(ui->tblProgram->selectionModel(), &QItemSelectionModel::currentChanged, this, &frmMain::onTableCurrentChanged);
+void frmMain::updateHeightMapCompensator()
+{
+    QRectF borderRect = borderRectFromTextboxes();
 
-        m_programLoading = false;
+    m_heightMapCompensator.setSurface(std::make_shared<HeightMapSurface const>(borderRect, &m_heightMapModel));
+    m_heightMapCompensator.setStep(QSizeF(borderRect.width() / (ui->txtHeightMapInterpolationStepX->value() - 1),
+                                          borderRect.height() / (ui->txtHeightMapInterpolationStepY->value() - 1)));
+    m_heightMapCompensator.setTolerance(ui->txtHeightMapTolerance->value());
 
-        // Update parser
-        m_currentDrawer = m_codeDrawer;
-        updateParser();
+    // Preview follows surface without geometry update
+    m_codeDrawer->setHeightMap(*m_heightMapCompensator.surface());
 
-        // Select first row
-        ui->tblProgram->selectRow(0);
+    // Offset range changes extremes & compensated moves lengths
+    if (m_codeDrawer->heightMapEnabled()) {
+        ui->glwVisualizer->updateExtremes(m_codeDrawer);
+        updateProgramEstimatedTime(&m_viewParser);
     }
-    catch (CancelException) {                       // Cancel modification
-        m_programHeightmapModel.clear();
-        m_currentModel = &m_programModel;
+}
 
-        ui->tblProgram->setModel(&m_programModel);
-        ui->tblProgram->horizontalHeader()->restoreState(headerState);
+void frmMain::updateHeightMapInterpolationPoint(int column, int row)
+{
+    if (m_settingsLoading) return;
 
-        connect(ui->tblProgram->selectionModel(), &QItemSelectionModel::currentChanged, this, &frmMain::onTableCurrentChanged);
-        ui->tblProgram->selectRow(0);
+    auto const current = m_heightMapCompensator.surface();
+    auto *data = m_heightMapInterpolationDrawer.data();
 
-        ui->chkHeightMapUse->setChecked(false);
+    int const interpolationPointsX = ui->txtHeightMapInterpolationStepX->value();
+    int const interpolationPointsY = ui->txtHeightMapInterpolationStepY->value();
 
+    // Full update if grid changed since last interpolation
+    if (!current || !current->isValid() || current->columns() != m_heightMapModel.columnCount() || current->rows() != m_heightMapModel.rowCount()
+            || current->borderRect() != borderRectFromTextboxes() || !data || data->count() != interpolationPointsY
+            || data->isEmpty() || data->at(0).count() != interpolationPointsX || interpolationPointsX < 2 || interpolationPointsY < 2) {
+        updateHeightMapInterpolationDrawer();
         return;
-    } else {                                        // Restore original program
-        m_currentModel = &m_programModel;
-
-        ui->tblProgram->setModel(&m_programModel);
-        ui->tblProgram->horizontalHeader()->restoreState(headerState);
-
-        connect(ui->tblProgram->selectionModel(), &QItemSelectionModel::currentChanged, this, &frmMain::onTableCurrentChanged);
-
-        // Store changes flag
-        bool fileChanged = m_fileChanged;
-
-        // Update parser
-        updateParser();
-
-        // Select first row
-        ui->tblProgram->selectRow(0);
+    }
 
-        // Restore changes flag
-        m_fileChanged = fileChanged;
+    // Surface is shared with compensator & possibly sending, so modify copy
+    auto surface = std::make_shared<HeightMapSurface>(*current);
+    surface->setValue(column, row, m_heightMapModel.data(m_heightMapModel.index(row, column), Qt::UserRole).toDouble());
+    m_heightMapCompensator.setSurface(surface);
+    m_codeDrawer->setHeightMap(*surface);
+
+    // Changed base point is used by 4x4 neighbour cells only
+    QRectF const borderRect = surface->borderRect();
+    double const gridStepX = borderRect.width() / (surface->columns() - 1);
+    double const gridStepY = borderRect.height() / (surface->rows() - 1);
+    double const interpolationStepX = borderRect.width() / (interpolationPointsX - 1);
+    double const interpolationStepY = borderRect.height() / (interpolationPointsY - 1);
+
+    // Interpolation points on affected cells, one point margin covers rounding at cell borders
+    int const left = qMax(0, static_cast<int>(floor(qMax(0, column - 2) * gridStepX / interpolationStepX)) - 1);
+    int const right = qMin(interpolationPointsX - 1, static_cast<int>(ceil(qMin(surface->columns() - 1, column + 2) * gridStepX / interpolationStepX)) + 1);
+    int const top = qMax(0, static_cast<int>(floor(qMax(0, row - 2) * gridStepY / interpolationStepY)) - 1);
+    int const bottom = qMin(interpolationPointsY - 1, static_cast<int>(ceil(qMin(surface->rows() - 1, row + 2) * gridStepY / interpolationStepY)) + 1);
+
+    std::vector<double> xs(right - left + 1);
+    std::vector<double> ys(xs.size());
+    std::vector<double> zs;
+
+    for (int j = left; j <= right; j++) xs[j - left] = interpolationStepX * j + borderRect.x();
+
+    for (int i = top; i <= bottom; i++) {
+        std::fill(ys.begin(), ys.end(), interpolationStepY * i + borderRect.y());
+        surface->evaluate(xs, ys, zs);
+
+        QVector<double> &interpolationRow = (*data)[i];
+        for (int j = left; j <= right; j++) interpolationRow[j] = zs[j - left];
     }
 
-    // Update groupbox title
-    ui->grpHeightMap->setProperty("overrided", checked);
-    style()->unpolish(ui->grpHeightMap);
-    ui->grpHeightMap->ensurePolished();
+    m_heightMapInterpolationDrawer.updateRegion(QRect(QPoint(left, top), QPoint(right, bottom)));
 
-    // Update menu
-    ui->actFileSaveTransformedAs->setVisible(checked);
+    // Update grid drawer
+    m_heightMapGridDrawer.update();
 }
 
-LineSegment::Container frmMain::subdivideSegment(LineSegment const &segment)
+HeightMapCompensator frmMain::createHeightMapCompensator() const
 {
-    LineSegment::Container list;
-
-    QRectF borderRect = borderRectFromTextboxes();
+    // Program independent copy of current compensator
+    HeightMapCompensator compensator;
+    compensator.setSurface(m_heightMapCompensator.surface());
+    compensator.setStep(m_heightMapCompensator.step());
+    compensator.setTolerance(m_heightMapCompensator.tolerance());
+    compensator.setArcPrecision(m_settings->arcPrecision(), m_settings->arcDegreeMode());
+    compensator.reset(m_codeDrawer->getIgnoreZ() ? QVector3D(qQNaN(), qQNaN(), 0)
+                                                 : QVector3D(qQNaN(), qQNaN(), qQNaN()));
 
-    double interpolationStepX = borderRect.width() / (ui->txtHeightMapInterpolationStepX->value() - 1);
-    double interpolationStepY = borderRect.height() / (ui->txtHeightMapInterpolationStepY->value() - 1);
+    return compensator;
+}
 
-    double length;
+bool frmMain::isHeightMapCompensated() const
+{
+    return m_currentModel == &m_programModel && m_codeDrawer->heightMapEnabled()
+            && m_heightMapCompensator.isActive();
+}
 
-    QVector3D vec = segment.getEnd() - segment.getStart();
+void frmMain::resetHeightMapCompensator(int commandIndex)
+{
+    m_compensatedCommands.clear();
+    m_sendPreprocessor.reset();
 
-    if (qIsNaN(vec.length())) return list;
+    if (!isHeightMapCompensated()) return;
 
-    if (fabs(vec.x()) / fabs(vec.y()) < interpolationStepX / interpolationStepY) length = interpolationStepY / (vec.y() / vec.length());
-    else length = interpolationStepX / (vec.x() / vec.length());
+    m_heightMapCompensator.reset(m_codeDrawer->getIgnoreZ() ? QVector3D(qQNaN(), qQNaN(), 0)
+                                                           : QVector3D(qQNaN(), qQNaN(), qQNaN()));
 
-    length = fabs(length);
+    // Restore modal state of skipped lines, their moves aren't subdivided
+    auto const &modelData = m_programModel.data();
+    for (int i = 0; i < commandIndex; i++) m_heightMapCompensator.advance(modelData.at(i).args);
+}
 
-    if (qIsNaN(length)) {
-        qDebug() << "ERROR length:" << segment.getStart() << segment.getEnd();
-        return list;
-    }
+void frmMain::updateSendPreprocessor()
+{
+    m_sendPreprocessor.setEnabled(m_settings->compactCommands());
+    m_sendPreprocessor.setDecimals(m_settings->compactDecimals() < 0 ? SendPreprocessor::decimals(m_stepsPerMm)
+                                                                     : m_settings->compactDecimals());
+    m_sendPreprocessor.setRemoveRedundant(m_settings->removeRedundantWords());
+}
 
-    QVector3D seg = vec.normalized() * length;
-    int count = trunc(vec.length() / length);
+void frmMain::runParallel(QProgressDialog &progress, int chunks, std::function<void(int, Parallel::Progress &)> const &fn)
+{
+    Parallel::Progress state;
+    std::atomic<bool> finished{false};
 
-    if (count == 0) return list;
+    std::thread worker([&] {
+        Parallel::forEachChunk(chunks, [&](int chunk) { fn(chunk, state); });
+        finished = true;
+    });
 
-    for (int i = 0; i < count; i++) {
-        LineSegment line(segment);
-        line.setStart(i == 0 ? segment.getStart() : list[i - 1].getEnd());
-        line.setEnd(line.getStart() + seg);
-        list.push_back(line);
+    // Keep progress dialog responsive while workers run
+    while (!finished) {
+        progress.setValue(static_cast<int>(qMin<long long>(state.done, progress.maximum())));
+        qApp->processEvents();
+        if (progress.wasCanceled()) state.cancelled = true;
+        QThread::msleep(20);
     }
+    worker.join();
 
-    if (!list.empty() && list.back().getEnd() != segment.getEnd()) {
-        LineSegment line(segment);
-        line.setStart(list.back().getEnd());
-        line.setEnd(segment.getEnd());
-        list.push_back(line);
-    }
+    if (state.cancelled) throw CancelException();
+}
 
-    return list;
+void frmMain::runInBackground(QProgressDialog &progress, std::function<void(Parallel::Progress &)> const &fn)
+{
+    // Pass is sequential or splits its work to threads itself
+    runParallel(progress, 1, [&](int, Parallel::Progress &state) { fn(state); });
 }
 
 void frmMain::on_cmdHeightMapCreate_clicked()
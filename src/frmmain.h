@@ -16,10 +16,21 @@
 #include <QDragEnterEvent>
 #include <QDropEvent>
 #include <QProgressDialog>
+#include <atomic>
 #include <exception>
+#include <functional>
+#include <thread>
 
 #include <QElapsedTimer>
+#include "parser/arcfitter.h"
 #include "parser/gcodeviewparse.h"
+#include "parser/grblchecker.h"
+#include "parser/heightmapcompensator.h"
+#include "parser/modalstateindex.h"
+#include "parser/rapidoptimizer.h"
+#include "parser/segmentmerger.h"
+#include "parser/sendpreprocessor.h"
+#include "parser/timeestimator.h"
 
 #include "drawers/origindrawer.h"
 #include "drawers/gcodedrawer.h"
@@ -33,7 +44,9 @@
 #include "tables/gcodetablemodel.h"
 #include "tables/heightmaptablemodel.h"
 
-#include "utils/interpolation.h"
+#include "utils/adaptiveprobing.h"
+#include "utils/heightmapsurface.h"
+#include "utils/parallel.h"
 
 #include "widgets/styledtoolbutton.h"
 #include "widgets/sliderbox.h"
@@ -129,6 +142,10 @@ private slots:
     void on_actFileNew_triggered();
     void on_cmdClearConsole_clicked();
     void on_actFileSaveAs_triggered();
+    void on_actFileCheck_triggered();
+    void on_actProgramFitArcs_triggered();
+    void on_actProgramMergeSegments_triggered();
+    void on_actProgramReorderRapids_triggered();
     void on_actFileSave_triggered();
     void on_actFileSaveTransformedAs_triggered();
     void on_cmdTop_clicked();
@@ -152,14 +169,19 @@ private slots:
     void on_txtHeightMapBorderHeight_valueChanged(double arg1);
     void on_chkHeightMapGridShow_toggled(bool checked);
     void on_txtHeightMapGridX_valueChanged(double arg1);
+    void on_chkHeightMapAdaptive_toggled(bool checked);
+    void on_txtHeightMapAdaptiveTolerance_valueChanged(double arg1);
     void on_txtHeightMapGridY_valueChanged(double arg1);
     void on_txtHeightMapGridZBottom_valueChanged(double arg1);
     void on_txtHeightMapGridZTop_valueChanged(double arg1);
     void on_cmdHeightMapMode_toggled(bool checked);
     void on_chkHeightMapInterpolationShow_toggled(bool checked);
+    void on_chkHeightMapInterpolationSurface_toggled(bool checked);
+    void on_chkHeightMapInterpolationWireframe_toggled(bool checked);
     void on_cmdHeightMapLoad_clicked();
     void on_txtHeightMapInterpolationStepX_valueChanged(double arg1);
     void on_txtHeightMapInterpolationStepY_valueChanged(double arg1);
+    void on_txtHeightMapTolerance_valueChanged(double arg1);
     void on_chkHeightMapUse_clicked(bool checked);
     void on_cmdHeightMapCreate_clicked();
     void on_cmdHeightMapBorderAuto_clicked();
@@ -222,11 +244,27 @@ private:
     SelectionDrawer m_selectionDrawer;
 
     GCodeTableModel m_programModel;
+    ModalStateIndex m_modalStateIndex;          // Modal state of program model rows
     GCodeTableModel m_probeModel;
-    GCodeTableModel m_programHeightmapModel;
+    HeightMapCompensator m_heightMapCompensator;
+    AdaptiveProbing m_adaptiveProbing;
+    std::vector<QPoint> m_probePoints; // Heightmap grid point of each probe command after reference one
+    QByteArrayList m_compensatedCommands;       // Commands of row being sent, compacted on sending
+    QByteArray m_resumeMotion;                  // Arc motion word for first row sent from line
+    SendPreprocessor m_sendPreprocessor;
+    QVector3D m_stepsPerMm;                     // Reported by '$$', used for sent commands precision
 
     HeightMapTableModel m_heightMapModel;
 
+    // Program time estimation
+    TimeEstimator::Machine m_machine;           // Limits reported by '$$'
+    bool m_machineReceived = false;
+    bool m_softLimits = false;
+    QVector3D m_maxTravel;
+    std::thread m_estimationThread;
+    std::atomic<bool> m_estimationCancelled{false};
+    int m_estimationGeneration = 0;
+
     bool m_programLoading;
     bool m_settingsLoading;
 
@@ -343,8 +381,12 @@ private:
     static bool dataIsEnd(QString const &data);
     static bool dataIsReset(QString const &data);
 
-    QTime updateProgramEstimatedTime(LineSegment::Container const & lines);
-    bool saveProgramToFile(QString const &fileName, GCodeTableModel *model);
+    void updateProgramEstimatedTime(GcodeViewParse *parser);
+    void updateEstimatedTime();
+    void stopProgramTimeEstimation();
+    TimeEstimator::Machine estimationMachine() const;
+    bool saveProgramToFile(QString const &fileName, GCodeTableModel *model, HeightMapCompensator *compensator = nullptr);
+    bool replaceProgram(QByteArrayList const &commands, QString const &report);
     static QString feedOverride(QString const &command);
 
     bool eventFilter(QObject *obj, QEvent *event);
@@ -364,7 +406,19 @@ private:
     bool saveHeightMap(QString const &fileName);
 
     GCodeTableModel *m_currentModel;
-    LineSegment::Container subdivideSegment(LineSegment const &segment);
+    void updateHeightMapCompensator();
+    bool updateHeightMapSubdivision();
+    void updateHeightMapCompensatedSize();
+    void updateHeightMapInterpolationPoint(int column, int row);
+    void appendProbeCommands(std::vector<QPoint> const &points);
+    void refineAdaptiveProbing();
+    HeightMapCompensator createHeightMapCompensator() const;
+    bool isHeightMapCompensated() const;
+    void resetHeightMapCompensator(int commandIndex);
+    void updateSendPreprocessor();
+    QString nextFileCommand(SendPreprocessor &preprocessor);
+    void runParallel(QProgressDialog &progress, int chunks, std::function<void(int, Parallel::Progress &)> const &fn);
+    void runInBackground(QProgressDialog &progress, std::function<void(Parallel::Progress &)> const &fn);
     void resizeTableHeightMapSections();
     void updateHeightMapGrid(double arg1);
     void resetHeightmap();
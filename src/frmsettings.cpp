@@ -221,6 +221,26 @@ void frmSettings::setArcDegreeMode(bool arcDegreeMode)
     ui->radArcDegreeMode->setChecked(arcDegreeMode);
 }
 
+bool frmSettings::adaptiveArcs()
+{
+    return ui->chkAdaptiveArcs->isChecked();
+}
+
+void frmSettings::setAdaptiveArcs(bool adaptiveArcs)
+{
+    ui->chkAdaptiveArcs->setChecked(adaptiveArcs);
+}
+
+double frmSettings::arcTolerance()
+{
+    return ui->txtArcTolerance->value();
+}
+
+void frmSettings::setArcTolerance(double arcTolerance)
+{
+    ui->txtArcTolerance->setValue(arcTolerance);
+}
+
 bool frmSettings::showProgramCommands()
 {
     return ui->chkShowProgramCommands->isChecked();
@@ -381,6 +401,16 @@ void frmSettings::setFps(int fps)
     ui->cboFps->setCurrentText(QString::number(fps));
 }
 
+int frmSettings::idleFps()
+{
+    return ui->txtIdleFps->value();
+}
+
+void frmSettings::setIdleFps(int idleFps)
+{
+    ui->txtIdleFps->setValue(idleFps);
+}
+
 bool frmSettings::vsync()
 {
     return ui->chkVSync->isChecked();
@@ -584,6 +614,36 @@ void frmSettings::setAutoLine(bool value)
     ui->chkAutoLine->setChecked(value);
 }
 
+bool frmSettings::compactCommands()
+{
+    return ui->chkCompactCommands->isChecked();
+}
+
+void frmSettings::setCompactCommands(bool value)
+{
+    ui->chkCompactCommands->setChecked(value);
+}
+
+int frmSettings::compactDecimals()
+{
+    return ui->txtCompactDecimals->value();
+}
+
+void frmSettings::setCompactDecimals(int value)
+{
+    ui->txtCompactDecimals->setValue(value);
+}
+
+bool frmSettings::removeRedundantWords()
+{
+    return ui->chkRemoveRedundantWords->isChecked();
+}
+
+void frmSettings::setRemoveRedundantWords(bool value)
+{
+    ui->chkRemoveRedundantWords->setChecked(value);
+}
+
 void frmSettings::showEvent(QShowEvent *se)
 {
     Q_UNUSED(se)
@@ -636,6 +696,9 @@ void frmSettings::resetDefaults()
     setBaud(115200);
 
     setIgnoreErrors(false);
+    setCompactCommands(false);
+    setCompactDecimals(-1);
+    setRemoveRedundantWords(true);
 
     setQueryStateTime(40);
     setRapidSpeed(2000);
@@ -654,6 +717,8 @@ void frmSettings::resetDefaults()
     setArcLength(0.0);
     setArcDegreeMode(true);
     setArcDegree(5.0);
+    setAdaptiveArcs(false);
+    setArcTolerance(0.5);
 
     setLineWidth(1.5);
     setAntialiasing(true);
@@ -661,6 +726,7 @@ void frmSettings::resetDefaults()
     setSimplify(true);
     setSimplifyPrecision(0.0);
     setFps(60);
+    setIdleFps(1);
     setZBuffer(false);
     setGrayscaleSegments(false);
     setGrayscaleSCode(true);
@@ -45,6 +45,10 @@ public:
     double arcPrecision();
     bool arcDegreeMode();
     void setArcDegreeMode(bool arcDegreeMode);
+    bool adaptiveArcs();
+    void setAdaptiveArcs(bool adaptiveArcs);
+    double arcTolerance();
+    void setArcTolerance(double arcTolerance);
     bool showProgramCommands();
     void setShowProgramCommands(bool showProgramCommands);
     bool showUICommands();
@@ -77,6 +81,8 @@ public:
     void setToolAngle(double toolAngle);
     int fps();
     void setFps(int fps);
+    int idleFps();
+    void setIdleFps(int idleFps);
     bool vsync();
     void setVsync(bool value);
     bool msaa();
@@ -117,6 +123,12 @@ public:
     void setIgnoreErrors(bool value);
     bool autoLine();
     void setAutoLine(bool value);
+    bool compactCommands();
+    void setCompactCommands(bool value);
+    int compactDecimals();
+    void setCompactDecimals(int value);
+    bool removeRedundantWords();
+    void setRemoveRedundantWords(bool value);
 
     bool showLinearMotion() const;
     void setShowLinearMotion(bool value);
@@ -0,0 +1,315 @@
+// This file is a part of "Candle" application.
+// Copyright 2015-2016 Hayrullin Denis Ravilevich
+
+#include "arcfitter.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // Plane axes in G2/G3 rotation order, and normal axis
+    void planeAxes(PointSegment::planes plane, int &axis0, int &axis1, int &normal)
+    {
+        switch (plane) {
+        case PointSegment::ZX: axis0 = 2; axis1 = 0; normal = 1; break;
+        case PointSegment::YZ: axis0 = 1; axis1 = 2; normal = 0; break;
+        default: axis0 = 0; axis1 = 1; normal = 2; break;
+        }
+    }
+
+    bool sameCoordinate(double a, double b)
+    {
+        return a == b || (qIsNaN(a) && qIsNaN(b));
+    }
+}
+
+ArcFitter::ArcFitter()
+{
+    reset();
+}
+
+void ArcFitter::reset()
+{
+    m_parser = std::make_unique<GcodeParser>();
+    m_parser->setInteractive(false);
+    m_modalArc = false;
+    m_position.fill(qQNaN());
+
+    m_run.clear();
+    m_points.clear();
+
+    m_commands.clear();
+    m_arcCount = 0;
+    m_inputLines = 0;
+    m_inputBytes = 0;
+    m_outputBytes = 0;
+}
+
+void ArcFitter::addCommand(QByteArray const &command, QByteArrayList const &args)
+{
+    m_inputLines++;
+    m_inputBytes += command.size() + 1;
+
+    // Classify words, fittable line has optional G1, axis, feed and line number words only
+    Line line{command, QByteArray(), false, false};
+    bool fittable = !command.contains('(') && !command.contains(';');
+    bool axisWords = false;
+    bool nonModalAxes = false;
+    Point words{qQNaN(), qQNaN(), qQNaN()};
+
+    for (auto const &arg : args) {
+        char const letter = GcodePreprocessorUtils::toUpper(arg.at(0));
+        switch (letter) {
+        case 'G': {
+            float const code = GcodePreprocessorUtils::AtoF(arg.data() + 1);
+            if (code == 1.0f) {
+                line.hasMotion = true;
+                break;
+            }
+            if (code == 0.0f || code == 2.0f || code == 3.0f || code == 80.0f || std::floor(code) == 38.0f) line.hasMotion = true;
+            else if (code == 10.0f || code == 28.0f || code == 30.0f || code == 92.0f) nonModalAxes = true;
+            fittable = false;
+            break;
+        }
+        case 'X': case 'Y': case 'Z':
+            axisWords = true;
+            words[letter - 'X'] = GcodePreprocessorUtils::AtoF(arg.data() + 1);
+            break;
+        case 'F': line.feed = arg; break;
+        case 'N': break;
+        default: fittable = false; break;
+        }
+    }
+    line.hasAxes = axisWords && !nonModalAxes;
+
+    // Update modal state, only last point segment is kept by parser
+    Point const start = m_position;
+
+    m_parser->trimPointSegments();
+    int const commandNumber = m_parser->getCommandNumber();
+    m_parser->addCommand(args);
+
+    // Word value is kept if parser point is its float, so fitted arc words aren't rounded to float
+    QVector3D const point = *m_parser->getCurrentPoint();
+    for (int i = 0; i < 3; i++) {
+        double const source = qIsNaN(words[i]) ? m_position[i] : words[i];
+        m_position[i] = static_cast<float>(source) == point[i] ? source : point[i];
+    }
+
+    if (fittable && axisWords && m_parser->getCommandNumber() != commandNumber) {
+        PointSegment const &segment = m_parser->getPointSegmentList().back();
+        PointSegment::planes const plane = m_parser->getCurrentPlane();
+
+        int axis0, axis1, normal;
+        planeAxes(plane, axis0, axis1, normal);
+        Point const &end = m_position;
+
+        fittable = !segment.isFastTraverse() && !segment.isArc() && segment.isAbsolute()
+                && !qIsNaN(start[axis0]) && !qIsNaN(start[axis1]) && !qIsNaN(end[axis0]) && !qIsNaN(end[axis1]);
+
+        if (fittable) {
+            bool const continues = !m_run.empty() && segment.getSpeed() == m_runSpeed
+                    && segment.isMetric() == m_runMetric && plane == m_runPlane;
+
+            if (!continues) {
+                flush();
+                m_points.push_back(start);
+                m_runSpeed = segment.getSpeed();
+                m_runMetric = segment.isMetric();
+                m_runPlane = plane;
+            }
+
+            m_run.push_back(line);
+            m_points.push_back(end);
+            return;
+        }
+    }
+
+    flush();
+    append(line);
+}
+
+void ArcFitter::finish()
+{
+    flush();
+}
+
+void ArcFitter::flush()
+{
+    int const count = static_cast<int>(m_run.size());
+    int first = 0;
+
+    // Line i moves from point i to point i + 1
+    while (first < count) {
+        Arc arc;
+        int const last = fitEnd(first, arc);
+
+        if (last == first) {
+            append(m_run[first++]);
+        } else {
+            appendArc(first, last, arc);
+            first = last;
+        }
+    }
+
+    m_run.clear();
+    m_points.clear();
+}
+
+int ArcFitter::fitEnd(int first, Arc &arc) const
+{
+    // Arc should replace several lines
+    int const minLines = 3;
+    int const last = static_cast<int>(m_points.size()) - 1;
+
+    if (first + minLines > last || !fits(first, first + minLines, arc)) return first;
+
+    // Gallop while arc fits, then bisect between last fitting and first failing ends
+    int good = first + minLines;
+    int step = minLines;
+
+    while (good < last) {
+        int const next = std::min(last, good + step);
+        Arc candidate;
+        if (fits(first, next, candidate)) {
+            good = next;
+            arc = candidate;
+            step *= 2;
+            continue;
+        }
+
+        int bad = next;
+        while (bad - good > 1) {
+            int const middle = (good + bad) / 2;
+            if (fits(first, middle, candidate)) {
+                good = middle;
+                arc = candidate;
+            } else {
+                bad = middle;
+            }
+        }
+        break;
+    }
+
+    return good;
+}
+
+bool ArcFitter::fits(int first, int last, Arc &arc) const
+{
+    int axis0, axis1, normal;
+    planeAxes(m_runPlane, axis0, axis1, normal);
+
+    double const tolerance = m_runMetric ? m_tolerance : m_tolerance / 25.4;
+    auto const u = [&](int i) { return m_points[i][axis0]; };
+    auto const v = [&](int i) { return m_points[i][axis1]; };
+
+    // Arc doesn't move along normal
+    for (int i = first + 1; i <= last; i++) {
+        if (!sameCoordinate(m_points[i][normal], m_points[first][normal])) return false;
+    }
+
+    // Circle through start, middle and end points
+    int const middle = (first + last) / 2;
+    double const bu = u(middle) - u(first);
+    double const bv = v(middle) - v(first);
+    double const cu = u(last) - u(first);
+    double const cv = v(last) - v(first);
+    double const d = 2 * (bu * cv - bv * cu);
+    if (d == 0) return false;
+
+    double const b2 = bu * bu + bv * bv;
+    double const c2 = cu * cu + cv * cv;
+    double const ou = (cv * b2 - bv * c2) / d;
+    double const ov = (bu * c2 - cu * b2) / d;
+    double const radius = std::hypot(ou, ov);
+
+    arc.center[0] = u(first) + ou;
+    arc.center[1] = v(first) + ov;
+    arc.clockwise = d < 0;
+
+    // Vertices on circle, chords within tolerance, rotation in one direction below full turn
+    double const direction = arc.clockwise ? -1 : 1;
+    double sweep = 0;
+
+    for (int i = first; i <= last; i++) {
+        double const pu = u(i) - arc.center[0];
+        double const pv = v(i) - arc.center[1];
+        if (std::fabs(std::hypot(pu, pv) - radius) > tolerance) return false;
+
+        if (i == last) break;
+
+        double const qu = u(i + 1) - arc.center[0];
+        double const qv = v(i + 1) - arc.center[1];
+        double const cross = (pu * qv - pv * qu) * direction;
+        if (cross <= 0) return false;
+
+        double const halfChord = std::hypot(u(i + 1) - u(i), v(i + 1) - v(i)) / 2;
+        if (halfChord >= radius || radius - std::sqrt(radius * radius - halfChord * halfChord) > tolerance) return false;
+
+        sweep += std::atan2(cross, pu * qu + pv * qv);
+    }
+    if (sweep >= 2 * M_PI) return false;
+
+    // Straight runs are left to lines
+    double const chord = std::hypot(cu, cv);
+    for (int i = first + 1; i < last; i++) {
+        double const pu = u(i) - u(first);
+        double const pv = v(i) - v(first);
+        double const deviation = chord > 0 ? std::fabs(pu * cv - pv * cu) / chord : std::hypot(pu, pv);
+        if (deviation > tolerance) return true;
+    }
+
+    return false;
+}
+
+void ArcFitter::append(Line const &line)
+{
+    QByteArray command = line.command;
+
+    // Restore linear motion mode after emitted arc
+    if (m_modalArc && line.hasAxes && !line.hasMotion) {
+        command.prepend("G1");
+        m_modalArc = false;
+    } else if (line.hasMotion) {
+        m_modalArc = false;
+    }
+
+    m_outputBytes += command.size() + 1;
+    m_commands.append(command);
+}
+
+void ArcFitter::appendArc(int first, int last, Arc const &arc)
+{
+    static char const axes[] = "XYZ";
+    static char const offsets[] = "IJK";
+
+    int axis0, axis1, normal;
+    planeAxes(m_runPlane, axis0, axis1, normal);
+
+    Point const &start = m_points[first];
+    Point const &end = m_points[last];
+
+    QByteArray command(arc.clockwise ? "G2" : "G3");
+    command += axes[axis0] + format(end[axis0]) + axes[axis1] + format(end[axis1]);
+    command += offsets[axis0] + format(arc.center[0] - start[axis0]);
+    command += offsets[axis1] + format(arc.center[1] - start[axis1]);
+
+    // Feed of replaced lines, all of them have same value
+    for (int i = first; i < last; i++) {
+        if (!m_run[i].feed.isEmpty()) {
+            command += m_run[i].feed;
+            break;
+        }
+    }
+
+    m_modalArc = true;
+    m_arcCount++;
+    m_outputBytes += command.size() + 1;
+    m_commands.append(command);
+}
+
+QByteArray ArcFitter::format(double value) const
+{
+    return GcodePreprocessorUtils::formatNumber(value, m_runMetric ? 4 : 5);
+}
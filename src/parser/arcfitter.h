@@ -0,0 +1,89 @@
+// This file is a part of "Candle" application.
+// Copyright 2015-2016 Hayrullin Denis Ravilevich
+
+#ifndef ARCFITTER_H
+#define ARCFITTER_H
+
+#include <QByteArrayList>
+#include <QVector3D>
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "gcodeparser.h"
+
+/// \brief Streaming replacement of G1 polylines with G2/G3 arcs
+/// Runs of absolute G1 moves with same feed, units and plane are collected and greedily covered by longest
+/// arcs whose every vertex and chord stays within tolerance of fitted circle. Arcs lie in current plane
+/// (G17/G18/G19), coordinate along plane normal must not change over arc. Lines with comments, incremental
+/// moves and moves with other words are passed unchanged.
+class ArcFitter
+{
+public:
+    ArcFitter();
+
+    /// \brief maximum deviation of original vertices and chords from fitted arc, mm
+    [[nodiscard]] double tolerance() const { return m_tolerance; }
+    void setTolerance(double tolerance) { m_tolerance = tolerance; }
+
+    /// \brief restart program, modal state is set to defaults and output is cleared
+    void reset();
+    /// \brief append program command, output is produced as G1 runs end
+    void addCommand(QByteArray const &command, QByteArrayList const &args);
+    /// \brief flush pending G1 run, must be called after last command
+    void finish();
+
+    [[nodiscard]] QByteArrayList const &commands() const { return m_commands; }
+    [[nodiscard]] int arcCount() const { return m_arcCount; }
+    [[nodiscard]] int linesRemoved() const { return m_inputLines - static_cast<int>(m_commands.size()); }
+    /// \brief bytes removed, line feed is counted for every line
+    [[nodiscard]] qint64 bytesRemoved() const { return m_inputBytes - m_outputBytes; }
+
+private:
+    struct Line
+    {
+        QByteArray command;
+        QByteArray feed;            // F word if present
+        bool hasMotion;             // Explicit motion mode word
+        bool hasAxes;               // Axis words are move target
+    };
+
+    using Point = std::array<double, 3>;
+
+    struct Arc
+    {
+        double center[2];           // Plane axes coordinates
+        bool clockwise;
+    };
+
+    double m_tolerance = 0.01;
+
+    // Program state
+    std::unique_ptr<GcodeParser> m_parser;
+    bool m_modalArc = false;        // Last emitted motion mode is arc, implicit moves need G1
+    Point m_position;               // Current point with source words precision, parser keeps floats
+
+    // Current G1 run, points are in program units, first point is run start
+    std::vector<Line> m_run;
+    std::vector<Point> m_points;
+    double m_runSpeed = 0;
+    bool m_runMetric = true;
+    PointSegment::planes m_runPlane = PointSegment::XY;
+
+    // Output
+    QByteArrayList m_commands;
+    int m_arcCount = 0;
+    int m_inputLines = 0;
+    qint64 m_inputBytes = 0;
+    qint64 m_outputBytes = 0;
+
+    void flush();
+    /// \return last point index of longest arc starting at point \a first, \a first if no arc fits
+    int fitEnd(int first, Arc &arc) const;
+    [[nodiscard]] bool fits(int first, int last, Arc &arc) const;
+    void append(Line const &line);
+    void appendArc(int first, int last, Arc const &arc);
+    [[nodiscard]] QByteArray format(double value) const;
+};
+
+#endif // ARCFITTER_H
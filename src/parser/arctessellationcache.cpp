@@ -0,0 +1,65 @@
+// This file is a part of "Candle" application.
+// Copyright 2015-2016 Hayrullin Denis Ravilevich
+
+#include "arctessellationcache.h"
+
+#include <cstdint>
+
+std::size_t ArcTessellationCache::KeyHash::operator()(Key const &key) const
+{
+    // FNV-1a over value bits
+    std::uint64_t hash = 14695981039346656037ull ^ static_cast<std::uint64_t>(key.flags);
+    for (double const value : key.values) {
+        std::uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        hash = (hash ^ bits) * 1099511628211ull;
+        hash ^= hash >> 29;
+    }
+    return static_cast<std::size_t>(hash);
+}
+
+ArcTessellationCache::Points const &ArcTessellationCache::points(PointSegment::planes plane, QVector3D const &start,
+                                                                 QVector3D const &end, QVector3D const &center,
+                                                                 bool clockwise, double radius, double minArcLength,
+                                                                 double arcPrecision, bool arcDegreeMode)
+{
+    Key const key{{start.x(), start.y(), start.z(), end.x(), end.y(), end.z(), center.x(), center.y(), center.z(),
+                   radius, minArcLength, arcPrecision},
+                  static_cast<int>(plane) << 2 | (clockwise ? 2 : 0) | (arcDegreeMode ? 1 : 0)};
+
+    auto const current = m_current.find(key);
+    if (current != m_current.end()) {
+        m_hits++;
+        return current->second;
+    }
+
+    // Arc of previous pass is moved to current one
+    auto previous = m_previous.extract(key);
+    if (!previous.empty()) {
+        m_hits++;
+        return m_current.insert(std::move(previous)).position->second;
+    }
+
+    m_misses++;
+    return m_current.emplace(key, GcodePreprocessorUtils::generatePointsAlongArcBDring(plane, start, end, center,
+                             clockwise, radius, minArcLength, arcPrecision, arcDegreeMode)).first->second;
+}
+
+void ArcTessellationCache::startPass()
+{
+    m_previous.clear();
+    m_previous.swap(m_current);
+}
+
+void ArcTessellationCache::finishPass()
+{
+    m_previous.clear();
+}
+
+void ArcTessellationCache::clear()
+{
+    m_current.clear();
+    m_previous.clear();
+    m_hits = 0;
+    m_misses = 0;
+}
@@ -0,0 +1,60 @@
+// This file is a part of "Candle" application.
+// Copyright 2015-2016 Hayrullin Denis Ravilevich
+
+#ifndef ARCTESSELLATIONCACHE_H
+#define ARCTESSELLATIONCACHE_H
+
+#include <QVector3D>
+#include <array>
+#include <cstring>
+#include <unordered_map>
+
+#include "gcodepreprocessorutils.h"
+
+/// \brief Arc points of point segments reused across re-parses
+/// Arcs are keyed by all arguments of GcodePreprocessorUtils::generatePointsAlongArcBDring. Arcs not requested
+/// during parse pass are dropped when pass is finished, so cache holds arcs of last parsed program only.
+class ArcTessellationCache
+{
+public:
+    using Points = GcodePreprocessorUtils::vectoContainer;
+
+    /// \brief points of arc, same as generatePointsAlongArcBDring returns
+    Points const &points(PointSegment::planes plane, QVector3D const &start, QVector3D const &end,
+                         QVector3D const &center, bool clockwise, double radius, double minArcLength,
+                         double arcPrecision, bool arcDegreeMode);
+
+    /// \brief start parse pass, arcs of previous pass are kept until requested or pass is finished
+    void startPass();
+    /// \brief drop arcs not requested in current pass
+    void finishPass();
+    void clear();
+
+    [[nodiscard]] int size() const { return static_cast<int>(m_current.size() + m_previous.size()); }
+    [[nodiscard]] long long hits() const { return m_hits; }
+    [[nodiscard]] long long misses() const { return m_misses; }
+
+private:
+    struct Key
+    {
+        std::array<double, 12> values;
+        int flags;
+
+        bool operator==(Key const &other) const
+        {
+            return flags == other.flags && !std::memcmp(values.data(), other.values.data(), sizeof(values));
+        }
+    };
+
+    struct KeyHash
+    {
+        std::size_t operator()(Key const &key) const;
+    };
+
+    std::unordered_map<Key, Points, KeyHash> m_current;
+    std::unordered_map<Key, Points, KeyHash> m_previous;
+    long long m_hits = 0;
+    long long m_misses = 0;
+};
+
+#endif // ARCTESSELLATIONCACHE_H
@@ -30,6 +30,15 @@ void GcodeParser::reset(const QVector3D &initialPoint)
     m_points.emplace_back(m_currentPoint, -1);
 }
 
+void GcodeParser::trimPointSegments()
+{
+    if (m_points.size() < 2) return;
+
+    PointSegment last(m_points.back());
+    m_points.clear();
+    m_points.push_back(last);
+}
+
 /**
 * Add a command to be processed.
 */
@@ -248,7 +257,7 @@ PointSegment * GcodeParser::handleGCode(GCodes code, QByteArrayList const &args)
     case G90_1: m_inAbsoluteIJKMode = true; break;
     case G91:
         m_inAbsoluteMode = false;
-        if (qIsNaN(m_currentPoint.x()) || qIsNaN(m_currentPoint.y()) || qIsNaN(m_currentPoint.z())) {
+        if (m_interactive && (qIsNaN(m_currentPoint.x()) || qIsNaN(m_currentPoint.y()) || qIsNaN(m_currentPoint.z()))) {
             int const res = QMessageBox::warning(nullptr, QObject::tr("GcodeParser"),
                                                  QObject::tr("GcodeParser error:Switching to relative mode without previously set current position. Select Ok to set unknown coordinates to 0 or ignore to continue"),
                                                  QMessageBox::Ok | QMessageBox::Ignore);
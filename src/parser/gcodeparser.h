@@ -72,12 +72,30 @@ public:
     PointSegment::Container &getPointSegmentList() {
         return m_points;
     }
+    /**
+     * Drops all point segments but the last one, parser state is kept.
+     * Used by streaming consumers which need current state only.
+     */
+    void trimPointSegments();
     [[nodiscard]] double getTraverseSpeed() const {
         return m_traverseSpeed;
     }
     void setTraverseSpeed(double traverseSpeed) {
         m_traverseSpeed = traverseSpeed;
     }
+    [[nodiscard]] bool getInteractive() const {
+        return m_interactive;
+    }
+    /**
+     * Interactive parser asks user how to resolve ambiguous state, e.g. relative mode at unknown position.
+     * Parsers running off GUI thread must be non-interactive, state is kept as is then.
+     */
+    void setInteractive(bool interactive) {
+        m_interactive = interactive;
+    }
+    [[nodiscard]] PointSegment::planes getCurrentPlane() const {
+        return m_currentPlane;
+    }
     [[nodiscard]] int getCommandNumber() const {
         return m_commandNumber - 1;
     }
@@ -103,6 +121,7 @@ private:
 
     double m_lastSpeed{0};
     double m_traverseSpeed{300};
+    bool m_interactive{true};
     double m_lastSpindleSpeed{0};
 
     // The gcode.
@@ -452,6 +452,22 @@ QString GcodePreprocessorUtils::generateG1FromPoints(QVector3D const &start, QVe
     return sb;
 }
 
+/**
+ * Shortest fixed point text of value, trailing zeros are dropped.
+ */
+QByteArray GcodePreprocessorUtils::formatNumber(double value, int precision)
+{
+    QByteArray result = QByteArray::number(value, 'f', precision);
+
+    if (result.contains('.')) {
+        while (result.endsWith('0')) result.chop(1);
+        if (result.endsWith('.')) result.chop(1);
+    }
+    if (result == "-0") result = "0";
+
+    return result;
+}
+
 /**
 * Splits a gcode command by each word/argument, doesn't care about spaces.
 * This command is about the same speed as the string.split(" ") command,
@@ -572,6 +588,28 @@ QVector3D GcodePreprocessorUtils::convertRToCenter(QVector3D start, QVector3D en
     return center;
 }
 
+namespace
+{
+    // Arcs are generated in XY plane, ZX and YZ planes are rotated to it by 90 degrees about X and Y axes
+    QVector3D toArcPlane(PointSegment::planes plane, QVector3D const &point)
+    {
+        switch (plane) {
+        case PointSegment::ZX: return QVector3D(point.x(), -point.z(), point.y());
+        case PointSegment::YZ: return QVector3D(-point.z(), point.y(), point.x());
+        default: return point;
+        }
+    }
+
+    QVector3D fromArcPlane(PointSegment::planes plane, QVector3D const &point)
+    {
+        switch (plane) {
+        case PointSegment::ZX: return QVector3D(point.x(), point.z(), -point.y());
+        case PointSegment::YZ: return QVector3D(point.z(), point.y(), -point.x());
+        default: return point;
+        }
+    }
+}
+
 /**
 * Return the angle in radians when going from start to end.
 */
@@ -643,21 +681,9 @@ GcodePreprocessorUtils::generatePointsAlongArcBDring(PointSegment::planes plane,
     double radius = R;
 
     // Rotate vectors according to plane
-    QMatrix4x4 m;
-    m.setToIdentity();
-    switch (plane) {
-    case PointSegment::XY:
-        break;
-    case PointSegment::ZX:
-        m.rotate(90, 1.0, 0.0, 0.0);
-        break;
-    case PointSegment::YZ:
-        m.rotate(-90, 0.0, 1.0, 0.0);
-        break;
-    }
-    start = m.map(start);
-    end = m.map(end);
-    center = m.map(center);
+    start = toArcPlane(plane, start);
+    end = toArcPlane(plane, end);
+    center = toArcPlane(plane, center);
 
     // Check center
     if (qIsNaN(center.length())) return {};
@@ -703,54 +729,92 @@ GcodePreprocessorUtils::generatePointsAlongArcBDring(PointSegment::planes plane,
                                                                       double radius, double startAngle,
                                                                       double sweep, int numPoints)
 {
-    // Prepare rotation matrix to restore plane
-    QMatrix4x4 m;
-    m.setToIdentity();
-    switch (plane) {
-    case PointSegment::XY:
-        break;
-    case PointSegment::ZX:
-        m.rotate(-90, 1.0, 0.0, 0.0);
-        break;
-    case PointSegment::YZ:
-        m.rotate(90, 0.0, 1.0, 0.0);
-        break;
-    }
-
-    QVector3D lineEnd(p2.x(), p2.y(), p1.z());
     vectoContainer segments;
-    double angle;
+    if (numPoints < 1) numPoints = 1;
+    segments.reserve(numPoints);
 
     // Calculate radius if necessary.
     if (radius == 0) {
         radius = sqrt(pow((double)(p1.x() - center.x()), 2.0) + pow((double)(p1.y() - center.y()), 2.0));
     }
 
+    // Radius vector is rotated by constant step, trigonometry is evaluated once per arc
+    double const step = (isCw ? -sweep : sweep) / numPoints;
+    double const stepCos = cos(step);
+    double const stepSin = sin(step);
+    double u = cos(startAngle) * radius;
+    double v = sin(startAngle) * radius;
+
     double const zIncrement = (p2.z() - p1.z()) / numPoints;
     for (int i = 1; i < numPoints; i++)
     {
-        if (isCw) {
-            angle = (startAngle - i * sweep / numPoints);
-        } else {
-            angle = (startAngle + i * sweep / numPoints);
-        }
+        double const rotated = u * stepCos - v * stepSin;
+        v = u * stepSin + v * stepCos;
+        u = rotated;
 
-        if (angle >= M_PI * 2) {
-            angle = angle - M_PI * 2;
-        }
-
-        lineEnd.setX(cos(angle) * radius + center.x());
-        lineEnd.setY(sin(angle) * radius + center.y());
-        lineEnd.setZ(lineEnd.z() + zIncrement);
-
-        segments.push_back(m.map(lineEnd));
+        segments.push_back(fromArcPlane(plane, QVector3D(u + center.x(), v + center.y(), p1.z() + i * zIncrement)));
     }
 
-    segments.push_back(m.map(p2));
+    segments.push_back(fromArcPlane(plane, p2));
 
     return segments;
 }
 
+/**
+* Generates the points along an arc excluding the start point, chords deviate from arc by deviation at most.
+*/
+GcodePreprocessorUtils::vectoContainer
+GcodePreprocessorUtils::generatePointsAlongArcByDeviation(PointSegment::planes plane, QVector3D start, QVector3D end,
+                                                          QVector3D center, bool clockwise, double deviation)
+{
+    start = toArcPlane(plane, start);
+    end = toArcPlane(plane, end);
+    center = toArcPlane(plane, center);
+
+    if (qIsNaN(center.length())) return {};
+
+    double const radius = hypot(start.x() - center.x(), start.y() - center.y());
+    double const startAngle = getAngle(center, start);
+    double const sweep = calculateSweep(startAngle, getAngle(center, end), clockwise);
+
+    // Chord angle by sagitta, arcs smaller than deviation get quarter circle chords
+    double const maxStep = deviation > 0 && deviation < radius ? 2 * acos(1 - deviation / radius) : M_PI / 2;
+    int const numPoints = static_cast<int>(qBound(1.0, ceil(sweep / qMin(maxStep, M_PI / 2)), 65536.0));
+
+    return generatePointsAlongArcBDring(plane, start, end, center, clockwise, radius, startAngle, sweep, numPoints);
+}
+
+/**
+* Return the points where an arc reaches its axis extremes, start and end points are not included.
+*/
+GcodePreprocessorUtils::vectoContainer
+GcodePreprocessorUtils::getArcExtremePoints(PointSegment::planes plane, QVector3D start, QVector3D end,
+                                            QVector3D center, bool clockwise)
+{
+    start = toArcPlane(plane, start);
+    end = toArcPlane(plane, end);
+    center = toArcPlane(plane, center);
+
+    if (qIsNaN(center.length())) return {};
+
+    double const radius = hypot(start.x() - center.x(), start.y() - center.y());
+    double const startAngle = getAngle(center, start);
+    double const sweep = calculateSweep(startAngle, getAngle(center, end), clockwise);
+
+    // Quadrant points passed by arc, axes of arc plane are world axes
+    vectoContainer points;
+    for (int i = 0; i < 4; i++) {
+        double const angle = M_PI / 2 * i;
+        double const offset = fmod((clockwise ? startAngle - angle : angle - startAngle) + M_PI * 4, M_PI * 2);
+        if (offset >= sweep) continue;
+
+        points.push_back(fromArcPlane(plane, QVector3D(center.x() + cos(angle) * radius, center.y() + sin(angle) * radius,
+                                                       start.z() + (end.z() - start.z()) * offset / sweep)));
+    }
+
+    return points;
+}
+
 double GcodePreprocessorUtils::AtoF(char const * num)
 {
     if (!num || !*num)
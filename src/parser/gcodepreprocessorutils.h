@@ -63,10 +63,13 @@ public:
     static QVector3D convertRToCenter(QVector3D start, QVector3D end, double radius, bool absoluteIJK, bool clockwise);
     static QVector3D updateCenterWithCommand(QByteArrayList const &commandArgs, QVector3D initial, QVector3D nextPoint, bool absoluteIJKMode, bool clockwise);
     static QString generateG1FromPoints(QVector3D const &start, QVector3D const &end, bool absoluteMode, int precision);
+    static QByteArray formatNumber(double value, int precision);
     static double getAngle(QVector3D start, QVector3D end);
     static double calculateSweep(double startAngle, double endAngle, bool isCw);
     static vectoContainer generatePointsAlongArcBDring(PointSegment::planes plane, QVector3D start, QVector3D end, QVector3D center, bool clockwise, double R, double minArcLength, double arcPrecision, bool arcDegreeMode);
     static vectoContainer generatePointsAlongArcBDring(PointSegment::planes plane, QVector3D p1, QVector3D p2, QVector3D center, bool isCw, double radius, double startAngle, double sweep, int numPoints);
+    static vectoContainer generatePointsAlongArcByDeviation(PointSegment::planes plane, QVector3D start, QVector3D end, QVector3D center, bool clockwise, double deviation);
+    static vectoContainer getArcExtremePoints(PointSegment::planes plane, QVector3D start, QVector3D end, QVector3D center, bool clockwise);
 
     constexpr static bool isDigit(char c) {
         return c > 47 && c < 58;
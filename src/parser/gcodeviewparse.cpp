@@ -6,10 +6,13 @@
 // Copyright 2015-2016 Hayrullin Denis Ravilevich
 
 #include <QDebug>
+#include <algorithm>
 #include "gcodeviewparse.h"
+#include "heightmapcompensator.h"
 
 GcodeViewParse::GcodeViewParse(QObject *parent) :
-    QObject(parent)
+    QObject(parent), m_lines(std::make_shared<LineSegment::Container>()),
+    m_arcCenters(std::make_shared<LineSegment::ArcCenters>())
 {
     absoluteMode = true;
     absoluteIJK = false;
@@ -68,14 +71,48 @@ LineSegment::Container GcodeViewParse::toObjRedux(QByteArrayList const &gcode, d
 }
 
 LineSegment::Container &GcodeViewParse::getLineSegmentList()
+{
+    return *m_lines;
+}
+
+std::shared_ptr<LineSegment::Container const> GcodeViewParse::sharedLines() const
 {
     return m_lines;
 }
 
+LineSegment::ArcCenters const &GcodeViewParse::arcCenters() const
+{
+    return *m_arcCenters;
+}
+
+std::shared_ptr<LineSegment::ArcCenters const> GcodeViewParse::sharedArcCenters() const
+{
+    return m_arcCenters;
+}
+
+QVector3D GcodeViewParse::arcCenter(int segment) const
+{
+    auto const arc = std::lower_bound(m_arcCenters->begin(), m_arcCenters->end(), segment,
+                                      [](LineSegment::ArcCenter const &arc, int segment) { return arc.segment < segment; });
+
+    return arc != m_arcCenters->end() && arc->segment == segment ? arc->center : QVector3D(qQNaN(), qQNaN(), qQNaN());
+}
+
+void GcodeViewParse::detachLines()
+{
+    // Shared lists are kept unchanged for their readers
+    if (m_lines.use_count() > 1) m_lines = std::make_shared<LineSegment::Container>(*m_lines);
+    if (m_arcCenters.use_count() > 1) m_arcCenters = std::make_shared<LineSegment::ArcCenters>(*m_arcCenters);
+}
+
 void GcodeViewParse::reset()
 {
-    m_lines.clear();
+    if (m_lines.use_count() > 1) m_lines = std::make_shared<LineSegment::Container>();
+    else m_lines->clear();
+    if (m_arcCenters.use_count() > 1) m_arcCenters = std::make_shared<LineSegment::ArcCenters>();
+    else m_arcCenters->clear();
     m_lineIndexes.clear();
+    m_timeIndex.clear();
     currentLine = 0;
     m_min = QVector3D(qQNaN(), qQNaN(), qQNaN());
     m_max = QVector3D(qQNaN(), qQNaN(), qQNaN());
@@ -92,8 +129,10 @@ QSize GcodeViewParse::getResolution() const
     return QSize(((m_max.x() - m_min.x()) / m_minLength) + 1, ((m_max.y() - m_min.y()) / m_minLength) + 1);
 }
 
-LineSegment::Container GcodeViewParse::getLinesFromParser(GcodeParser *gp, double arcPrecision, bool arcDegreeMode)
+LineSegment::Container &GcodeViewParse::getLinesFromParser(GcodeParser *gp, double arcPrecision, bool arcDegreeMode)
 {
+    detachLines();
+
     auto &psl = gp->getPointSegmentList();
     // For a line segment list ALL arcs must be converted to lines.
     double minArcLength = 0.1;
@@ -103,6 +142,7 @@ LineSegment::Container GcodeViewParse::getLinesFromParser(GcodeParser *gp, doubl
 
     // Prepare segments indexes
     m_lineIndexes.resize(psl.size());
+    m_arcCache.startPass();
 
     int lineIndex = 0;
     for (auto &ps : psl) {
@@ -113,43 +153,117 @@ LineSegment::Container GcodeViewParse::getLinesFromParser(GcodeParser *gp, doubl
 
         // start is null for the first iteration.
         if (start != NULL) {
+            // Keep arc as is, drawer tessellates it by view
+            if (ps.isArc() && m_analyticArcs && !m_subdivisionStep.isValid()) {
+                if (!qIsNaN(ps.center().length())) {
+                    addArc(*start, *end, lineIndex++, ps, isMetric);
+                }
             // Expand arc for graphics.
-            if (ps.isArc()) {
-                auto const points =
-                    GcodePreprocessorUtils::generatePointsAlongArcBDring(ps.plane(),
-                    *start, *end, ps.center(), ps.isClockwise(), ps.getRadius(), minArcLength, arcPrecision, arcDegreeMode);
+            } else if (ps.isArc()) {
+                auto const &points = m_arcCache.points(ps.plane(), *start, *end, ps.center(), ps.isClockwise(),
+                                                       ps.getRadius(), minArcLength, arcPrecision, arcDegreeMode);
                 // Create line segments from points.
                 if (!points.empty()) {
                     QVector3D startPoint = *start;
                     for (auto const &nextPoint : points) {
                         if (nextPoint == startPoint) continue;
-                       m_lines.emplace_back(startPoint, nextPoint, lineIndex, ps, isMetric);
-                        this->testExtremes(nextPoint);
-                        m_lineIndexes[ps.getLineNumber()].push_back(m_lines.size() - 1);
+                        addSegment(startPoint, nextPoint, lineIndex, ps, isMetric);
                         startPoint = nextPoint;
                     }
                     lineIndex++;
                 }
             // Line
             } else {
-                m_lines.emplace_back(*start, *end, lineIndex++, ps, isMetric);
-                this->testExtremes(*end);
-                this->testLength(*start, *end);
-                m_lineIndexes[ps.getLineNumber()].push_back(m_lines.size() - 1);
+                addSegment(*start, *end, lineIndex++, ps, isMetric);
             }
         }
         start = end;
     }
+    m_arcCache.finishPass();
 
-    return m_lines;
+    return *m_lines;
+}
+
+void GcodeViewParse::addArc(const QVector3D &start, const QVector3D &end, int lineIndex, PointSegment const &ps, bool isMetric)
+{
+    m_lines->emplace_back(start, end, lineIndex, ps, isMetric);
+    m_lines->back().setIsAnalyticArc(true);
+    m_arcCenters->push_back({static_cast<int>(m_lines->size()) - 1, ps.center()});
+    m_lineIndexes[ps.getLineNumber()].push_back(m_lines->size() - 1);
+
+    // Arc bulge is counted in extremes
+    this->testExtremes(end);
+    for (auto const &point : GcodePreprocessorUtils::getArcExtremePoints(ps.plane(), start, end, ps.center(),
+                                                                         ps.isClockwise())) {
+        this->testExtremes(point);
+    }
+}
+
+void GcodeViewParse::addSegment(const QVector3D &start, const QVector3D &end, int lineIndex, PointSegment const &ps, bool isMetric)
+{
+    if (!m_subdivisionStep.isValid()) {
+        m_lines->emplace_back(start, end, lineIndex, ps, isMetric);
+        this->testExtremes(end);
+        if (!ps.isArc()) this->testLength(start, end);
+        m_lineIndexes[ps.getLineNumber()].push_back(m_lines->size() - 1);
+        return;
+    }
+
+    // Subdivided same way as program commands are on heightmap compensation, Z offset is applied by drawer
+    m_subdividedPoints.clear();
+    HeightMapCompensator::subdivide(start, end, m_subdivisionStep, m_subdividedPoints);
+
+    QVector3D segmentStart = start;
+    for (auto const &segmentEnd : m_subdividedPoints) {
+        m_lines->emplace_back(segmentStart, segmentEnd, lineIndex, ps, isMetric);
+        this->testExtremes(segmentEnd);
+        if (!ps.isArc()) this->testLength(segmentStart, segmentEnd);
+        m_lineIndexes[ps.getLineNumber()].push_back(m_lines->size() - 1);
+        segmentStart = segmentEnd;
+    }
 }
 
 LineSegment::Container & GcodeViewParse::getLines()
 {
-    return m_lines;
+    return *m_lines;
 }
 
 indexVector &GcodeViewParse::getLinesIndexes()
 {
     return m_lineIndexes;
 }
+
+QSizeF GcodeViewParse::subdivisionStep() const
+{
+    return m_subdivisionStep;
+}
+
+void GcodeViewParse::setSubdivisionStep(QSizeF const &step)
+{
+    m_subdivisionStep = step;
+}
+
+ArcTessellationCache const &GcodeViewParse::arcCache() const
+{
+    return m_arcCache;
+}
+
+bool GcodeViewParse::analyticArcs() const
+{
+    return m_analyticArcs;
+}
+
+void GcodeViewParse::setAnalyticArcs(bool analyticArcs)
+{
+    m_analyticArcs = analyticArcs;
+}
+
+ProgramTimeIndex const &GcodeViewParse::timeIndex() const
+{
+    return m_timeIndex;
+}
+
+void GcodeViewParse::setTimeIndex(ProgramTimeIndex timeIndex)
+{
+    m_timeIndex = std::move(timeIndex);
+}
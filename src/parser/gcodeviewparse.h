@@ -11,8 +11,12 @@
 #include <QObject>
 #include <QVector3D>
 #include <QVector2D>
+#include <QSizeF>
+#include <memory>
+#include "arctessellationcache.h"
 #include "linesegment.h"
 #include "gcodeparser.h"
+#include "programtimeindex.h"
 #include "utils/util.h"
 
 #ifdef USE_STD_CONTAINERS
@@ -37,11 +41,35 @@ public:
     QSize getResolution() const;
     LineSegment::Container toObjRedux(QByteArrayList const &gcode, double arcPrecision, bool arcDegreeMode);
     LineSegment::Container &getLineSegmentList();
-    LineSegment::Container getLinesFromParser(GcodeParser *gp, double arcPrecision, bool arcDegreeMode);
+    LineSegment::Container &getLinesFromParser(GcodeParser *gp, double arcPrecision, bool arcDegreeMode);
 
     LineSegment::Container & getLines();
+    /// \brief parsed segments shared with worker threads without copying
+    /// List isn't changed in place while shared, next parse starts new one. Only drawing state
+    /// of segments is updated, which shared list readers must not use.
+    std::shared_ptr<LineSegment::Container const> sharedLines() const;
+
+    /// \brief centres of analytic arc segments, shared same way as segments
+    LineSegment::ArcCenters const &arcCenters() const;
+    std::shared_ptr<LineSegment::ArcCenters const> sharedArcCenters() const;
+    /// \brief centre of analytic arc segment, NaN if segment isn't analytic arc
+    QVector3D arcCenter(int segment) const;
     indexVector &getLinesIndexes();
 
+    /// \brief segments are subdivided by heightmap interpolation step, empty - not subdivided
+    QSizeF subdivisionStep() const;
+    void setSubdivisionStep(QSizeF const &step);
+
+    ArcTessellationCache const &arcCache() const;
+
+    /// \brief arcs are kept as single analytic segments and tessellated by drawer, unless segments are subdivided
+    bool analyticArcs() const;
+    void setAnalyticArcs(bool analyticArcs);
+
+    /// \brief estimated time of parsed lines, filled by time estimation
+    ProgramTimeIndex const &timeIndex() const;
+    void setTimeIndex(ProgramTimeIndex timeIndex);
+
     void reset();
 
 signals:
@@ -53,8 +81,14 @@ private:
     // Parsed object
     QVector3D m_min, m_max;
     double m_minLength;
-    LineSegment::Container m_lines;
+    std::shared_ptr<LineSegment::Container> m_lines;
+    std::shared_ptr<LineSegment::ArcCenters> m_arcCenters;
     indexVector m_lineIndexes;
+    QSizeF m_subdivisionStep;
+    std::vector<QVector3D> m_subdividedPoints;
+    ArcTessellationCache m_arcCache;    // Kept on reset, arcs of unchanged program lines are not regenerated
+    bool m_analyticArcs = false;
+    ProgramTimeIndex m_timeIndex;
 
     // Parsing state.
     QVector3D lastPoint;
@@ -65,9 +99,12 @@ private:
 
     // Debug
     bool debug;
+    void detachLines();
     void testExtremes(QVector3D p3d);
     void testExtremes(double x, double y, double z);
     void testLength(const QVector3D &start, const QVector3D &end);
+    void addSegment(const QVector3D &start, const QVector3D &end, int lineIndex, PointSegment const &ps, bool isMetric);
+    void addArc(const QVector3D &start, const QVector3D &end, int lineIndex, PointSegment const &ps, bool isMetric);
 };
 
 #endif // GCODEVIEWPARSE_H
@@ -0,0 +1,679 @@
+// This file is a part of "Candle" application.
+// Copyright 2015-2016 Hayrullin Denis Ravilevich
+
+#include <QObject>
+#include <algorithm>
+#include <cmath>
+#include "grblchecker.h"
+
+namespace
+{
+    // GRBL 1.1 defaults
+    constexpr int lineBufferSize = 80;
+    constexpr double maxLineNumber = 10000000;
+    constexpr int maxToolNumber = 255;
+    constexpr int coordinateSystems = 6;
+    constexpr double mmPerInch = 25.4;
+    constexpr double arcAngularTravelEpsilon = 5e-7;
+
+    // Status codes
+    enum {
+        ExpectedCommandLetter = 1,
+        BadNumberFormat = 2,
+        NegativeValue = 4,
+        Overflow = 11,
+        UnsupportedCommand = 20,
+        ModalGroupViolation = 21,
+        UndefinedFeedRate = 22,
+        CommandValueNotInteger = 23,
+        AxisCommandConflict = 24,
+        WordRepeated = 25,
+        NoAxisWords = 26,
+        InvalidLineNumber = 27,
+        ValueWordMissing = 28,
+        UnsupportedCoordinateSystem = 29,
+        G53InvalidMotionMode = 30,
+        AxisWordsExist = 31,
+        NoAxisWordsInPlane = 32,
+        InvalidTarget = 33,
+        ArcRadiusError = 34,
+        NoOffsetsInPlane = 35,
+        UnusedWords = 36,
+        G43DynamicAxisError = 37,
+        MaxValueExceeded = 38,
+        SoftLimitAlarm = 2
+    };
+
+    enum { Seek, Linear, Cw, Ccw, Probe, MotionNone };
+    enum { Dwell, SetCoordinateData, GoHome0, SetHome0, GoHome1, SetHome1, AbsoluteOverride, SetCoordinateOffset, ResetCoordinateOffset };
+    enum { AxisCommandNone, AxisCommandNonModal, AxisCommandMotion, AxisCommandToolLength };
+    enum { PlaneXY, PlaneZX, PlaneYZ };
+
+    // Modal groups
+    enum { GroupG0, GroupG1, GroupG2, GroupG3, GroupG4, GroupG5, GroupG6, GroupG7, GroupG8, GroupG12, GroupG13,
+           GroupM4, GroupM7, GroupM8 };
+
+    double power10(int exponent)
+    {
+        static double const table[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14,
+                                         1e15, 1e16, 1e17, 1e18 };
+        if (exponent >= 0 && exponent <= 18) return table[exponent];
+        if (exponent < 0 && exponent >= -18) return 1 / table[-exponent];
+        return pow(10, exponent);
+    }
+
+    // Number as GRBL's read_float accepts it: sign, digits and single decimal point, no exponent
+    bool readFloat(char const *buffer, int length, int &i, float &value)
+    {
+        bool negative = false;
+        if (i < length && (buffer[i] == '-' || buffer[i] == '+')) negative = buffer[i++] == '-';
+
+        long long mantissa = 0;
+        int exponent = 0;
+        int digits = 0;
+        bool decimal = false;
+        for (; i < length; i++) {
+            char const c = buffer[i];
+            if (c >= '0' && c <= '9') {
+                if (++digits <= 18) {
+                    mantissa = mantissa * 10 + (c - '0');
+                    if (decimal) exponent--;
+                } else if (!decimal) {
+                    exponent++;
+                }
+            } else if (c == '.' && !decimal) {
+                decimal = true;
+            } else {
+                break;
+            }
+        }
+        if (digits == 0) return false;
+
+        value = static_cast<float>(mantissa * power10(exponent));
+        if (negative) value = -value;
+
+        return true;
+    }
+
+    void planeAxes(int plane, int &axis0, int &axis1)
+    {
+        switch (plane) {
+        case PlaneZX: axis0 = 2; axis1 = 0; break;
+        case PlaneYZ: axis0 = 1; axis1 = 2; break;
+        default: axis0 = 0; axis1 = 1; break;
+        }
+    }
+}
+
+void GrblChecker::setStartPosition(QVector3D const &machinePosition, QVector3D const &workOffset)
+{
+    m_startPosition = machinePosition;
+    m_workOffset = workOffset;
+}
+
+void GrblChecker::setSoftLimits(bool enabled, QVector3D const &maxTravel)
+{
+    m_softLimits = enabled;
+    m_maxTravel = maxTravel;
+}
+
+QByteArray GrblChecker::response(Error const &error)
+{
+    return (error.isAlarm ? "ALARM:" : "error:") + QByteArray::number(error.code);
+}
+
+QString GrblChecker::message(Error const &error)
+{
+    if (error.isAlarm) return error.code == SoftLimitAlarm ? QObject::tr("Soft limit") : QString();
+
+    switch (error.code) {
+    case ExpectedCommandLetter: return QObject::tr("Expected command letter");
+    case BadNumberFormat: return QObject::tr("Bad number format");
+    case NegativeValue: return QObject::tr("Negative value");
+    case Overflow: return QObject::tr("Line overflow");
+    case UnsupportedCommand: return QObject::tr("Unsupported command");
+    case ModalGroupViolation: return QObject::tr("Modal group violation");
+    case UndefinedFeedRate: return QObject::tr("Undefined feed rate");
+    case CommandValueNotInteger: return QObject::tr("Invalid gcode ID:23");
+    case AxisCommandConflict: return QObject::tr("Invalid gcode ID:24");
+    case WordRepeated: return QObject::tr("Invalid gcode ID:25");
+    case NoAxisWords: return QObject::tr("Invalid gcode ID:26");
+    case InvalidLineNumber: return QObject::tr("Invalid gcode ID:27");
+    case ValueWordMissing: return QObject::tr("Invalid gcode ID:28");
+    case UnsupportedCoordinateSystem: return QObject::tr("Invalid gcode ID:29");
+    case G53InvalidMotionMode: return QObject::tr("Invalid gcode ID:30");
+    case AxisWordsExist: return QObject::tr("Invalid gcode ID:31");
+    case NoAxisWordsInPlane: return QObject::tr("Invalid gcode ID:32");
+    case InvalidTarget: return QObject::tr("Invalid gcode ID:33");
+    case ArcRadiusError: return QObject::tr("Invalid gcode ID:34");
+    case NoOffsetsInPlane: return QObject::tr("Invalid gcode ID:35");
+    case UnusedWords: return QObject::tr("Invalid gcode ID:36");
+    case G43DynamicAxisError: return QObject::tr("Invalid gcode ID:37");
+    case MaxValueExceeded: return QObject::tr("Invalid gcode ID:38");
+    default: return QString();
+    }
+}
+
+bool GrblChecker::check(int count, std::function<QByteArray const &(int)> const &line, Parallel::Progress *progress)
+{
+    m_errors.clear();
+
+    // Power-on modal state
+    State state{};
+    state.motion = Seek;
+    state.plane = PlaneXY;
+    bool const startKnown = !qIsNaN(m_startPosition.length());
+    for (int i = 0; i < 3; i++) {
+        state.position[i] = m_startPosition[i];
+        state.positionKnown[i] = startKnown;
+        for (int j = 0; j < coordinateSystems; j++) state.wcsOffsets[j][i] = m_workOffset[i];
+    }
+    state.wcsKnown[0] = startKnown;
+
+    // Parse window in parallel, then validate it in order
+    int const window = Parallel::threadCount() * 65536;
+    std::vector<Block> blocks(std::min(count, window));
+
+    for (int first = 0; first < count; first += window) {
+        int const last = std::min(count, first + window);
+        int const chunks = Parallel::chunkCount(last - first, 4096);
+        std::vector<int> const bounds = Parallel::splitRange(first, last, chunks);
+
+        Parallel::forEachChunk(chunks, [&](int chunk) {
+            for (int i = bounds[chunk]; i < bounds[chunk + 1]; i++) parse(line(i), blocks[i - first]);
+        });
+
+        for (int i = first; i < last; i++) {
+            bool isAlarm = false;
+            int const code = execute(blocks[i - first], state, isAlarm);
+            if (code == 0) continue;
+
+            m_errors.push_back({ i, code, isAlarm });
+            if (isAlarm) return true;
+        }
+
+        if (progress) {
+            progress->done = last;
+            if (progress->cancelled) return false;
+        }
+    }
+
+    return true;
+}
+
+void GrblChecker::parse(QByteArray const &line, Block &block)
+{
+    block = Block{};
+    block.motion = -1;
+    block.nonModal = -1;
+    block.plane = -1;
+    block.distance = -1;
+    block.feedMode = -1;
+    block.units = -1;
+    block.wcs = -1;
+    block.toolLength = -1;
+
+    // Clean line as protocol does
+    char buffer[lineBufferSize];
+    int length = 0;
+    bool comment = false;
+    for (unsigned char const c : line) {
+        if (comment) {
+            if (c == ')') comment = false;
+        } else if (c <= ' ' || c == '/') {
+            continue;
+        } else if (c == '(') {
+            comment = true;
+        } else if (c == ';') {
+            break;
+        } else if (length >= lineBufferSize - 1) {
+            block.error = Overflow;
+            return;
+        } else {
+            buffer[length++] = (c >= 'a' && c <= 'z') ? c - 'a' + 'A' : c;
+        }
+    }
+
+    if (length == 0 || buffer[0] == '$') {
+        block.skip = true;
+        return;
+    }
+
+    auto const fail = [&](int code) { block.error = code; };
+    int groups = 0;
+
+    for (int i = 0; i < length;) {
+        char const letter = buffer[i++];
+        if (letter < 'A' || letter > 'Z') return fail(ExpectedCommandLetter);
+
+        float value;
+        if (!readFloat(buffer, length, i, value)) return fail(BadNumberFormat);
+
+        int const intValue = static_cast<int>(truncf(value));
+        int mantissa = static_cast<int>(lroundf(100 * (value - intValue)));
+        int group;
+
+        if (letter == 'G') {
+            switch (intValue) {
+            case 10: case 28: case 30: case 92:
+                if (mantissa == 0) {
+                    if (block.axisCommand) return fail(AxisCommandConflict);
+                    block.axisCommand = AxisCommandNonModal;
+                }
+                [[fallthrough]];
+            case 4: case 53:
+                group = GroupG0;
+                switch (intValue) {
+                case 4: block.nonModal = Dwell; break;
+                case 10: block.nonModal = SetCoordinateData; break;
+                case 53: block.nonModal = AbsoluteOverride; break;
+                default:
+                    if (mantissa != 0 && mantissa != 10) return fail(UnsupportedCommand);
+                    if (intValue == 28) block.nonModal = mantissa ? SetHome0 : GoHome0;
+                    else if (intValue == 30) block.nonModal = mantissa ? SetHome1 : GoHome1;
+                    else block.nonModal = mantissa ? ResetCoordinateOffset : SetCoordinateOffset;
+                    mantissa = 0;
+                }
+                break;
+            case 0: case 1: case 2: case 3: case 38:
+                if (block.axisCommand) return fail(AxisCommandConflict);
+                block.axisCommand = AxisCommandMotion;
+                [[fallthrough]];
+            case 80:
+                group = GroupG1;
+                if (intValue == 38) {
+                    if (mantissa != 20 && mantissa != 30 && mantissa != 40 && mantissa != 50) return fail(UnsupportedCommand);
+                    block.motion = Probe;
+                    mantissa = 0;
+                } else {
+                    block.motion = intValue == 80 ? MotionNone : intValue;
+                }
+                break;
+            case 17: case 18: case 19:
+                group = GroupG2;
+                block.plane = intValue - 17;
+                break;
+            case 90: case 91:
+                if (mantissa == 0) {
+                    group = GroupG3;
+                    block.distance = intValue == 91;
+                } else {
+                    // G91.1, arc offsets are incremental only
+                    group = GroupG4;
+                    if (mantissa != 10 || intValue == 90) return fail(UnsupportedCommand);
+                    mantissa = 0;
+                }
+                break;
+            case 93: case 94:
+                group = GroupG5;
+                block.feedMode = intValue == 93;
+                break;
+            case 20: case 21:
+                group = GroupG6;
+                block.units = intValue == 20;
+                break;
+            case 40:
+                group = GroupG7;
+                break;
+            case 43: case 49:
+                group = GroupG8;
+                if (block.axisCommand) return fail(AxisCommandConflict);
+                block.axisCommand = AxisCommandToolLength;
+                if (intValue == 49) block.toolLength = 0;
+                else if (mantissa == 10) block.toolLength = 1;
+                else return fail(UnsupportedCommand);
+                mantissa = 0;
+                break;
+            case 54: case 55: case 56: case 57: case 58: case 59:
+                group = GroupG12;
+                block.wcs = intValue - 54;
+                break;
+            case 61:
+                group = GroupG13;
+                if (mantissa != 0) return fail(UnsupportedCommand);
+                break;
+            default:
+                return fail(UnsupportedCommand);
+            }
+
+            if (mantissa > 0) return fail(CommandValueNotInteger);
+            if (groups & (1 << group)) return fail(ModalGroupViolation);
+            groups |= 1 << group;
+        } else if (letter == 'M') {
+            if (mantissa > 0) return fail(CommandValueNotInteger);
+
+            switch (intValue) {
+            case 0: case 1: case 2: case 30:
+                group = GroupM4;
+                block.programEnd = intValue == 2 || intValue == 30;
+                break;
+            case 3: case 4: case 5:
+                group = GroupM7;
+                break;
+            case 8: case 9:         // M7 is disabled in default build
+                group = GroupM8;
+                break;
+            default:
+                return fail(UnsupportedCommand);
+            }
+
+            if (groups & (1 << group)) return fail(ModalGroupViolation);
+            groups |= 1 << group;
+        } else {
+            int word;
+            switch (letter) {
+            case 'F': word = F; break;
+            case 'I': word = I; break;
+            case 'J': word = J; break;
+            case 'K': word = K; break;
+            case 'L': word = L; value = intValue; break;
+            case 'N': word = N; value = intValue; break;
+            case 'P': word = P; break;
+            case 'R': word = R; break;
+            case 'S': word = S; break;
+            case 'T':
+                word = T;
+                if (value > maxToolNumber) return fail(MaxValueExceeded);
+                break;
+            case 'X': word = X; break;
+            case 'Y': word = Y; break;
+            case 'Z': word = Z; break;
+            default: return fail(UnsupportedCommand);
+            }
+
+            if (block.words & (1 << word)) return fail(WordRepeated);
+            if (((1 << word) & ((1 << F) | (1 << N) | (1 << P) | (1 << T) | (1 << S))) && value < 0) return fail(NegativeValue);
+
+            block.words |= 1 << word;
+            block.values[word] = value;
+        }
+    }
+}
+
+int GrblChecker::execute(Block const &block, State &state, bool &isAlarm) const
+{
+    if (block.skip) return 0;
+    if (block.error) return block.error;
+
+    int words = block.words;
+    int const axisWords = (words >> X) & 7;
+    int const ijkWords = (words >> I) & 7;
+    int axisCommand = block.axisCommand;
+    if (axisWords && !axisCommand) axisCommand = AxisCommandMotion;
+
+    // Modal state after block
+    int const motion = block.motion >= 0 ? block.motion : state.motion;
+    int const plane = block.plane >= 0 ? block.plane : state.plane;
+    bool const inches = block.units >= 0 ? block.units : state.inches;
+    bool const incremental = block.distance >= 0 ? block.distance : state.incremental;
+    bool const inverseTime = block.feedMode >= 0 ? block.feedMode : state.inverseTime;
+    int const wcs = block.wcs >= 0 ? block.wcs : state.wcs;
+    double const scale = inches ? mmPerInch : 1;
+
+    if ((words & (1 << N)) && block.values[N] > maxLineNumber) return InvalidLineNumber;
+
+    // Feed rate
+    double feed = (words & (1 << F)) ? block.values[F] : 0;
+    if (inverseTime) {
+        if (axisCommand == AxisCommandMotion && motion != MotionNone && motion != Seek && !(words & (1 << F)))
+            return UndefinedFeedRate;
+    } else if (!state.inverseTime) {
+        if (words & (1 << F)) feed *= scale;
+        else feed = state.feed;
+    }
+
+    if (block.nonModal == Dwell) {
+        if (!(words & (1 << P))) return ValueWordMissing;
+        words &= ~(1 << P);
+    }
+
+    double values[3];
+    for (int i = 0; i < 3; i++) values[i] = block.values[X + i] * scale;
+
+    if (axisCommand == AxisCommandToolLength && block.toolLength == 1 && axisWords != 4) return G43DynamicAxisError;
+
+    // Non-modal commands with raw axis values
+    double const *blockOffset = state.wcsOffsets[wcs];
+    double target[3];
+    std::copy(state.position, state.position + 3, target);
+    int coordinateSelect = wcs;
+    int l = 0;
+
+    switch (block.nonModal) {
+    case SetCoordinateData:
+        if (!axisWords) return NoAxisWords;
+        if (!(words & ((1 << P) | (1 << L)))) return ValueWordMissing;
+        coordinateSelect = static_cast<int>(truncf(block.values[P]));
+        if (coordinateSelect > coordinateSystems) return UnsupportedCoordinateSystem;
+        coordinateSelect = coordinateSelect > 0 ? coordinateSelect - 1 : wcs;
+        l = static_cast<int>(block.values[L]);
+        if (l != 20 && (l != 2 || (words & (1 << R)))) return UnsupportedCommand;
+        words &= ~((1 << L) | (1 << P));
+        break;
+    case SetCoordinateOffset:
+        if (!axisWords) return NoAxisWords;
+        break;
+    default:
+        if (axisCommand != AxisCommandToolLength && axisWords) {
+            for (int i = 0; i < 3; i++) {
+                if (!(axisWords & (1 << i))) continue;
+                if (block.nonModal == AbsoluteOverride) target[i] = values[i];
+                else if (incremental) target[i] += values[i];
+                else target[i] = values[i] + blockOffset[i] + state.g92[i] + (i == 2 ? state.toolLength : 0);
+            }
+        }
+        if (block.nonModal == AbsoluteOverride && motion != Seek && motion != Linear) return G53InvalidMotionMode;
+    }
+
+    // Target is known in machine space if it's set in machine or known coordinate system
+    bool targetKnown[3];
+    for (int i = 0; i < 3; i++) {
+        bool const absolute = block.nonModal == AbsoluteOverride || !incremental;
+        targetKnown[i] = (axisWords & (1 << i)) && absolute
+                ? block.nonModal == AbsoluteOverride || state.wcsKnown[wcs] : state.positionKnown[i];
+    }
+
+    // Motion
+    int axis0, axis1;
+    planeAxes(plane, axis0, axis1);
+    double arcOffset[2] = { 0, 0 };
+    double arcTravel = 0;
+
+    if (motion == MotionNone) {
+        if (axisWords && axisCommand != AxisCommandNonModal) return AxisWordsExist;
+    } else if (axisCommand == AxisCommandMotion) {
+        if (motion == Seek) {
+            if (!axisWords) axisCommand = AxisCommandNone;
+        } else {
+            if (feed == 0) return UndefinedFeedRate;
+
+            switch (motion) {
+            case Linear:
+                if (!axisWords) axisCommand = AxisCommandNone;
+                break;
+            case Cw: case Ccw: {
+                if (!axisWords) return NoAxisWords;
+                if (!(axisWords & ((1 << axis0) | (1 << axis1)))) return NoAxisWordsInPlane;
+
+                double x = target[axis0] - state.position[axis0];
+                double y = target[axis1] - state.position[axis1];
+                bool const geometryKnown = !qIsNaN(x) && !qIsNaN(y);
+
+                if (words & (1 << R)) {
+                    words &= ~(1 << R);
+                    if (!geometryKnown) break;
+                    if (std::equal(target, target + 3, state.position)) return InvalidTarget;
+
+                    double r = block.values[R] * scale;
+                    double h = 4.0 * r * r - x * x - y * y;
+                    if (h < 0) return ArcRadiusError;
+
+                    h = -sqrt(h) / hypot(x, y);
+                    if (motion == Ccw) h = -h;
+                    if (r < 0) h = -h;
+                    arcOffset[0] = 0.5 * (x - y * h);
+                    arcOffset[1] = 0.5 * (y + x * h);
+                } else {
+                    if (!(ijkWords & ((1 << axis0) | (1 << axis1)))) return NoOffsetsInPlane;
+                    words &= ~((1 << I) | (1 << J) | (1 << K));
+                    if (!geometryKnown) break;
+
+                    arcOffset[0] = (ijkWords & (1 << axis0)) ? block.values[I + axis0] * scale : 0;
+                    arcOffset[1] = (ijkWords & (1 << axis1)) ? block.values[I + axis1] * scale : 0;
+                    x -= arcOffset[0];
+                    y -= arcOffset[1];
+                    double const targetRadius = hypot(x, y);
+                    double const radius = hypot(arcOffset[0], arcOffset[1]);
+                    double const deltaRadius = fabs(targetRadius - radius);
+                    if (deltaRadius > 0.005 && (deltaRadius > 0.5 || deltaRadius > 0.001 * radius)) return InvalidTarget;
+                }
+
+                // Angular travel as motion control computes it
+                double const r0 = -arcOffset[0];
+                double const r1 = -arcOffset[1];
+                double const t0 = target[axis0] - state.position[axis0] - arcOffset[0];
+                double const t1 = target[axis1] - state.position[axis1] - arcOffset[1];
+                arcTravel = atan2(r0 * t1 - r1 * t0, r0 * t0 + r1 * t1);
+                if (motion == Cw) {
+                    if (arcTravel >= -arcAngularTravelEpsilon) arcTravel -= 2 * M_PI;
+                } else if (arcTravel <= arcAngularTravelEpsilon) {
+                    arcTravel += 2 * M_PI;
+                }
+                break;
+            }
+            case Probe:
+                if (std::equal(target, target + 3, state.position)) return InvalidTarget;
+                break;
+            }
+        }
+    }
+
+    // Unused words
+    words &= ~((1 << N) | (1 << F) | (1 << S) | (1 << T));
+    if (axisCommand) words &= ~((1 << X) | (1 << Y) | (1 << Z));
+    if (words) return UnusedWords;
+
+    // Execute block
+    state.feed = feed;
+    state.inverseTime = inverseTime;
+    state.plane = plane;
+    state.inches = inches;
+    state.incremental = incremental;
+    state.wcs = wcs;
+    state.motion = motion;
+    if (block.toolLength >= 0) state.toolLength = block.toolLength ? values[2] : 0;
+
+    switch (block.nonModal) {
+    case SetCoordinateData: {
+        bool known = true;
+        for (int i = 0; i < 3; i++) {
+            if (!(axisWords & (1 << i))) {
+                known = known && state.wcsKnown[coordinateSelect];
+                continue;
+            }
+            if (l == 2) {
+                state.wcsOffsets[coordinateSelect][i] = values[i];
+            } else if (!qIsNaN(state.position[i])) {
+                state.wcsOffsets[coordinateSelect][i] = state.position[i] - state.g92[i] - values[i]
+                        - (i == 2 ? state.toolLength : 0);
+                known = known && state.positionKnown[i];
+            } else {
+                known = false;
+            }
+        }
+        state.wcsKnown[coordinateSelect] = known;
+        break;
+    }
+    case GoHome0: case GoHome1:
+        // Moves through intermediate point to stored position, which isn't known
+        if (axisCommand && m_softLimits && isOutOfTravel(target, targetKnown)) {
+            isAlarm = true;
+            return SoftLimitAlarm;
+        }
+        for (int i = 0; i < 3; i++) {
+            state.position[i] = qQNaN();
+            state.positionKnown[i] = false;
+        }
+        break;
+    case SetCoordinateOffset:
+        for (int i = 0; i < 3; i++) {
+            if (!(axisWords & (1 << i))) continue;
+            double const tool = i == 2 ? state.toolLength : 0;
+            if (qIsNaN(state.position[i])) {
+                // Unknown position is defined by offset
+                state.g92[i] = 0;
+                state.position[i] = blockOffset[i] + tool + values[i];
+                state.positionKnown[i] = false;
+            } else {
+                state.g92[i] = state.position[i] - blockOffset[i] - values[i] - tool;
+            }
+        }
+        break;
+    case ResetCoordinateOffset:
+        std::fill(state.g92, state.g92 + 3, 0);
+        break;
+    }
+
+    if (axisCommand == AxisCommandMotion && motion != MotionNone && motion != Probe) {
+        if (m_softLimits) {
+            bool const outOfTravel = (motion == Cw || motion == Ccw)
+                    ? isArcOutOfTravel(state.position, target, targetKnown, arcOffset, arcTravel, axis0, axis1)
+                    : isOutOfTravel(target, targetKnown);
+            if (outOfTravel) {
+                isAlarm = true;
+                return SoftLimitAlarm;
+            }
+        }
+        std::copy(target, target + 3, state.position);
+        std::copy(targetKnown, targetKnown + 3, state.positionKnown);
+    }
+
+    // Program end restores modal defaults
+    if (block.programEnd) {
+        state.motion = Linear;
+        state.plane = PlaneXY;
+        state.incremental = false;
+        state.inverseTime = false;
+        state.wcs = 0;
+    }
+
+    return 0;
+}
+
+bool GrblChecker::isOutOfTravel(double const *position, bool const *known) const
+{
+    for (int i = 0; i < 3; i++) {
+        if (!known[i] || qIsNaN(position[i])) continue;
+        if (position[i] > 0 || position[i] < -m_maxTravel[i]) return true;
+    }
+    return false;
+}
+
+bool GrblChecker::isArcOutOfTravel(double const *start, double const *target, bool const *known,
+                                   double const *offset, double travel, int axis0, int axis1) const
+{
+    if (isOutOfTravel(target, known)) return true;
+    if (qIsNaN(start[axis0]) || qIsNaN(start[axis1]) || !known[axis0] || !known[axis1]) return false;
+
+    // Extreme points of arc in plane, linear axis is checked by ends
+    double const center0 = start[axis0] + offset[0];
+    double const center1 = start[axis1] + offset[1];
+    double const radius = hypot(offset[0], offset[1]);
+    double const startAngle = atan2(-offset[1], -offset[0]);
+
+    for (int k = 0; k < 4; k++) {
+        double const angle = k * M_PI / 2;
+        double delta = travel > 0 ? angle - startAngle : startAngle - angle;
+        delta = fmod(delta, 2 * M_PI);
+        if (delta < 0) delta += 2 * M_PI;
+        if (delta > fabs(travel)) continue;
+
+        double point[3];
+        std::copy(target, target + 3, point);
+        point[axis0] = center0 + radius * cos(angle);
+        point[axis1] = center1 + radius * sin(angle);
+        if (isOutOfTravel(point, known)) return true;
+    }
+
+    return false;
+}
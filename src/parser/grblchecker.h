@@ -0,0 +1,99 @@
+// This file is a part of "Candle" application.
+// Copyright 2015-2016 Hayrullin Denis Ravilevich
+
+#ifndef GRBLCHECKER_H
+#define GRBLCHECKER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector3D>
+#include <functional>
+#include <vector>
+
+#include "utils/parallel.h"
+
+/// \brief Offline program validation with GRBL 1.1 check mode ('$C') error semantics
+/// Lines are cleaned as GRBL protocol does, then parsed and validated as by g-code parser: unsupported words,
+/// modal group violations, missing words, arc geometry and soft limits. Parsing runs in parallel over windows
+/// of program, modal state and position are tracked sequentially over parsed blocks.
+/// Modal state starts at GRBL defaults (G0 G54 G17 G21 G90 G94), work offset is given for G54.
+class GrblChecker
+{
+public:
+    struct Error
+    {
+        int line;           // Program line index
+        int code;           // GRBL error code, alarm code if isAlarm
+        bool isAlarm;
+    };
+
+    GrblChecker() = default;
+
+    /// \brief machine position at program start, NaN - unknown
+    void setStartPosition(QVector3D const &machinePosition, QVector3D const &workOffset);
+    /// \brief soft limits ($20, $130-$132), travel is in mm, machine space is [-maxTravel, 0]
+    void setSoftLimits(bool enabled, QVector3D const &maxTravel);
+
+    /// \brief validate lines, check stops at first alarm as controller does
+    /// \return false if cancelled
+    bool check(int count, std::function<QByteArray const &(int)> const &line, Parallel::Progress *progress = nullptr);
+
+    [[nodiscard]] std::vector<Error> const &errors() const { return m_errors; }
+
+    /// \brief controller response for line: "ok", "error:N" or "ALARM:N"
+    static QByteArray response(Error const &error);
+    static QString message(Error const &error);
+
+private:
+    enum Word { F, I, J, K, L, N, P, R, S, T, X, Y, Z, WordCount };
+
+    struct Block
+    {
+        quint8 error;
+        bool skip;                  // System command or empty line
+        bool programEnd;            // M2, M30
+        qint8 motion;
+        qint8 nonModal;
+        qint8 axisCommand;
+        qint8 plane;
+        qint8 distance;
+        qint8 feedMode;
+        qint8 units;
+        qint8 wcs;
+        qint8 toolLength;
+        quint16 words;
+        float values[WordCount];
+    };
+
+    struct State
+    {
+        int motion;
+        int plane;
+        bool inches;
+        bool incremental;
+        bool inverseTime;
+        int wcs;
+        double feed;
+        double position[3];         // Machine coordinates, NaN - unknown
+        bool positionKnown[3];      // Position isn't based on assumed offset
+        double wcsOffsets[6][3];
+        bool wcsKnown[6];           // Offset is set by program or start, not assumed
+        double g92[3];
+        double toolLength;
+    };
+
+    QVector3D m_startPosition = QVector3D(qQNaN(), qQNaN(), qQNaN());
+    QVector3D m_workOffset;
+    bool m_softLimits = false;
+    QVector3D m_maxTravel;
+    std::vector<Error> m_errors;
+
+    static void parse(QByteArray const &line, Block &block);
+    /// \return error or alarm code, 0 - ok
+    int execute(Block const &block, State &state, bool &isAlarm) const;
+    [[nodiscard]] bool isOutOfTravel(double const *position, bool const *known) const;
+    [[nodiscard]] bool isArcOutOfTravel(double const *start, double const *target, bool const *known,
+                                        double const *offset, double travel, int axis0, int axis1) const;
+};
+
+#endif // GRBLCHECKER_H
@@ -0,0 +1,258 @@
+// This file is a part of "Candle" application.
+// Copyright 2015-2016 Hayrullin Denis Ravilevich
+
+#include "heightmapcompensator.h"
+
+#include <QVector2D>
+#include <cmath>
+#include <utility>
+
+HeightMapCompensator::HeightMapCompensator()
+{
+    reset();
+}
+
+HeightMapCompensator::HeightMapCompensator(HeightMapCompensator const &other)
+    : m_surface(other.m_surface), m_step(other.m_step), m_tolerance(other.m_tolerance),
+      m_arcPrecision(other.m_arcPrecision), m_arcDegreeMode(other.m_arcDegreeMode),
+      m_parser(std::make_unique<GcodeParser>(*other.m_parser)), m_lastPoint(other.m_lastPoint),
+      m_lastCompensated(other.m_lastCompensated), m_hasLastCode(other.m_hasLastCode)
+{
+}
+
+void HeightMapCompensator::setArcPrecision(double arcPrecision, bool arcDegreeMode)
+{
+    m_arcPrecision = arcPrecision;
+    m_arcDegreeMode = arcDegreeMode;
+}
+
+QVector3D HeightMapCompensator::map(QVector3D const &point) const
+{
+    if (!m_surface) return point;
+
+    return QVector3D(point.x(), point.y(), point.z() + m_surface->evaluate(point.x(), point.y()));
+}
+
+int HeightMapCompensator::subdivide(QVector3D const &start, QVector3D const &end, QSizeF const &step, std::vector<QVector3D> &points)
+{
+    QVector3D const vec = end - start;
+    double const vecLength = vec.length();
+    int count = 0;
+    QVector3D point = start;
+
+    // Split by grid step along the axis crossing more interpolation cells
+    if (!qIsNaN(vecLength) && step.width() > 0 && step.height() > 0) {
+        double length;
+        if (fabs(vec.x()) / fabs(vec.y()) < step.width() / step.height()) length = step.height() / (vec.y() / vecLength);
+        else length = step.width() / (vec.x() / vecLength);
+
+        length = fabs(length);
+
+        if (!qIsNaN(length)) {
+            QVector3D const seg = vec.normalized() * length;
+            count = trunc(vecLength / length);
+
+            for (int i = 0; i < count; i++) {
+                point += seg;
+                points.push_back(point);
+            }
+        }
+    }
+
+    if (count == 0 || point != end) {
+        points.push_back(end);
+        count++;
+    }
+
+    return count;
+}
+
+int HeightMapCompensator::map(QVector3D const &start, QVector3D const &end, std::vector<QVector3D> &points) const
+{
+    std::size_t const first = points.size();
+    subdivide(start, end, m_step, points);
+
+    for (std::size_t i = first; i < points.size(); i++) points[i] = map(points[i]);
+
+    if (m_tolerance > 0 && points.size() - first > 1) simplify(map(start), points, first);
+
+    return static_cast<int>(points.size() - first);
+}
+
+void HeightMapCompensator::simplify(QVector3D const &start, std::vector<QVector3D> &points, std::size_t first) const
+{
+    // Chord points: start and subdivided points, last one is move end
+    int const count = static_cast<int>(points.size() - first) + 1;
+    auto const point = [&](int i) -> QVector3D const & { return i == 0 ? start : points[first + i - 1]; };
+
+    m_keep.assign(count, 0);
+    m_keep[0] = 1;
+    m_keep[count - 1] = 1;
+
+    // Douglas-Peucker by Z deviation, subdivided points lie on move in XY, so chord parameter is XY distance
+    std::vector<std::pair<int, int>> ranges{{0, count - 1}};
+    while (!ranges.empty()) {
+        auto const [i, j] = ranges.back();
+        ranges.pop_back();
+
+        QVector3D const &a = point(i);
+        QVector3D const &b = point(j);
+        double const length = QVector2D(b - a).length();
+        if (length == 0) continue;
+
+        double maxDeviation = m_tolerance;
+        int farthest = -1;
+        for (int k = i + 1; k < j; k++) {
+            QVector3D const &p = point(k);
+            double const t = QVector2D(p - a).length() / length;
+            double const deviation = fabs(p.z() - (a.z() + t * (b.z() - a.z())));
+            if (deviation > maxDeviation) {
+                maxDeviation = deviation;
+                farthest = k;
+            }
+        }
+
+        if (farthest > 0) {
+            m_keep[farthest] = 1;
+            ranges.emplace_back(i, farthest);
+            ranges.emplace_back(farthest, j);
+        }
+    }
+
+    // Compact kept points in place
+    std::size_t out = first;
+    for (int k = 1; k < count; k++) if (m_keep[k]) points[out++] = point(k);
+    points.resize(out);
+}
+
+void HeightMapCompensator::reset(QVector3D const &initialPoint)
+{
+    // Compensation runs while streaming and on worker threads, parser must not ask user
+    m_parser = std::make_unique<GcodeParser>();
+    m_parser->setInteractive(false);
+    m_parser->reset(initialPoint);
+
+    m_lastPoint = initialPoint;
+    m_lastCompensated = map(initialPoint);
+    m_hasLastCode = false;
+}
+
+int HeightMapCompensator::skip(QByteArrayList const &args)
+{
+    return process(QByteArray(), args, nullptr);
+}
+
+void HeightMapCompensator::advance(QByteArrayList const &args)
+{
+    process(QByteArray(), args, nullptr, false);
+}
+
+QByteArrayList HeightMapCompensator::compensate(QByteArray const &command, QByteArrayList const &args)
+{
+    QByteArrayList result;
+    process(command, args, &result);
+    return result;
+}
+
+int HeightMapCompensator::process(QByteArray const &command, QByteArrayList const &args, QByteArrayList *out, bool subdivide)
+{
+    // Search strings
+    static QByteArray const coords("XxYyZzIiJjKkRr");
+    static QByteArray const g("Gg");
+    static QByteArray const m("Mm");
+
+    // Arcs are expanded with same settings as view parser uses
+    double const minArcLength = 0.1;
+
+    QByteArray prefix;
+    bool isMove = false;
+    bool hasCommand = false;
+
+    // Collect non-coordinate words
+    for (auto const &arg : args) {                      // arg examples: G1, G2, M3, X100...
+        char const codeChar = arg.at(0);
+        if (coords.contains(codeChar)) continue;
+
+        if (g.contains(codeChar)) {
+            float const codeNum = GcodePreprocessorUtils::AtoF(arg.data() + 1);
+            if (codeNum == 0.0f || codeNum == 1.0f || codeNum == 2.0f || codeNum == 3.0f) isMove = true;
+
+            // Replace 'G2' & 'G3' with 'G1', drop plane command for arcs
+            if (codeNum == 2.0f || codeNum == 3.0f) prefix.append("G1");
+            else if (codeNum != 17.0f && codeNum != 18.0f && codeNum != 19.0f) prefix.append(arg);
+
+            hasCommand = true;
+        } else {
+            if (m.contains(codeChar)) hasCommand = true;
+            prefix.append(arg);
+        }
+    }
+    if (isMove) m_hasLastCode = true;
+
+    // Update modal state, only last point segment is kept by parser
+    QVector3D const start = m_lastPoint;
+    QVector3D const compensatedStart = m_lastCompensated;
+
+    m_parser->trimPointSegments();
+    int const commandNumber = m_parser->getCommandNumber();
+    m_parser->addCommand(args);
+
+    if (m_parser->getCommandNumber() == commandNumber) {
+        if (out) out->append(command);
+        return 1;
+    }
+
+    PointSegment &segment = m_parser->getPointSegmentList().back();
+    bool const isMetric = segment.isMetric();
+    segment.convertToMetric();
+
+    QVector3D const end = segment.point();
+    m_lastPoint = end;
+
+    if (qIsNaN(end.length()) || !(isMove || (!hasCommand && m_hasLastCode))) {
+        m_lastCompensated = map(end);
+        if (out) out->append(command);
+        return 1;
+    }
+
+    // Subdivided move always ends at compensated end point
+    if (!subdivide) {
+        m_lastCompensated = map(end);
+        return 0;
+    }
+
+    // Subdivide move
+    m_points.clear();
+    if (segment.isArc() && !qIsNaN(start.length())) {
+        auto const arcPoints = GcodePreprocessorUtils::generatePointsAlongArcBDring(segment.plane(),
+            start, end, segment.center(), segment.isClockwise(), segment.getRadius(), minArcLength, m_arcPrecision, m_arcDegreeMode);
+
+        QVector3D from = start;
+        for (auto const &point : arcPoints) {
+            if (point == from) continue;
+            map(from, point, m_points);
+            from = point;
+        }
+    }
+    if (m_points.empty()) map(start, end, m_points);
+
+    m_lastCompensated = m_points.back();
+
+    if (out == nullptr) return static_cast<int>(m_points.size());
+
+    // Create new commands for each point
+    QVector3D from = compensatedStart;
+    for (auto const &compensated : m_points) {
+        QVector3D point = compensated;
+        if (!segment.isAbsolute()) point -= from;
+        if (!isMetric) point /= 25.4;
+
+        out->append(prefix + QString("X%1Y%2Z%3")
+                    .arg(point.x(), 0, 'f', 3).arg(point.y(), 0, 'f', 3).arg(point.z(), 0, 'f', 3).toUtf8());
+
+        prefix.clear();
+        from = compensated;
+    }
+
+    return static_cast<int>(m_points.size());
+}
@@ -0,0 +1,82 @@
+// This file is a part of "Candle" application.
+// Copyright 2015-2016 Hayrullin Denis Ravilevich
+
+#ifndef HEIGHTMAPCOMPENSATOR_H
+#define HEIGHTMAPCOMPENSATOR_H
+
+#include <QByteArrayList>
+#include <QSizeF>
+#include <QString>
+#include <QVector3D>
+#include <memory>
+#include <vector>
+
+#include "gcodeparser.h"
+#include "utils/heightmapsurface.h"
+
+/// \brief Streaming heightmap compensation of g-code program
+/// Moves are subdivided by interpolation step and Z-offset by surface one command at a time,
+/// so compensated program is never stored. View parser subdivides segments same way and drawer
+/// applies surface in vertex shader, so preview matches commands sent. Surface can be replaced at any time.
+class HeightMapCompensator
+{
+public:
+    HeightMapCompensator();
+    /// \brief copy continuing program from same state
+    HeightMapCompensator(HeightMapCompensator const &other);
+    HeightMapCompensator(HeightMapCompensator &&) = default;
+    HeightMapCompensator &operator=(HeightMapCompensator &&) = default;
+
+    /// \brief surface is set and fully probed, offset over unprobed points is undefined
+    [[nodiscard]] bool isActive() const { return m_surface && m_surface->isValid() && m_surface->isComplete(); }
+    [[nodiscard]] std::shared_ptr<HeightMapSurface const> surface() const { return m_surface; }
+    void setSurface(std::shared_ptr<HeightMapSurface const> surface) { m_surface = std::move(surface); }
+    [[nodiscard]] QSizeF step() const { return m_step; }
+    void setStep(QSizeF const &step) { m_step = step; }
+    /// \brief maximum Z deviation of compensated move from surface, 0 - move is split by every grid step
+    [[nodiscard]] double tolerance() const { return m_tolerance; }
+    void setTolerance(double tolerance) { m_tolerance = tolerance; }
+    void setArcPrecision(double arcPrecision, bool arcDegreeMode);
+
+    /// \brief append points of segment subdivided by grid step, start point excluded
+    /// \return number of points appended
+    static int subdivide(QVector3D const &start, QVector3D const &end, QSizeF const &step, std::vector<QVector3D> &points);
+    /// \brief compensated copy of metric point
+    [[nodiscard]] QVector3D map(QVector3D const &point) const;
+    /// \brief append compensated points of metric segment subdivided by step, start point excluded
+    /// Points whose surface deviation from chord is within tolerance are dropped.
+    /// \return number of points appended
+    int map(QVector3D const &start, QVector3D const &end, std::vector<QVector3D> &points) const;
+
+    /// \brief restart program, modal state is set to defaults
+    void reset(QVector3D const &initialPoint = QVector3D(qQNaN(), qQNaN(), qQNaN()));
+    /// \brief update modal state by command without producing output
+    /// \return number of commands the command would be compensated to
+    int skip(QByteArrayList const &args);
+    /// \brief update modal state and position by command without subdivision, used to start from line
+    void advance(QByteArrayList const &args);
+    /// \brief compensated commands for one program command
+    /// Linear moves and arcs are replaced with G1 chain, other commands are returned unchanged.
+    QByteArrayList compensate(QByteArray const &command, QByteArrayList const &args);
+
+private:
+    std::shared_ptr<HeightMapSurface const> m_surface;
+    QSizeF m_step;
+    double m_tolerance = 0;
+    double m_arcPrecision = 0;
+    bool m_arcDegreeMode = false;
+
+    // Program state
+    std::unique_ptr<GcodeParser> m_parser;
+    QVector3D m_lastPoint = QVector3D(qQNaN(), qQNaN(), qQNaN());
+    QVector3D m_lastCompensated = QVector3D(qQNaN(), qQNaN(), qQNaN());
+    bool m_hasLastCode = false;
+    std::vector<QVector3D> m_points;
+    mutable std::vector<int> m_keep;
+
+    void simplify(QVector3D const &start, std::vector<QVector3D> &points, std::size_t first) const;
+
+    int process(QByteArray const &command, QByteArrayList const &args, QByteArrayList *out, bool subdivide = true);
+};
+
+#endif // HEIGHTMAPCOMPENSATOR_H
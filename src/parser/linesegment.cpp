@@ -6,7 +6,9 @@
 // Copyright 2015-2016 Hayrullin Denis Ravilevich
 
 #include "linesegment.h"
+#include "gcodepreprocessorutils.h"
 #include <QDebug>
+#include <cmath>
 
 
 QList<QVector3D> LineSegment::getPointArray()
@@ -29,13 +31,54 @@ QList<double> LineSegment::getPoints()
     return points;
 }
 
-bool LineSegment::contains(const QVector3D &point) const
+std::vector<QVector3D> LineSegment::arcPoints(QVector3D const &center, double deviation) const
 {
-    double delta;
-    QVector3D line = this->getEnd() - this->getStart();
-    QVector3D pt = point - this->getStart();
+    return GcodePreprocessorUtils::generatePointsAlongArcByDeviation(m_plane, m_first, m_second, center,
+                                                                     m_isClockwise, deviation);
+}
+
+bool LineSegment::contains(const QVector3D &point, QVector3D const &center) const
+{
+    double const tolerance = 0.01;
+
+    if (!m_isAnalyticArc) {
+        QVector3D line = m_second - m_first;
+        QVector3D pt = point - m_first;
+
+        double delta = (line - pt).length() - (line.length() - pt.length());
+
+        return delta < tolerance;
+    }
+
+    // Plane axes in G2/G3 rotation order, and normal axis
+    int const axis0 = m_plane == PointSegment::ZX ? 2 : m_plane == PointSegment::YZ ? 1 : 0;
+    int const axis1 = m_plane == PointSegment::ZX ? 0 : m_plane == PointSegment::YZ ? 2 : 1;
+    int const normal = 3 - axis0 - axis1;
+
+    // Point is at arc radius
+    double const radius = std::hypot(m_first[axis0] - center[axis0], m_first[axis1] - center[axis1]);
+    if (std::fabs(std::hypot(point[axis0] - center[axis0], point[axis1] - center[axis1]) - radius) >= tolerance) return false;
+
+    // Angle from start in arc direction, [0, 2pi)
+    double const startAngle = std::atan2(m_first[axis1] - center[axis1], m_first[axis0] - center[axis0]);
+    auto const angle = [&](QVector3D const &p) {
+        double const a = std::atan2(p[axis1] - center[axis1], p[axis0] - center[axis0]) - startAngle;
+        double const result = std::fmod(m_isClockwise ? -a : a, 2 * M_PI);
+        return result < 0 ? result + 2 * M_PI : result;
+    };
 
-    delta = (line - pt).length() - (line.length() - pt.length());
+    // Point is within angle span, span of arc ending at start is full circle
+    double sweep = angle(m_second);
+    if (sweep == 0) sweep = 2 * M_PI;
+    double const margin = radius > tolerance ? tolerance / radius : 2 * M_PI;
+    double offset = angle(point);
+    if (offset > sweep) {
+        if (offset <= sweep + margin) offset = sweep;
+        else if (offset >= 2 * M_PI - margin) offset = 0;
+        else return false;
+    }
 
-    return delta < 0.01;
+    // Helical arc moves along normal in proportion to angle
+    double const height = m_first[normal] + (m_second[normal] - m_first[normal]) * offset / sweep;
+    return std::fabs(point[normal] - height) < tolerance;
 }
@@ -20,6 +20,14 @@ public:
 #else
     using Container = QVector<LineSegment>;
 #endif
+    /// \brief centre of analytic arc segment, kept apart from segments, so lines don't store it
+    struct ArcCenter
+    {
+        int segment;
+        QVector3D center;
+    };
+    using ArcCenters = std::vector<ArcCenter>;     // Ascending by segment index
+
     LineSegment() = default;
     LineSegment(QVector3D a, QVector3D b, int num, PointSegment const &ps, bool isMetric) : LineSegment() {
         m_first = a;
@@ -52,6 +60,9 @@ public:
         m_isAbsolute = initial.isAbsolute();
         m_isHightlight = initial.isHightlight();
         m_vertexIndex = initial.vertexIndex();
+        m_plane = initial.plane();
+        m_isClockwise = initial.isClockwise();
+        m_isAnalyticArc = initial.isAnalyticArc();
     }
 
     ~LineSegment() = default;
@@ -77,7 +88,8 @@ public:
     void setIsFastTraverse(bool isF) { m_isFastTraverse = isF; }
     [[nodiscard]] bool isFastTraverse() const { return m_isFastTraverse; }
 
-    bool contains(const QVector3D &point) const;
+    /// \brief point lies on segment, \a center is used for analytic arc only
+    bool contains(const QVector3D &point, QVector3D const &center = QVector3D()) const;
 
     [[nodiscard]] bool drawn() const { return m_drawn; }
     void setDrawn(bool drawn) { m_drawn = drawn; }
@@ -106,6 +118,13 @@ public:
     [[nodiscard]] PointSegment::planes plane() const { return m_plane; }
     void setPlane(const PointSegment::planes &plane) { m_plane = plane; }
 
+    /// \brief whole arc from start to end, not expanded to chords, tessellated by consumer
+    [[nodiscard]] bool isAnalyticArc() const { return m_isAnalyticArc; }
+    void setIsAnalyticArc(bool isAnalyticArc) { m_isAnalyticArc = isAnalyticArc; }
+
+    /// \brief points of analytic arc excluding start, chords deviate from arc by \a deviation at most
+    [[nodiscard]] std::vector<QVector3D> arcPoints(QVector3D const &center, double deviation) const;
+
 private:
     double m_speed{};
     double m_spindleSpeed{};
@@ -130,6 +149,7 @@ private:
     bool m_isClockwise:1{false};
     bool m_isHightlight:1{false};
     bool m_drawn:1{false};
+    bool m_isAnalyticArc:1{false};
 #else
     // bit faster but use bit more memory
     bool m_isZMovement{false};
@@ -140,6 +160,7 @@ private:
     bool m_isClockwise{false};
     bool m_isHightlight{false};
     bool m_drawn{false};
+    bool m_isAnalyticArc{false};
 #endif
 };
 
@@ -0,0 +1,123 @@
+// This file is a part of "Candle" application.
+// Copyright 2015-2016 Hayrullin Denis Ravilevich
+
+#include "modalstateindex.h"
+
+#include <algorithm>
+
+#include "gcodepreprocessorutils.h"
+
+namespace
+{
+    QString gcode(int code)
+    {
+        return code % 10 ? QString("G%1.%2").arg(code / 10).arg(code % 10) : QString("G%1").arg(code / 10);
+    }
+}
+
+QStringList ModalStateIndex::State::setupCommands() const
+{
+    QStringList commands;
+
+    commands.append(QString("%1 %2").arg(gcode(wcs), gcode(plane)));
+    if (tool >= 0) commands.append(QString("T%1").arg(tool));
+    commands.append(QString("M%1 S%2").arg(spindle / 10).arg(speed));
+
+    if (!flood && !mist) commands.append("M9");
+    if (flood) commands.append("M8");
+    if (mist) commands.append("M7");
+
+    return commands;
+}
+
+QString ModalStateIndex::State::motionCommand() const
+{
+    // Arc and probing modes are replaced by linear one, probing is never resumed
+    QString const motionWord = motion == 0 ? "G0" : motion == 800 ? "G80" : "G1";
+
+    return QString("%1 %2 %3 %4 F%5").arg(gcode(units), gcode(distance), gcode(feedMode), motionWord).arg(feed);
+}
+
+QString ModalStateIndex::State::arcMotionWord() const
+{
+    return motion == 20 || motion == 30 ? gcode(motion) : QString();
+}
+
+void ModalStateIndex::addCommand(QByteArrayList const &args)
+{
+    if (m_rowCount % interval == 0) m_checkpoints.push_back(m_current);
+
+    apply(m_current, args);
+    m_rowCount++;
+}
+
+ModalStateIndex::State ModalStateIndex::state(int row, std::function<QByteArrayList const &(int)> const &args) const
+{
+    int const checkpoint = std::min(row / interval, static_cast<int>(m_checkpoints.size()) - 1);
+
+    State result = checkpoint < 0 ? State() : m_checkpoints[checkpoint];
+    for (int i = std::max(0, checkpoint) * interval; i < row; i++) apply(result, args(i));
+
+    return result;
+}
+
+void ModalStateIndex::apply(State &state, QByteArrayList const &args)
+{
+    bool programEnd = false;
+
+    for (auto const &arg : args) {
+        char const letter = GcodePreprocessorUtils::toUpper(arg.at(0));
+        double const value = arg.mid(1).toDouble();
+        int const code = qRound(value * 10);
+
+        switch (letter) {
+        case 'G':
+            switch (code) {
+            case 0: case 10: case 20: case 30: case 382: case 383: case 384: case 385: case 800:
+                state.motion = code;
+                break;
+            case 170: case 180: case 190: state.plane = code; break;
+            case 200: case 210: state.units = code; break;
+            case 900: case 910: state.distance = code; break;
+            case 930: case 940: state.feedMode = code; break;
+            case 540: case 550: case 560: case 570: case 580: case 590: state.wcs = code; break;
+            default: break;
+            }
+            break;
+        case 'M':
+            switch (code) {
+            case 30: case 40: case 50: state.spindle = code; break;
+            case 70: state.mist = true; break;
+            case 80: state.flood = true; break;
+            case 90: state.flood = state.mist = false; break;
+            case 20: case 300: programEnd = true; break;
+            default: break;
+            }
+            break;
+        case 'F': state.feed = value; break;
+        case 'S': state.speed = value; break;
+        case 'T': state.tool = qRound(value); break;
+        default: break;
+        }
+    }
+
+    // Program end is executed last in block, GRBL restores defaults, units, tool, feed and speed are kept
+    if (programEnd) {
+        state.motion = 10;
+        state.plane = 170;
+        state.distance = 900;
+        state.feedMode = 940;
+        state.wcs = 540;
+        state.spindle = 50;
+        state.flood = state.mist = false;
+    }
+}
+
+bool ModalStateIndex::hasMotionWord(QByteArrayList const &args)
+{
+    return std::any_of(args.begin(), args.end(), [](QByteArray const &arg) {
+        if (GcodePreprocessorUtils::toUpper(arg.at(0)) != 'G') return false;
+        int const code = qRound(arg.mid(1).toDouble() * 10);
+        return code == 0 || code == 10 || code == 20 || code == 30 || code == 800 || code / 10 == 38;
+    });
+}
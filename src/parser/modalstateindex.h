@@ -0,0 +1,64 @@
+// This file is a part of "Candle" application.
+// Copyright 2015-2016 Hayrullin Denis Ravilevich
+
+#ifndef MODALSTATEINDEX_H
+#define MODALSTATEINDEX_H
+
+#include <QByteArrayList>
+#include <QStringList>
+#include <functional>
+#include <vector>
+
+/// \brief Modal state of program at any row
+/// State is stored at every checkpoint while program is parsed, state before row is restored from nearest
+/// checkpoint by applying at most checkpoint interval rows.
+class ModalStateIndex
+{
+public:
+    /// \brief controller modal state, modal G-codes are multiplied by 10
+    struct State
+    {
+        int motion = 0;
+        int plane = 170;
+        int units = 210;
+        int distance = 900;
+        int feedMode = 940;
+        int wcs = 540;
+        int spindle = 50;           // M3, M4 or M5 multiplied by 10
+        bool flood = false;
+        bool mist = false;
+        double feed = 0;            // Units of program at that point
+        double speed = 0;
+        int tool = -1;              // -1 - not selected by program
+
+        /// \brief commands restoring coordinate system, plane, tool, spindle and coolant
+        [[nodiscard]] QStringList setupCommands() const;
+        /// \brief command restoring units, distance and feed modes, feed and linear motion mode
+        [[nodiscard]] QString motionCommand() const;
+        /// \brief arc motion mode can't be set without axis words, it should prefix first move
+        [[nodiscard]] QString arcMotionWord() const;
+    };
+
+    static int const interval = 1024;
+
+    void clear() { m_checkpoints.clear(); m_current = State(); m_rowCount = 0; }
+    [[nodiscard]] int rowCount() const { return m_rowCount; }
+
+    /// \brief append program row, rows must come in program order
+    void addCommand(QByteArrayList const &args);
+
+    /// \brief state before \a row is executed, rows above indexed ones are applied from last checkpoint
+    [[nodiscard]] State state(int row, std::function<QByteArrayList const &(int)> const &args) const;
+
+    /// \brief update state by command words
+    static void apply(State &state, QByteArrayList const &args);
+    /// \brief command sets motion mode
+    static bool hasMotionWord(QByteArrayList const &args);
+
+private:
+    std::vector<State> m_checkpoints;   // State before rows 0, interval, 2 * interval...
+    State m_current;
+    int m_rowCount = 0;
+};
+
+#endif // MODALSTATEINDEX_H
@@ -0,0 +1,64 @@
+// This file is a part of "Candle" application.
+// Copyright 2015-2016 Hayrullin Denis Ravilevich
+
+#ifndef PROGRAMTIMEINDEX_H
+#define PROGRAMTIMEINDEX_H
+
+#include <algorithm>
+#include <vector>
+
+/// \brief Cumulative program time per line, split by feed moves and rapids
+/// Times are estimated at 100% overrides, other override values scale feed and rapid parts,
+/// so program and remaining time are lookups.
+class ProgramTimeIndex
+{
+public:
+    void clear()
+    {
+        m_feed.clear();
+        m_rapid.clear();
+    }
+
+    [[nodiscard]] bool isEmpty() const { return m_feed.empty(); }
+    [[nodiscard]] int lineCount() const { return static_cast<int>(m_feed.size()); }
+
+    /// \brief store times from program start to end of line, lines must come in ascending order
+    /// Skipped lines have no motion and end at time of previous line.
+    void setLineEnd(int line, double feedTime, double rapidTime)
+    {
+        if (line < 0) return;
+        if (line >= lineCount()) {
+            m_feed.resize(line + 1, isEmpty() ? 0 : m_feed.back());
+            m_rapid.resize(line + 1, m_rapid.empty() ? 0 : m_rapid.back());
+        }
+        m_feed[line] = feedTime;
+        m_rapid[line] = rapidTime;
+    }
+
+    /// \brief time from program start to end of line, seconds
+    /// \param feedOverride, rapidOverride override ratios, 1 - no override
+    [[nodiscard]] double time(int line, double feedOverride = 1, double rapidOverride = 1) const
+    {
+        if (line < 0 || isEmpty()) return 0;
+        line = std::min(line, lineCount() - 1);
+        return m_feed[line] / feedOverride + m_rapid[line] / rapidOverride;
+    }
+
+    /// \brief program time, seconds
+    [[nodiscard]] double total(double feedOverride = 1, double rapidOverride = 1) const
+    {
+        return time(lineCount() - 1, feedOverride, rapidOverride);
+    }
+
+    /// \brief time left after line is completed, seconds
+    [[nodiscard]] double remaining(int line, double feedOverride = 1, double rapidOverride = 1) const
+    {
+        return total(feedOverride, rapidOverride) - time(line, feedOverride, rapidOverride);
+    }
+
+private:
+    std::vector<double> m_feed;
+    std::vector<double> m_rapid;
+};
+
+#endif // PROGRAMTIMEINDEX_H
@@ -0,0 +1,507 @@
+// This file is a part of "Candle" application.
+// Copyright 2015-2016 Hayrullin Denis Ravilevich
+
+#include "rapidoptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <utility>
+
+#include "gcodeparser.h"
+
+namespace
+{
+    double distance(QPointF const &a, QPointF const &b)
+    {
+        return std::hypot(a.x() - b.x(), a.y() - b.y());
+    }
+}
+
+bool RapidOptimizer::load(int count, std::function<QByteArray const &(int)> const &command,
+                          std::function<QByteArrayList const &(int)> const &args, Parallel::Progress *progress)
+{
+    m_lines.clear();
+    m_lines.reserve(count);
+    m_islands.clear();
+    m_order.clear();
+    m_defaultSafeZ = qQNaN();
+
+    GcodeParser parser;
+    parser.setInteractive(false);
+    int feedLine = -1;
+    qint8 motion = -1;
+
+    for (int i = 0; i < count; i++) {
+        if (progress && (i & 0xffff) == 0) {
+            if (progress->cancelled) return false;
+            progress->done = i;
+        }
+
+        Line line{command(i), QByteArray(), QVector3D(), -1, -1, false, false, true, true, true, true, false, false};
+        bool axisWords = false;
+        bool nonModalAxes = false;
+
+        // Classify words
+        for (auto const &arg : args(i)) {
+            char const letter = GcodePreprocessorUtils::toUpper(arg.at(0));
+            switch (letter) {
+            case 'G': {
+                float const code = GcodePreprocessorUtils::AtoF(arg.data() + 1);
+                if (code == 0.0f || code == 1.0f || code == 2.0f || code == 3.0f) {
+                    motion = static_cast<qint8>(code);
+                    line.hasMotion = true;
+                    if (code != 0.0f) line.travelWords = false;
+                    break;
+                }
+
+                line.travelWords = false;
+                if (code == 4.0f) break;
+
+                line.isPure = false;
+                if (code == 10.0f || code == 28.0f || code == 30.0f || code == 92.0f) nonModalAxes = true;
+                if (code == 80.0f || std::floor(code) == 38.0f) {
+                    motion = -1;
+                    line.hasMotion = true;
+                }
+                break;
+            }
+            case 'X': case 'Y': case 'Z': axisWords = true; break;
+            case 'I': case 'J': case 'K': case 'R': case 'P': line.travelWords = false; break;
+            case 'F':
+                line.feed = arg;
+                line.travelWords = false;
+                feedLine = i;
+                break;
+            case 'N': break;
+            default:
+                line.isPure = false;
+                line.travelWords = false;
+                break;
+            }
+        }
+        line.hasAxes = axisWords && !nonModalAxes;
+
+        // Update position, only last point segment is kept by parser
+        parser.trimPointSegments();
+        int const commandNumber = parser.getCommandNumber();
+        parser.addCommand(args(i));
+
+        if (parser.getCommandNumber() != commandNumber) {
+            PointSegment const &segment = parser.getPointSegmentList().back();
+            line.isMove = true;
+            line.isRapid = segment.isFastTraverse();
+            line.isAbsolute = segment.isAbsolute();
+            line.isMetric = segment.isMetric();
+
+            double const z = segment.point().z();
+            if (!line.isRapid && !qIsNaN(z) && (qIsNaN(m_defaultSafeZ) || z > m_defaultSafeZ)) m_defaultSafeZ = z;
+        }
+
+        line.end = *parser.getCurrentPoint();
+        line.feedLine = feedLine;
+        line.motion = motion;
+        m_lines.push_back(std::move(line));
+    }
+
+    return true;
+}
+
+bool RapidOptimizer::isTravel(int line, double safeZ) const
+{
+    if (line == 0) return false;
+
+    Line const &travel = m_lines[line];
+    if (!travel.isMove || !travel.isRapid || !travel.travelWords || !travel.isAbsolute) return false;
+
+    QVector3D const &start = m_lines[line - 1].end;
+    QVector3D const &end = travel.end;
+    if (qIsNaN(start.length()) || qIsNaN(end.length())) return false;
+
+    return (start.x() != end.x() || start.y() != end.y()) && start.z() >= safeZ && end.z() >= safeZ;
+}
+
+void RapidOptimizer::findIslands(double safeZ)
+{
+    m_islands.clear();
+    int const count = static_cast<int>(m_lines.size());
+
+    // Travels after last feed move belong to program end
+    int lastFeedMove = -1;
+    for (int i = 0; i < count; i++) if (m_lines[i].isMove && !m_lines[i].isRapid) lastFeedMove = i;
+
+    for (int i = 0; i < lastFeedMove; i++) {
+        if (!isTravel(i, safeZ)) continue;
+
+        Island island{};
+        island.travel = i;
+        while (i + 1 < lastFeedMove && isTravel(i + 1, safeZ)) i++;
+        island.first = i + 1;
+        island.isMetric = m_lines[i].isMetric;
+        island.entry = QPointF(m_lines[i].end.x(), m_lines[i].end.y());
+        island.entryZ = m_lines[i].end.z();
+
+        if (!m_islands.empty()) m_islands.back().last = island.travel;
+        m_islands.push_back(island);
+    }
+    if (m_islands.empty()) return;
+
+    // Last island ends with retract after last feed move, the rest is program end
+    Island &lastIsland = m_islands.back();
+    lastIsland.last = count;
+    for (int i = lastFeedMove + 1; i < count; i++) {
+        if (m_lines[i].isMove && m_lines[i].end.z() >= safeZ) {
+            lastIsland.last = i + 1;
+            break;
+        }
+    }
+
+    for (auto &island : m_islands) {
+        QVector3D const exit = island.last > island.first ? m_lines[island.last - 1].end
+                                                          : m_lines[island.first - 1].end;
+        island.exit = QPointF(exit.x(), exit.y());
+        island.exitZ = exit.z();
+        island.isMovable = island.last > island.first && island.exitZ >= safeZ;
+
+        island.consumesFeed = false;
+        for (int i = island.first; i < island.last; i++) {
+            Line const &line = m_lines[i];
+            if (!line.isPure) island.isMovable = false;
+            if (!island.consumesFeed && line.feed.isEmpty() && line.isMove && !line.isRapid
+                    && (i == island.first || m_lines[i - 1].feedLine < island.first)) island.consumesFeed = true;
+        }
+    }
+
+    // Program end starting at other position should be absolute
+    for (int i = lastIsland.last; i < count; i++) {
+        if (m_lines[i].isMove && !m_lines[i].isAbsolute) {
+            lastIsland.isMovable = false;
+            break;
+        }
+    }
+}
+
+bool RapidOptimizer::optimize(double safeZ, Parallel::Progress *progress)
+{
+    findIslands(safeZ);
+
+    int const count = static_cast<int>(m_islands.size());
+    m_order.resize(count);
+    std::iota(m_order.begin(), m_order.end(), 0);
+
+    // Groups of contiguous movable islands, fixed islands keep their places
+    for (int first = 0; first < count;) {
+        if (!m_islands[first].isMovable) {
+            first++;
+            continue;
+        }
+
+        int last = first;
+        while (last < count && m_islands[last].isMovable) last++;
+
+        QVector3D const &prologueEnd = m_lines[m_islands[first].travel - 1].end;
+        QPointF const start = first > 0 ? m_islands[first - 1].exit : QPointF(prologueEnd.x(), prologueEnd.y());
+        QPointF const end = last < count ? m_islands[last].entry : QPointF();
+
+        std::vector<int> const order = solve(first, last, start, last < count ? &end : nullptr, progress);
+        if (progress && progress->cancelled) return false;
+        std::copy(order.begin(), order.end(), m_order.begin() + first);
+
+        first = last;
+    }
+
+    measure();
+
+    return true;
+}
+
+std::vector<int> RapidOptimizer::solve(int first, int last, QPointF const &start, QPointF const *end,
+                                       Parallel::Progress *progress) const
+{
+    int const count = last - first;
+    std::vector<int> order(count);
+    std::iota(order.begin(), order.end(), 0);
+    if (count < 2) {
+        for (auto &index : order) index += first;
+        return order;
+    }
+
+    // Nodes: -1 is start, islands are [0, count), count is end
+    auto const edge = [&](int from, int to) {
+        QPointF const &point = from < 0 ? start : m_islands[first + from].exit;
+        if (to >= count) return end ? distance(point, *end) : 0.0;
+        return distance(point, m_islands[first + to].entry);
+    };
+    auto const cost = [&](std::vector<int> const &tour) {
+        double result = edge(-1, tour.front()) + edge(tour.back(), count);
+        for (int i = 1; i < count; i++) result += edge(tour[i - 1], tour[i]);
+        return result;
+    };
+
+    // Candidate lists of nearest successors and predecessors
+    int const neighbours = std::min(8, count - 1);
+    std::vector<int> successors(static_cast<std::size_t>(count) * neighbours);
+    std::vector<int> predecessors(successors.size());
+    std::vector<int> startSuccessors(neighbours);
+
+    auto const nearest = [&](int node, bool forward, std::vector<std::pair<double, int>> &buffer, int *result) {
+        buffer.clear();
+        for (int other = 0; other < count; other++) {
+            if (other != node) buffer.emplace_back(forward ? edge(node, other) : edge(other, node), other);
+        }
+        std::partial_sort(buffer.begin(), buffer.begin() + neighbours, buffer.end());
+        for (int i = 0; i < neighbours; i++) result[i] = buffer[i].second;
+    };
+
+    int const chunks = Parallel::chunkCount(count, 256);
+    std::vector<int> const bounds = Parallel::splitRange(0, count, chunks);
+    Parallel::forEachChunk(chunks, [&](int chunk) {
+        std::vector<std::pair<double, int>> buffer;
+        buffer.reserve(count);
+        for (int node = bounds[chunk]; node < bounds[chunk + 1]; node++) {
+            if (progress && progress->cancelled) return;
+            nearest(node, true, buffer, &successors[static_cast<std::size_t>(node) * neighbours]);
+            nearest(node, false, buffer, &predecessors[static_cast<std::size_t>(node) * neighbours]);
+        }
+    });
+    if (progress && progress->cancelled) return order;
+
+    {
+        std::vector<std::pair<double, int>> buffer;
+        nearest(-1, true, buffer, startSuccessors.data());
+    }
+    auto const successorsOf = [&](int node) {
+        return node < 0 ? startSuccessors.data() : &successors[static_cast<std::size_t>(node) * neighbours];
+    };
+
+    // Nearest neighbour tour, full scan when all candidates are visited
+    std::vector<int> tour;
+    tour.reserve(count);
+    std::vector<char> visited(count, 0);
+    for (int current = -1; static_cast<int>(tour.size()) < count;) {
+        int next = -1;
+        int const *candidates = successorsOf(current);
+        for (int i = 0; i < neighbours && next < 0; i++) if (!visited[candidates[i]]) next = candidates[i];
+
+        if (next < 0) {
+            double best = 0;
+            for (int other = 0; other < count; other++) {
+                if (visited[other]) continue;
+                double const length = edge(current, other);
+                if (next < 0 || length < best) {
+                    next = other;
+                    best = length;
+                }
+            }
+        }
+
+        visited[next] = 1;
+        tour.push_back(next);
+        current = next;
+    }
+
+    // Local search: Or-opt moves segments of up to 3 islands, 2-opt reverses order of islands range.
+    // Islands aren't symmetric, so reversed range cost is taken from prefix sums of backward edges.
+    std::vector<int> position(count);
+    std::vector<double> forward(count);
+    std::vector<double> backward(count);
+    auto const update = [&] {
+        for (int i = 0; i < count; i++) position[tour[i]] = i;
+        forward[0] = backward[0] = 0;
+        for (int i = 1; i < count; i++) {
+            forward[i] = forward[i - 1] + edge(tour[i - 1], tour[i]);
+            backward[i] = backward[i - 1] + edge(tour[i], tour[i - 1]);
+        }
+    };
+    auto const node = [&](int index) { return index < 0 ? -1 : (index >= count ? count : tour[index]); };
+
+    double const epsilon = 1e-6;
+    int const maxPasses = 100;
+    update();
+
+    for (int pass = 0; pass < maxPasses; pass++) {
+        if (progress && progress->cancelled) return order;
+        bool improved = false;
+
+        for (int i = 0; i < count; i++) {
+            for (int length = 1; length <= 3 && i + length <= count; length++) {
+                int const head = tour[i];
+                int const tail = tour[i + length - 1];
+                int const before = node(i - 1);
+                int const after = node(i + length);
+                double const gain = edge(before, head) + edge(tail, after) - edge(before, after);
+                if (gain <= epsilon) continue;
+
+                // Insert segment after start or after one of nearest predecessors of its head
+                int target = -2;
+                for (int k = -1; k < neighbours && target == -2; k++) {
+                    int const candidate = k < 0 ? -1 : predecessors[static_cast<std::size_t>(head) * neighbours + k];
+                    int const at = candidate < 0 ? -1 : position[candidate];
+                    if (at >= i - 1 && at < i + length) continue;
+
+                    int const next = node(at + 1);
+                    if (edge(candidate, head) + edge(tail, next) - edge(candidate, next) < gain - epsilon) target = at;
+                }
+                if (target == -2) continue;
+
+                std::vector<int> const segment(tour.begin() + i, tour.begin() + i + length);
+                tour.erase(tour.begin() + i, tour.begin() + i + length);
+                int const insertAt = target < i ? target + 1 : target + 1 - length;
+                tour.insert(tour.begin() + insertAt, segment.begin(), segment.end());
+                update();
+                improved = true;
+                break;
+            }
+        }
+
+        for (int i = 0; i < count; i++) {
+            int const before = node(i - 1);
+            int const *candidates = successorsOf(before);
+
+            for (int k = 0; k < neighbours; k++) {
+                int const j = position[candidates[k]];
+                if (j <= i) continue;
+
+                int const after = node(j + 1);
+                double const delta = edge(before, tour[j]) + edge(tour[i], after) - edge(before, tour[i]) - edge(tour[j], after)
+                        + (backward[j] - backward[i]) - (forward[j] - forward[i]);
+                if (delta < -epsilon) {
+                    std::reverse(tour.begin() + i, tour.begin() + j + 1);
+                    update();
+                    improved = true;
+                    break;
+                }
+            }
+        }
+
+        if (!improved) break;
+    }
+
+    if (cost(tour) < cost(order)) order = std::move(tour);
+    for (auto &index : order) index += first;
+
+    return order;
+}
+
+void RapidOptimizer::measure()
+{
+    m_distanceBefore = m_distanceAfter = 0;
+    m_timeBefore = m_timeAfter = 0;
+    if (m_islands.empty()) return;
+
+    QVector3D const &prologueEnd = m_lines[m_islands.front().travel - 1].end;
+    QPointF const start(prologueEnd.x(), prologueEnd.y());
+
+    auto const travels = [&](auto const &index, double &length, double &time) {
+        QPointF position = start;
+        for (int i = 0; i < static_cast<int>(m_islands.size()); i++) {
+            Island const &island = m_islands[index(i)];
+            QPointF const delta = (island.entry - position) * (island.isMetric ? 1.0 : 25.4);
+            length += std::hypot(delta.x(), delta.y());
+            time += travelTime(delta);
+            position = island.exit;
+        }
+    };
+
+    travels([](int i) { return i; }, m_distanceBefore, m_timeBefore);
+    travels([&](int i) { return m_order[i]; }, m_distanceAfter, m_timeAfter);
+}
+
+double RapidOptimizer::travelTime(QPointF const &delta) const
+{
+    double const length = std::hypot(delta.x(), delta.y());
+    if (length == 0) return 0;
+
+    // Rate and acceleration limited by axes along direction, trapezoidal or triangular profile
+    double rate = qInf();
+    double acceleration = qInf();
+    double const unit[2] = {std::fabs(delta.x()) / length, std::fabs(delta.y()) / length};
+    for (int axis = 0; axis < 2; axis++) {
+        if (unit[axis] == 0) continue;
+        rate = std::min(rate, m_machine.maxRate[axis] / 60.0 / unit[axis]);
+        acceleration = std::min(acceleration, m_machine.acceleration[axis] / unit[axis]);
+    }
+
+    double const ramps = rate * rate / acceleration;
+    return length >= ramps ? length / rate + rate / acceleration : 2 * std::sqrt(length / acceleration);
+}
+
+int RapidOptimizer::movedCount() const
+{
+    int result = 0;
+    for (int i = 0; i < static_cast<int>(m_order.size()); i++) if (m_order[i] != i) result++;
+    return result;
+}
+
+QByteArrayList RapidOptimizer::commands() const
+{
+    QByteArrayList result;
+    result.reserve(static_cast<int>(m_lines.size()));
+
+    if (m_islands.empty()) {
+        for (auto const &line : m_lines) result.append(line.command);
+        return result;
+    }
+
+    // Program start
+    int const prologueEnd = m_islands.front().travel;
+    for (int i = 0; i < prologueEnd; i++) result.append(m_lines[i].command);
+
+    QVector3D const &start = m_lines[prologueEnd - 1].end;
+    double z = start.z();
+    int feedLine = m_lines[prologueEnd - 1].feedLine;
+    qint8 motion = 0;
+
+    for (int index : m_order) {
+        Island const &island = m_islands[index];
+        int const precision = island.isMetric ? 4 : 5;
+
+        // Travel at safe Z, raise before and lower after XY move
+        QByteArray const travel = "G0X" + GcodePreprocessorUtils::formatNumber(island.entry.x(), precision)
+                + "Y" + GcodePreprocessorUtils::formatNumber(island.entry.y(), precision);
+        QByteArray const height = "G0Z" + GcodePreprocessorUtils::formatNumber(island.entryZ, precision);
+        if (island.entryZ > z) result.append(height);
+        result.append(travel);
+        if (island.entryZ < z) result.append(height);
+
+        // Restore feed island relies on
+        int const entryFeedLine = m_lines[island.first - 1].feedLine;
+        if (island.consumesFeed && entryFeedLine >= 0 && feedWord(feedLine) != feedWord(entryFeedLine)) {
+            result.append(feedWord(entryFeedLine));
+        }
+
+        for (int i = island.first; i < island.last; i++) result.append(m_lines[i].command);
+
+        z = island.exitZ;
+        feedLine = island.last > island.first ? m_lines[island.last - 1].feedLine : entryFeedLine;
+        motion = island.last > island.first ? m_lines[island.last - 1].motion : 0;
+    }
+
+    // Program end, modal motion and feed are set as they were after last island
+    int const epilogueStart = m_islands.back().last;
+    qint8 const epilogueMotion = m_lines[epilogueStart - 1].motion;
+    int const epilogueFeedLine = m_lines[epilogueStart - 1].feedLine;
+    bool restoreMotion = motion != epilogueMotion && epilogueMotion >= 0;
+    bool restoreFeed = feedWord(feedLine) != feedWord(epilogueFeedLine) && epilogueFeedLine >= 0;
+
+    for (int i = epilogueStart; i < static_cast<int>(m_lines.size()); i++) {
+        Line const &line = m_lines[i];
+
+        if (restoreFeed && (!line.feed.isEmpty() || (line.isMove && !line.isRapid))) {
+            if (line.feed.isEmpty()) result.append(feedWord(epilogueFeedLine));
+            restoreFeed = false;
+        }
+
+        if (restoreMotion && line.hasMotion) {
+            restoreMotion = false;
+        } else if (restoreMotion && line.hasAxes) {
+            result.append("G" + QByteArray::number(epilogueMotion) + line.command);
+            restoreMotion = false;
+            continue;
+        }
+
+        result.append(line.command);
+    }
+
+    return result;
+}
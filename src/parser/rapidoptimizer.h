@@ -0,0 +1,106 @@
+// This file is a part of "Candle" application.
+// Copyright 2015-2016 Hayrullin Denis Ravilevich
+
+#ifndef RAPIDOPTIMIZER_H
+#define RAPIDOPTIMIZER_H
+
+#include <QByteArrayList>
+#include <QPointF>
+#include <QVector3D>
+#include <functional>
+#include <vector>
+
+#include "timeestimator.h"
+#include "utils/parallel.h"
+
+/// \brief Reordering of independent toolpath islands to shorten rapid travel between them
+/// Island starts with rapid XY travel at or above safe Z and lasts up to next such travel. Islands having only
+/// motion, coordinate, feed and dwell words are movable, contiguous movable islands are ordered by nearest
+/// neighbour tour improved by Or-opt and 2-opt moves over nearest neighbour candidate lists, islands themselves
+/// are never reversed. Travels are regenerated as absolute G0 moves, feed is restored where island relies on
+/// modal feed. Other islands, program start and end keep their places.
+class RapidOptimizer
+{
+public:
+    RapidOptimizer() = default;
+
+    void setMachine(TimeEstimator::Machine const &machine) { m_machine = machine; }
+
+    /// \brief scan program, modal state and positions of every line are stored
+    /// \return false if cancelled
+    bool load(int count, std::function<QByteArray const &(int)> const &command,
+              std::function<QByteArrayList const &(int)> const &args, Parallel::Progress *progress = nullptr);
+    /// \brief highest Z of feed moves in program units, NaN if there are no feed moves
+    [[nodiscard]] double defaultSafeZ() const { return m_defaultSafeZ; }
+
+    /// \brief find islands by safe Z in program units and reorder them
+    /// \return false if cancelled
+    bool optimize(double safeZ, Parallel::Progress *progress = nullptr);
+
+    /// \brief program with islands in optimized order
+    [[nodiscard]] QByteArrayList commands() const;
+
+    [[nodiscard]] int islandCount() const { return static_cast<int>(m_islands.size()); }
+    [[nodiscard]] int movedCount() const;
+    /// \brief rapid travel between islands, mm
+    [[nodiscard]] double distanceBefore() const { return m_distanceBefore; }
+    [[nodiscard]] double distanceAfter() const { return m_distanceAfter; }
+    /// \brief rapid travel time between islands, seconds
+    [[nodiscard]] double timeBefore() const { return m_timeBefore; }
+    [[nodiscard]] double timeAfter() const { return m_timeAfter; }
+
+private:
+    struct Line
+    {
+        QByteArray command;
+        QByteArray feed;        // F word of line
+        QVector3D end;          // Position after line, program units
+        int feedLine;           // Line setting modal feed after this one, -1 - not set
+        qint8 motion;           // Modal motion mode after line, -1 - unknown or not G0-G3
+        bool isMove;
+        bool isRapid;
+        bool isAbsolute;
+        bool isMetric;
+        bool isPure;            // Motion, coordinate, feed, dwell and line number words only
+        bool travelWords;       // G0, coordinate and line number words only
+        bool hasMotion;         // Explicit motion mode word
+        bool hasAxes;           // Axis words are move target
+    };
+
+    struct Island
+    {
+        int travel;             // First travel line, consecutive travels are merged
+        int first;              // Content lines [first, last)
+        int last;
+        QPointF entry;          // Travel end
+        QPointF exit;           // Position after content
+        double entryZ;
+        double exitZ;
+        bool isMetric;
+        bool isMovable;
+        bool consumesFeed;      // Feed move relies on feed set before island
+    };
+
+    TimeEstimator::Machine m_machine;
+    std::vector<Line> m_lines;
+    double m_defaultSafeZ = qQNaN();
+
+    std::vector<Island> m_islands;
+    std::vector<int> m_order;   // Island indices in output order
+    double m_distanceBefore = 0;
+    double m_distanceAfter = 0;
+    double m_timeBefore = 0;
+    double m_timeAfter = 0;
+
+    void findIslands(double safeZ);
+    [[nodiscard]] bool isTravel(int line, double safeZ) const;
+    /// \brief reorder islands [first, last) starting from \a start, ending at \a end if it's given
+    [[nodiscard]] std::vector<int> solve(int first, int last, QPointF const &start, QPointF const *end,
+                                         Parallel::Progress *progress) const;
+    void measure();
+    /// \brief rapid move time, seconds, \a delta is in mm
+    [[nodiscard]] double travelTime(QPointF const &delta) const;
+    [[nodiscard]] QByteArray feedWord(int line) const { return line < 0 ? QByteArray() : m_lines[line].feed; }
+};
+
+#endif // RAPIDOPTIMIZER_H
@@ -0,0 +1,238 @@
+// This file is a part of "Candle" application.
+// Copyright 2015-2016 Hayrullin Denis Ravilevich
+
+#include "segmentmerger.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "gcodeparser.h"
+
+namespace
+{
+    // Longer runs are split, split points are kept
+    int const maxRangeLength = 65536;
+
+    bool isFinite(QVector3D const &point)
+    {
+        return !qIsNaN(point.x()) && !qIsNaN(point.y()) && !qIsNaN(point.z());
+    }
+
+    double distanceToSegment(QVector3D const &point, QVector3D const &start, QVector3D const &end)
+    {
+        double const dx = end.x() - start.x();
+        double const dy = end.y() - start.y();
+        double const dz = end.z() - start.z();
+        double px = point.x() - start.x();
+        double py = point.y() - start.y();
+        double pz = point.z() - start.z();
+
+        double const length2 = dx * dx + dy * dy + dz * dz;
+        if (length2 > 0) {
+            double const t = std::clamp((px * dx + py * dy + pz * dz) / length2, 0.0, 1.0);
+            px -= t * dx;
+            py -= t * dy;
+            pz -= t * dz;
+        }
+
+        return std::sqrt(px * px + py * py + pz * pz);
+    }
+}
+
+bool SegmentMerger::load(int count, std::function<QByteArray const &(int)> const &command,
+                         std::function<QByteArrayList const &(int)> const &args, Parallel::Progress *progress)
+{
+    m_lines.clear();
+    m_lines.reserve(count);
+    m_points.clear();
+    m_ranges.clear();
+    m_keep.clear();
+    m_runs = 0;
+    m_segmentsAfter = 0;
+    m_maxDeviation = 0;
+
+    GcodeParser parser;
+    parser.setInteractive(false);
+    double runSpeed = 0;
+    bool runMetric = true;
+    bool inRun = false;
+
+    auto const endRun = [&] {
+        if (!inRun) return;
+        m_ranges.back().last = static_cast<int>(m_points.size()) - 1;
+        inRun = false;
+    };
+
+    for (int i = 0; i < count; i++) {
+        if (progress && (i & 0xffff) == 0) {
+            if (progress->cancelled) return false;
+            progress->done = i;
+        }
+
+        // Classify words, mergeable line has optional G1, axis, feed and line number words only
+        Line line{command(i), {}, -1, false};
+        bool mergeable = !line.command.contains('(') && !line.command.contains(';');
+        bool axisWords = false;
+
+        for (auto const &arg : args(i)) {
+            char const letter = GcodePreprocessorUtils::toUpper(arg.at(0));
+            switch (letter) {
+            case 'G':
+                if (GcodePreprocessorUtils::AtoF(arg.data() + 1) == 1.0f) line.hasMotion = true;
+                else mergeable = false;
+                break;
+            case 'X': case 'Y': case 'Z':
+                line.words[letter - 'X'] = arg;
+                axisWords = true;
+                break;
+            case 'F': line.words[3] = arg; break;
+            case 'N': break;
+            default: mergeable = false; break;
+            }
+        }
+
+        // Update position, only last point segment is kept by parser
+        QVector3D const start = *parser.getCurrentPoint();
+
+        parser.trimPointSegments();
+        int const commandNumber = parser.getCommandNumber();
+        parser.addCommand(args(i));
+
+        if (mergeable && axisWords && parser.getCommandNumber() != commandNumber) {
+            PointSegment const &segment = parser.getPointSegmentList().back();
+            QVector3D const end = segment.point();
+
+            if (!segment.isFastTraverse() && !segment.isArc() && segment.isAbsolute()
+                    && isFinite(start) && isFinite(end)) {
+                bool const continues = inRun && segment.getSpeed() == runSpeed && segment.isMetric() == runMetric;
+
+                if (!continues) {
+                    endRun();
+                    m_points.push_back(start);
+                    m_ranges.push_back({static_cast<int>(m_points.size()) - 1, -1, segment.isMetric()});
+                    runSpeed = segment.getSpeed();
+                    runMetric = segment.isMetric();
+                    inRun = true;
+                    m_runs++;
+                } else if (static_cast<int>(m_points.size()) - 1 - m_ranges.back().first >= maxRangeLength) {
+                    m_ranges.back().last = static_cast<int>(m_points.size()) - 1;
+                    m_ranges.push_back({m_ranges.back().last, -1, runMetric});
+                }
+
+                line.point = static_cast<int>(m_points.size());
+                m_points.push_back(end);
+                m_lines.push_back(std::move(line));
+                continue;
+            }
+        }
+
+        endRun();
+        m_lines.push_back(std::move(line));
+    }
+    endRun();
+
+    return true;
+}
+
+bool SegmentMerger::simplify(double tolerance, Parallel::Progress *progress)
+{
+    // Range ends are kept, inner points are restored by simplification
+    m_keep.assign(m_points.size(), 0);
+    for (auto const &range : m_ranges) m_keep[range.first] = m_keep[range.last] = 1;
+
+    // Ranges are taken by workers one by one, they share end points only which are never changed
+    int const chunks = Parallel::chunkCount(m_points.size(), maxRangeLength);
+    int const rangeCount = static_cast<int>(m_ranges.size());
+    std::atomic<int> next{0};
+    std::vector<double> deviations(chunks, 0);
+
+    Parallel::forEachChunk(chunks, [&](int chunk) {
+        std::vector<std::pair<int, int>> stack;
+        for (int i = next++; i < rangeCount; i = next++) {
+            if (progress && progress->cancelled) return;
+
+            Range const &range = m_ranges[i];
+            deviations[chunk] = std::max(deviations[chunk], simplifyRange(range, tolerance, stack));
+            if (progress) progress->done += range.last - range.first;
+        }
+    });
+    if (progress && progress->cancelled) return false;
+
+    m_maxDeviation = *std::max_element(deviations.begin(), deviations.end());
+    m_segmentsAfter = static_cast<int>(std::count(m_keep.begin(), m_keep.end(), 1)) - m_runs;
+
+    return true;
+}
+
+double SegmentMerger::simplifyRange(Range const &range, double tolerance, std::vector<std::pair<int, int>> &stack)
+{
+    double const unitTolerance = range.isMetric ? tolerance : tolerance / 25.4;
+    double deviation = 0;
+
+    stack.clear();
+    stack.emplace_back(range.first, range.last);
+
+    while (!stack.empty()) {
+        auto const [first, last] = stack.back();
+        stack.pop_back();
+        if (last - first < 2) continue;
+
+        // Farthest point from chord is kept if it's out of tolerance
+        int farthest = -1;
+        double distance = 0;
+        for (int i = first + 1; i < last; i++) {
+            double const d = distanceToSegment(m_points[i], m_points[first], m_points[last]);
+            if (farthest < 0 || d > distance) {
+                farthest = i;
+                distance = d;
+            }
+        }
+
+        if (distance > unitTolerance) {
+            m_keep[farthest] = 1;
+            stack.emplace_back(first, farthest);
+            stack.emplace_back(farthest, last);
+        } else {
+            deviation = std::max(deviation, distance);
+        }
+    }
+
+    return range.isMetric ? deviation : deviation * 25.4;
+}
+
+QByteArrayList SegmentMerger::commands() const
+{
+    QByteArrayList result;
+    result.reserve(m_segmentsAfter + static_cast<int>(m_lines.size()) - segmentsBefore());
+
+    // Words of removed moves are carried to next kept move, run end is always kept
+    QByteArray pending[4];
+    bool pendingMotion = false;
+    bool hasPending = false;
+
+    for (auto const &line : m_lines) {
+        if (line.point >= 0 && !m_keep[line.point]) {
+            for (int i = 0; i < 4; i++) if (!line.words[i].isEmpty()) pending[i] = line.words[i];
+            pendingMotion = pendingMotion || line.hasMotion;
+            hasPending = true;
+            continue;
+        }
+
+        if (!hasPending) {
+            result.append(line.command);
+            continue;
+        }
+
+        QByteArray command = line.command;
+        if (pendingMotion && !line.hasMotion) command.prepend("G1");
+        for (int i = 0; i < 4; i++) if (line.words[i].isEmpty()) command += pending[i];
+        result.append(command);
+
+        for (auto &word : pending) word.clear();
+        pendingMotion = false;
+        hasPending = false;
+    }
+
+    return result;
+}
@@ -0,0 +1,71 @@
+// This file is a part of "Candle" application.
+// Copyright 2015-2016 Hayrullin Denis Ravilevich
+
+#ifndef SEGMENTMERGER_H
+#define SEGMENTMERGER_H
+
+#include <QByteArrayList>
+#include <QVector3D>
+#include <functional>
+#include <vector>
+
+#include "utils/parallel.h"
+
+/// \brief Merging of nearly collinear G1 moves by 3D Douglas-Peucker simplification
+/// Runs of absolute G1 moves with same feed and units having optional G1, axis, feed and line number words
+/// only are simplified, so feed, spindle and other modal changes always end run. Kept moves get axis, feed and
+/// motion words of removed moves they replace. Runs are split to independent ranges of limited length,
+/// ranges are simplified concurrently.
+class SegmentMerger
+{
+public:
+    SegmentMerger() = default;
+
+    /// \brief scan program, positions of moves and runs are stored
+    /// \return false if cancelled
+    bool load(int count, std::function<QByteArray const &(int)> const &command,
+              std::function<QByteArrayList const &(int)> const &args, Parallel::Progress *progress = nullptr);
+
+    /// \brief simplify runs, removed vertices are within \a tolerance mm of resulting path
+    /// \return false if cancelled
+    bool simplify(double tolerance, Parallel::Progress *progress = nullptr);
+
+    /// \brief program with merged moves
+    [[nodiscard]] QByteArrayList commands() const;
+
+    /// \brief G1 moves in runs before and after simplification
+    [[nodiscard]] int segmentsBefore() const { return static_cast<int>(m_points.size()) - m_runs; }
+    [[nodiscard]] int segmentsAfter() const { return m_segmentsAfter; }
+    /// \brief largest distance of removed vertex from resulting path, mm
+    [[nodiscard]] double maxDeviation() const { return m_maxDeviation; }
+
+private:
+    struct Line
+    {
+        QByteArray command;
+        QByteArray words[4];        // X, Y, Z and F words if present
+        int point;                  // Index of move end point, -1 - not in run
+        bool hasMotion;             // Explicit motion mode word
+    };
+
+    // Range of points simplified at once, ends are always kept
+    struct Range
+    {
+        int first;
+        int last;
+        bool isMetric;
+    };
+
+    std::vector<Line> m_lines;
+    std::vector<QVector3D> m_points;    // Program units, run start point followed by ends of its moves
+    std::vector<Range> m_ranges;
+    std::vector<char> m_keep;
+    int m_runs = 0;
+    int m_segmentsAfter = 0;
+    double m_maxDeviation = 0;
+
+    /// \return largest deviation of removed points
+    double simplifyRange(Range const &range, double tolerance, std::vector<std::pair<int, int>> &stack);
+};
+
+#endif // SEGMENTMERGER_H
@@ -0,0 +1,228 @@
+// This file is a part of "Candle" application.
+// Copyright 2015-2016 Hayrullin Denis Ravilevich
+
+#include "sendpreprocessor.h"
+
+#include <QByteArrayList>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "gcodepreprocessorutils.h"
+
+namespace
+{
+    struct Word
+    {
+        char letter;
+        double value;
+        QByteArray text;
+        bool keep;
+    };
+
+    // Shortest text of value: no leading or trailing zeros
+    QByteArray compact(double value, int decimals)
+    {
+        QByteArray result = GcodePreprocessorUtils::formatNumber(value, decimals);
+
+        if (result.startsWith("0.")) result.remove(0, 1);
+        else if (result.startsWith("-0.")) result.remove(1, 1);
+
+        return result;
+    }
+
+    double roundTo(double value, int decimals)
+    {
+        double const scale = std::pow(10.0, decimals);
+        return std::round(value * scale) / scale;
+    }
+
+    int decimalsOf(QByteArray const &text)
+    {
+        int const dot = text.indexOf('.');
+        return dot < 0 ? 0 : static_cast<int>(text.size()) - dot - 1;
+    }
+}
+
+int SendPreprocessor::decimals(QVector3D const &stepsPerMm)
+{
+    double const steps = std::max({stepsPerMm.x(), stepsPerMm.y(), stepsPerMm.z()});
+    if (!(steps > 0)) return 3;
+
+    return std::clamp(static_cast<int>(std::ceil(std::log10(steps) - 1e-9)), 0, 6);
+}
+
+void SendPreprocessor::reset()
+{
+    m_state = State();
+}
+
+void SendPreprocessor::invalidatePosition()
+{
+    std::fill(std::begin(m_state.position), std::end(m_state.position), qQNaN());
+}
+
+QByteArray SendPreprocessor::process(QByteArray const &command)
+{
+    if (!m_enabled) return command;
+
+    // System commands and block delete are passed as is
+    QByteArray const trimmed = command.trimmed();
+    if (trimmed.isEmpty() || trimmed.at(0) == '$' || trimmed.at(0) == '%' || trimmed.at(0) == '/') return trimmed;
+
+    QByteArrayList const args = GcodePreprocessorUtils::splitCommand(trimmed);
+    std::vector<Word> words;
+    words.reserve(args.size());
+
+    for (auto const &arg : args) {
+        bool ok;
+        QByteArray const text = arg.mid(1);
+        double const value = text.toDouble(&ok);
+
+        // Malformed command is left to controller
+        if (!ok) {
+            reset();
+            return trimmed;
+        }
+        words.push_back({GcodePreprocessorUtils::toUpper(arg.at(0)), value, text, true});
+    }
+
+    // Modal words, whole block is applied at once as controller does
+    State next = m_state;
+    bool axisCommand = false;       // Axis words aren't move target
+    bool positionLost = false;
+    bool programEnd = false;
+
+    auto const modal = [&](Word &word, int &state, int code) {
+        if (m_removeRedundant && state == code) word.keep = false;
+        state = code;
+    };
+
+    for (auto &word : words) {
+        int const code = qRound(word.value * 10);
+
+        if (word.letter == 'G') {
+            switch (code) {
+            case 0: case 10: case 20: case 30: modal(word, next.motion, code); break;
+            case 382: case 383: case 384: case 385: case 800:
+                next.motion = code;
+                break;
+            case 170: case 180: case 190: modal(word, next.plane, code); break;
+            case 200: case 210:
+                positionLost = positionLost || next.units != code;
+                modal(word, next.units, code);
+                break;
+            case 900: case 910: modal(word, next.distance, code); break;
+            case 930: case 940: modal(word, next.feedMode, code); break;
+            case 540: case 550: case 560: case 570: case 580: case 590:
+                positionLost = positionLost || next.wcs != code;
+                modal(word, next.wcs, code);
+                break;
+            case 100: case 280: case 300: case 530: case 920: case 431:
+                axisCommand = true;
+                positionLost = true;
+                break;
+            case 281: case 301: case 921: case 490:
+                positionLost = true;
+                break;
+            default:
+                break;
+            }
+        } else if (word.letter == 'M') {
+            switch (code) {
+            case 30: case 40: case 50: modal(word, next.spindle, code); break;
+            case 70: modal(word, next.mist, 1); break;
+            case 80: modal(word, next.flood, 1); break;
+            case 90:
+                if (m_removeRedundant && next.flood == 0 && next.mist == 0) word.keep = false;
+                next.flood = next.mist = 0;
+                break;
+            case 20: case 300:
+                programEnd = true;
+                break;
+            default:
+                break;
+            }
+        }
+    }
+
+    // Values, absolute linear move coordinates are rounded to controller resolution. Incremental words
+    // aren't, rounding error would add up along program
+    int const places = m_decimals + (next.units == 210 ? 0 : 1);
+    bool const linear = (next.motion == 0 || next.motion == 10) && !axisCommand;
+    bool const absolute = next.distance == 900;
+    bool const incremental = next.distance == 910;
+    bool const rounded = linear && absolute;
+    bool hasAxes = false;
+    double target[3] = {m_state.position[0], m_state.position[1], m_state.position[2]};
+
+    for (auto &word : words) {
+        switch (word.letter) {
+        case 'X': case 'Y': case 'Z': {
+            int const axis = word.letter - 'X';
+            hasAxes = true;
+
+            if (rounded) word.value = roundTo(word.value, places);
+            word.text = compact(word.value, rounded ? places : decimalsOf(word.text));
+
+            if (absolute) target[axis] = word.value;
+            else if (incremental) target[axis] += word.value;
+            else target[axis] = qQNaN();
+
+            if (m_removeRedundant && linear) {
+                if ((absolute && word.value == m_state.position[axis]) || (incremental && word.value == 0)) word.keep = false;
+            }
+            break;
+        }
+        case 'I': case 'J': case 'K': case 'R':
+            // Arc is checked by controller against start point, exact centre keeps radius error
+            // within rounding of start, so small arcs don't fail with error:33
+            word.text = compact(word.value, decimalsOf(word.text));
+            break;
+        case 'P':
+            word.text = compact(roundTo(word.value, places), places);
+            break;
+        case 'F':
+            word.value = roundTo(word.value, places);
+            word.text = compact(word.value, places);
+            if (m_removeRedundant && next.feedMode == 940 && m_state.feedMode == 940 && word.value == m_state.feed) word.keep = false;
+            next.feed = word.value;
+            break;
+        case 'S':
+            word.value = roundTo(word.value, places);
+            word.text = compact(word.value, places);
+            if (m_removeRedundant && word.value == m_state.speed) word.keep = false;
+            next.speed = word.value;
+            break;
+        case 'N':
+            word.keep = false;
+            break;
+        case 'G': case 'M': case 'T': case 'L':
+            word.text = compact(word.value, 1);
+            break;
+        default:
+            word.text = compact(word.value, decimalsOf(word.text));
+            break;
+        }
+    }
+
+    QByteArray result;
+    result.reserve(trimmed.size());
+    for (auto const &word : words) {
+        if (!word.keep) continue;
+        result.append(word.letter);
+        result.append(word.text);
+    }
+
+    // Update state, probing and unknown motion modes end at unknown position
+    m_state = next;
+    if (programEnd) {
+        reset();
+    } else if (positionLost || (hasAxes && next.motion != 0 && next.motion != 10 && next.motion != 20 && next.motion != 30)) {
+        invalidatePosition();
+    } else if (hasAxes) {
+        std::copy(std::begin(target), std::end(target), std::begin(m_state.position));
+    }
+
+    return result;
+}
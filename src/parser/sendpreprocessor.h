@@ -0,0 +1,63 @@
+// This file is a part of "Candle" application.
+// Copyright 2015-2016 Hayrullin Denis Ravilevich
+
+#ifndef SENDPREPROCESSOR_H
+#define SENDPREPROCESSOR_H
+
+#include <QByteArray>
+#include <QVector3D>
+
+/// \brief Byte minimizing rewrite of commands streamed to controller
+/// Comments, whitespace, line numbers, leading and trailing zeros are dropped, absolute linear move coordinates
+/// and values are rounded to controller resolution, arc words and incremental moves are kept exact. With
+/// redundant words removal modal words repeating known modal state, unchanged feed and spindle speed, and axis
+/// words not changing position of linear moves are dropped. State is learned from processed commands only, it's unknown after
+/// reset and must be invalidated when commands bypassing preprocessor change it.
+class SendPreprocessor
+{
+public:
+    SendPreprocessor() = default;
+
+    [[nodiscard]] bool isEnabled() const { return m_enabled; }
+    void setEnabled(bool enabled) { m_enabled = enabled; }
+    /// \brief decimal places of millimeter values, inch values get one more
+    [[nodiscard]] int decimals() const { return m_decimals; }
+    void setDecimals(int decimals) { m_decimals = decimals; }
+    [[nodiscard]] bool removeRedundant() const { return m_removeRedundant; }
+    void setRemoveRedundant(bool removeRedundant) { m_removeRedundant = removeRedundant; }
+
+    /// \brief decimal places resolving single step of axes with given steps/mm ($100-$102)
+    static int decimals(QVector3D const &stepsPerMm);
+
+    /// \brief forget modal state and position
+    void reset();
+    /// \brief compact command, commands should be processed in sending order
+    QByteArray process(QByteArray const &command);
+
+private:
+    // Modal G-codes are stored multiplied by 10, -1 - unknown
+    struct State
+    {
+        int motion = -1;
+        int plane = -1;
+        int units = -1;
+        int distance = -1;
+        int feedMode = -1;
+        int wcs = -1;
+        int spindle = -1;
+        int flood = -1;
+        int mist = -1;
+        double feed = qQNaN();
+        double speed = qQNaN();
+        double position[3] = {qQNaN(), qQNaN(), qQNaN()};
+    };
+
+    bool m_enabled = false;
+    int m_decimals = 3;
+    bool m_removeRedundant = true;
+    State m_state;
+
+    void invalidatePosition();
+};
+
+#endif // SENDPREPROCESSOR_H
@@ -0,0 +1,165 @@
+// This file is a part of "Candle" application.
+// Copyright 2015-2016 Hayrullin Denis Ravilevich
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "timeestimator.h"
+
+namespace
+{
+    constexpr double minimumFeedRate = 1.0 / 60;    // mm/sec, as GRBL MINIMUM_FEED_RATE
+    constexpr double straightJunctionSqr = std::numeric_limits<double>::max();
+}
+
+double TimeEstimator::limitByAxes(QVector3D const &unit, QVector3D const &limits) const
+{
+    // Largest value along unit vector, which doesn't exceed any axis limit
+    double result = std::numeric_limits<double>::max();
+    for (int i = 0; i < 3; i++) {
+        if (unit[i] != 0) result = std::min(result, static_cast<double>(limits[i]) / fabs(unit[i]));
+    }
+    return result;
+}
+
+double TimeEstimator::blockTime(Block const &block, double entrySqr, double exitSqr)
+{
+    double const entry = sqrt(entrySqr);
+    double const exit = sqrt(exitSqr);
+    double const a = block.acceleration;
+
+    // Trapezoid profile, triangle if nominal speed isn't reached
+    double const accelerationLength = (block.nominalSqr - entrySqr) / (2 * a);
+    double const decelerationLength = (block.nominalSqr - exitSqr) / (2 * a);
+    double const cruiseLength = block.length - accelerationLength - decelerationLength;
+
+    if (cruiseLength >= 0) {
+        double const nominal = sqrt(block.nominalSqr);
+        return (nominal - entry) / a + (nominal - exit) / a + cruiseLength / nominal;
+    }
+
+    double const peak = sqrt(std::max(std::max(entrySqr, exitSqr), (2 * a * block.length + entrySqr + exitSqr) / 2));
+    return (peak - entry) / a + (peak - exit) / a;
+}
+
+bool TimeEstimator::estimate(LineSegment::Container const &lines, LineSegment::ArcCenters const &arcs,
+                             std::atomic<bool> const *cancelled)
+{
+    m_timeIndex.clear();
+
+    QVector3D const maxRate = m_machine.maxRate / 60;
+    int const bufferSize = std::max(1, m_machine.plannerBlocks);
+
+    // Planner buffer, lookahead of executing block
+    std::vector<Block> buffer(bufferSize);
+    int head = 0;
+    int count = 0;
+    auto const at = [&](int i) -> Block & { return buffer[(head + i) % bufferSize]; };
+
+    QVector3D previousUnit;
+    double previousNominalSqr = 0;
+    bool hasPrevious = false;
+    double entrySqr = 0;
+    double feedTime = 0;
+    double rapidTime = 0;
+
+    // Executes first block of buffer
+    auto const execute = [&] {
+        Block const &block = at(0);
+
+        // Exit speed limited by junction speeds & stop at end of buffer: in squared speeds reverse pass
+        // is e[j] = min(max[j], e[j + 1] + 2 * a[j] * d[j]), so exit is minimum of max[k] + sum of 2ad before k
+        double exitSqr = entrySqr + 2 * block.acceleration * block.length;
+        double distance = 0;
+        for (int k = 1; k <= count && distance < exitSqr; k++) {
+            double const limit = k < count ? at(k).maxEntrySqr : 0;
+            exitSqr = std::min(exitSqr, limit + distance);
+            if (k < count) distance += 2 * at(k).acceleration * at(k).length;
+        }
+
+        (block.isRapid ? rapidTime : feedTime) += blockTime(block, entrySqr, exitSqr);
+        m_timeIndex.setLineEnd(block.line, feedTime, rapidTime);
+
+        entrySqr = exitSqr;
+        head = (head + 1) % bufferSize;
+        count--;
+    };
+
+    // Compensated point
+    auto const offset = [&](QVector3D point) {
+        if (m_heightMap) point.setZ(point.z() + m_heightMap->evaluate(point.x(), point.y()));
+        return point;
+    };
+
+    // Plans move as next block
+    auto const plan = [&](QVector3D const &start, QVector3D const &end, LineSegment const &segment) {
+        QVector3D const vector = offset(end) - offset(start);
+        double const length = vector.length();
+        if (qIsNaN(length) || length == 0) return;
+
+        QVector3D const unit = vector / length;
+
+        // Nominal speed, rapids go at lowest axis maximum
+        double nominal = limitByAxes(unit, maxRate);
+        if (!segment.isFastTraverse() && !qIsNaN(segment.getSpeed()) && segment.getSpeed() > 0)
+            nominal = std::min(nominal, segment.getSpeed() / 60);
+        nominal = std::max(nominal, minimumFeedRate);
+
+        Block block;
+        block.length = length;
+        block.nominalSqr = nominal * nominal;
+        block.acceleration = limitByAxes(unit, m_machine.acceleration);
+        block.line = segment.getLineNumber();
+        block.isRapid = segment.isFastTraverse();
+
+        // Junction speed by deviation from previous block
+        double junctionSqr = 0;
+        if (hasPrevious) {
+            double const cosTheta = -QVector3D::dotProduct(previousUnit, unit);
+            if (cosTheta > 0.999999) {
+                junctionSqr = 0;
+            } else if (cosTheta < -0.999999) {
+                junctionSqr = straightJunctionSqr;
+            } else {
+                QVector3D const junctionUnit = (unit - previousUnit).normalized();
+                double const junctionAcceleration = limitByAxes(junctionUnit, m_machine.acceleration);
+                double const sinThetaD2 = sqrt(0.5 * (1.0 - cosTheta));
+                junctionSqr = junctionAcceleration * m_machine.junctionDeviation * sinThetaD2 / (1.0 - sinThetaD2);
+            }
+        }
+        block.maxEntrySqr = std::min(junctionSqr, std::min(previousNominalSqr, block.nominalSqr));
+
+        previousUnit = unit;
+        previousNominalSqr = block.nominalSqr;
+        hasPrevious = true;
+
+        // Execute oldest block when buffer is full
+        if (count == bufferSize) execute();
+        at(count++) = block;
+    };
+
+    auto arc = arcs.begin();
+    for (int i = 0; i < static_cast<int>(lines.size()); i++) {
+        if (((i + 1) & 0xffff) == 0 && cancelled && *cancelled) return false;
+
+        LineSegment const &segment = lines.at(i);
+        if (!segment.isAnalyticArc()) {
+            plan(segment.getStart(), segment.getEnd(), segment);
+            continue;
+        }
+
+        // Arcs are split by controller arc tolerance, centres come in segments order
+        while (arc != arcs.end() && arc->segment < i) ++arc;
+        if (arc == arcs.end() || arc->segment != i) continue;
+
+        QVector3D start = segment.getStart();
+        for (auto const &end : segment.arcPoints(arc->center, m_machine.arcTolerance)) {
+            plan(start, end, segment);
+            start = end;
+        }
+    }
+
+    while (count > 0) execute();
+
+    return true;
+}
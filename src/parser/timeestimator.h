@@ -0,0 +1,69 @@
+// This file is a part of "Candle" application.
+// Copyright 2015-2016 Hayrullin Denis Ravilevich
+
+#ifndef TIMEESTIMATOR_H
+#define TIMEESTIMATOR_H
+
+#include <QVector3D>
+#include <atomic>
+#include <memory>
+
+#include "linesegment.h"
+#include "programtimeindex.h"
+#include "utils/heightmapsurface.h"
+
+/// \brief Job time estimation by replaying segments through model of GRBL planner
+/// Each segment is a planner block: nominal speed and acceleration are limited by axis maximums,
+/// junction speed by junction deviation. Exit speed of executing block is planned with lookahead of
+/// planner buffer only, last buffered block ends at full stop, as GRBL does when stream is slower than motion.
+/// Analytic arcs are split to segments by arc tolerance, as GRBL does. With heightmap set, segment points
+/// are offset in Z by surface, as compensated program is sent.
+class TimeEstimator
+{
+public:
+    struct Machine
+    {
+        QVector3D maxRate = QVector3D(500, 500, 500);       // $110-$112, mm/min
+        QVector3D acceleration = QVector3D(10, 10, 10);     // $120-$122, mm/sec^2
+        double junctionDeviation = 0.01;                    // $11, mm
+        double arcTolerance = 0.002;                        // $12, mm
+        int plannerBlocks = 15;                             // Usable planner buffer blocks
+    };
+
+    TimeEstimator() = default;
+    explicit TimeEstimator(Machine const &machine) : m_machine(machine) {}
+
+    [[nodiscard]] Machine const &machine() const { return m_machine; }
+    void setMachine(Machine const &machine) { m_machine = machine; }
+    void setHeightMap(std::shared_ptr<HeightMapSurface const> surface) { m_heightMap = std::move(surface); }
+
+    /// \brief simulate program motion at 100% overrides, \a arcs are centres of analytic arc segments
+    /// \return false if cancelled
+    bool estimate(LineSegment::Container const &lines, LineSegment::ArcCenters const &arcs = {},
+                  std::atomic<bool> const *cancelled = nullptr);
+
+    /// \brief program time, seconds
+    [[nodiscard]] double time() const { return m_timeIndex.total(); }
+    /// \brief times by segment line number
+    [[nodiscard]] ProgramTimeIndex const &timeIndex() const { return m_timeIndex; }
+
+private:
+    struct Block
+    {
+        double length;          // mm
+        double nominalSqr;      // (mm/sec)^2
+        double acceleration;    // mm/sec^2
+        double maxEntrySqr;     // Junction limit, (mm/sec)^2
+        int line;
+        bool isRapid;
+    };
+
+    Machine m_machine;
+    std::shared_ptr<HeightMapSurface const> m_heightMap;
+    ProgramTimeIndex m_timeIndex;
+
+    [[nodiscard]] double limitByAxes(QVector3D const &unit, QVector3D const &limits) const;
+    [[nodiscard]] static double blockTime(Block const &block, double entrySqr, double exitSqr);
+};
+
+#endif // TIMEESTIMATOR_H
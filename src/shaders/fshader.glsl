@@ -11,6 +11,7 @@ varying vec4 v_color;
 varying vec2 v_position;
 varying vec2 v_start;
 varying vec2 v_texture;
+varying float v_valid;
 
 uniform sampler2D texture;
 
@@ -21,6 +22,9 @@ bool isNan(float val)
 
 void main()
 {
+    // Primitives at not probed heightmap points aren't drawn, as their compensated Z is unknown
+    if (v_valid < 0.999) discard;
+
     // Draw dash lines
     if (!isNan(v_start.x)) {
         vec2 sub = v_position - v_start;
@@ -7,6 +7,16 @@ precision mediump float;
 uniform mat4 mvp_matrix;
 uniform mat4 mv_matrix;
 
+// Heightmap base points packed to rgb, alpha is 0 for not probed points,
+// rect: origin & cell size, grid: columns, rows, minimum & range of heights
+uniform sampler2D height_map;
+uniform highp vec4 height_map_rect;
+uniform highp vec4 height_map_grid;
+uniform int height_map_enabled;
+
+// Vertex color by Z: minimum, maximum, enabled
+uniform highp vec3 z_color;
+
 attribute vec4 a_position;
 attribute vec4 a_color;
 attribute vec4 a_start;
@@ -15,33 +25,87 @@ varying vec4 v_color;
 varying vec2 v_position;
 varying vec2 v_start;
 varying vec2 v_texture;
+varying float v_valid;
+
+// Cleared if interpolation used not probed point, as NaN of HeightMapSurface
+bool heightMapValid;
 
 bool isNan(float val)
 {
     return (val > 65535.0);
 }
 
+highp float heightMapPoint(highp vec2 cell)
+{
+    // Edge points are repeated
+    highp vec2 coord = (clamp(cell, vec2(0.0), height_map_grid.xy - 1.0) + 0.5) / height_map_grid.xy;
+    highp vec4 texel = texture2DLod(height_map, coord, 0.0);
+    if (texel.a < 0.5) heightMapValid = false;
+
+    return height_map_grid.z + height_map_grid.w * dot(texel.rgb, vec3(16711680.0, 65280.0, 255.0) / 16777215.0);
+}
+
+highp float cubicInterpolate(highp vec4 p, highp float t)
+{
+    return p.y + 0.5 * t * (p.z - p.x + t * (2.0 * p.x - 5.0 * p.y + 4.0 * p.z - p.w + t * (3.0 * (p.y - p.z) + p.w - p.x)));
+}
+
+highp float heightMapRow(highp vec2 cell, highp float t)
+{
+    return cubicInterpolate(vec4(heightMapPoint(cell + vec2(-1.0, 0.0)), heightMapPoint(cell),
+                                 heightMapPoint(cell + vec2(1.0, 0.0)), heightMapPoint(cell + vec2(2.0, 0.0))), t);
+}
+
+// Same bicubic interpolation as HeightMapSurface
+highp float heightMapOffset(highp vec2 position)
+{
+    highp vec2 uv = (position - height_map_rect.xy) / height_map_rect.zw;
+    highp vec2 cell = clamp(floor(uv), vec2(0.0), height_map_grid.xy - 2.0);
+    highp vec2 t = uv - cell;
+
+    return cubicInterpolate(vec4(heightMapRow(cell + vec2(0.0, -1.0), t.x), heightMapRow(cell, t.x),
+                                 heightMapRow(cell + vec2(0.0, 1.0), t.x), heightMapRow(cell + vec2(0.0, 2.0), t.x)), t.y);
+}
+
 void main()
 {
+    highp vec4 position = a_position;
+    highp vec4 start = a_start;
+
+    // Offset Z by heightmap
+    heightMapValid = true;
+    if (height_map_enabled != 0) {
+        position.z += heightMapOffset(position.xy);
+        if (!isNan(start.x) && !isNan(start.y)) start.z += heightMapOffset(start.xy);
+    }
+    v_valid = heightMapValid ? 1.0 : 0.0;
+
     // Calculate interpolated vertex position & line start point
-    v_position = (mv_matrix * a_position).xy;
+    v_position = (mv_matrix * position).xy;
 
-    if (!isNan(a_start.x) && !isNan(a_start.y)) {
-        v_start = (mv_matrix * a_start).xy;
+    if (!isNan(start.x) && !isNan(start.y)) {
+        v_start = (mv_matrix * start).xy;
         v_texture = vec2(65536.0, 0);
     } else {
         // v_start.x should be Nan to draw solid lines
-        v_start = a_start.xy;
+        v_start = start.xy;
 
         // set texture coord
-        v_texture = a_start.yz;
+        v_texture = start.yz;
 
         // set point size
-        if (isNan(a_start.y) && !isNan(a_start.z)) gl_PointSize = a_start.z;
+        if (isNan(start.y) && !isNan(start.z)) gl_PointSize = start.z;
     }
 
     // Calculate vertex position in screen space
-    gl_Position = mvp_matrix * a_position;
+    gl_Position = mvp_matrix * position;
 
-    v_color = a_color;
+    if (z_color.z != 0.0) {
+        // Hue from blue at minimum to red at maximum, same as QColor::setHsvF(0.67 * t, 1, 1)
+        highp float range = z_color.y - z_color.x;
+        float hue = range > 0.0 ? 0.67 * (z_color.y - a_position.z) / range : 0.0;
+        v_color = vec4(clamp(abs(mod(hue * 6.0 + vec3(0.0, 4.0, 2.0), 6.0) - 3.0) - 1.0, 0.0, 1.0), a_color.a);
+    } else {
+        v_color = a_color;
+    }
 }
@@ -131,3 +131,10 @@ GCodeTableModel::Container &GCodeTableModel::data()
 {
     return m_data;
 }
+
+void GCodeTableModel::emitDataChanged(int firstRow, int lastRow, int column)
+{
+    if (firstRow > lastRow) return;
+
+    emit dataChanged(index(firstRow, column), index(lastRow, column));
+}
@@ -47,6 +47,8 @@ public:
     Qt::ItemFlags flags(const QModelIndex &index) const override;
 
     Container &data();
+    /// \brief notify views of rows column changed directly through data()
+    void emitDataChanged(int firstRow, int lastRow, int column);
 
 signals:
 
@@ -1,6 +1,7 @@
 // This file is a part of "Candle" application.
 // Copyright 2015-2016 Hayrullin Denis Ravilevich
 
+#include <algorithm>
 #include "heightmaptablemodel.h"
 
 HeightMapTableModel::HeightMapTableModel(QObject *parent) : QAbstractTableModel(parent)
@@ -23,6 +24,31 @@ void HeightMapTableModel::resize(int cols, int rows)
     }
 }
 
+void HeightMapTableModel::setValues(int cols, int rows, std::vector<double> const &values)
+{
+    beginResetModel();
+
+    m_data.resize(rows);
+    for (int i = 0; i < rows; i++) {
+        QVector<double> &row = m_data[i];
+        row.resize(cols);
+        std::copy(values.begin() + static_cast<std::size_t>(i) * cols,
+                  values.begin() + static_cast<std::size_t>(i + 1) * cols, row.begin());
+    }
+    if (m_data.isEmpty()) m_data.append(QVector<double>());
+
+    endResetModel();
+}
+
+std::vector<double> HeightMapTableModel::values() const
+{
+    std::vector<double> values;
+    values.reserve(static_cast<std::size_t>(rowCount()) * columnCount());
+    for (auto const &row : m_data) values.insert(values.end(), row.begin(), row.end());
+
+    return values;
+}
+
 QVariant HeightMapTableModel::data(const QModelIndex &index, int role) const
 {
     if (!index.isValid()) return QVariant();
@@ -6,6 +6,7 @@
 
 #include <QObject>
 #include <QAbstractTableModel>
+#include <vector>
 
 class HeightMapTableModel : public QAbstractTableModel
 {
@@ -14,6 +15,9 @@ public:
     explicit HeightMapTableModel(QObject *parent = 0);
 
     void resize(int cols, int rows);
+    /// \brief replace all points with one model reset, values are row by row as for Qt::UserRole
+    void setValues(int cols, int rows, std::vector<double> const &values);
+    std::vector<double> values() const;
 
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
     bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole);
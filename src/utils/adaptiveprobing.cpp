@@ -0,0 +1,133 @@
+// This file is a part of "Candle" application.
+// Copyright 2015-2016 Hayrullin Denis Ravilevich
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "adaptiveprobing.h"
+#include "heightmapsurface.h"
+
+AdaptiveProbing::AdaptiveProbing(QRectF const &borderRect, int columns, int rows, double tolerance)
+    : m_borderRect(borderRect), m_columns(columns), m_rows(rows), m_stride(coarseStride(columns, rows)), m_tolerance(tolerance)
+{
+    std::size_t const count = static_cast<std::size_t>(std::max(0, columns * rows));
+    m_values.assign(count, std::numeric_limits<double>::quiet_NaN());
+    m_residuals.assign(count, 0);
+    m_probed.assign(count, 0);
+
+    // Whole coarse grid
+    for (int row = 0; row < m_rows; row += m_stride) {
+        int const first = static_cast<int>(m_points.size());
+        for (int column = 0; column < m_columns; column += m_stride) m_points.emplace_back(column, row);
+        if ((row / m_stride) % 2) std::reverse(m_points.begin() + first, m_points.end());
+    }
+}
+
+int AdaptiveProbing::coarseStride(int columns, int rows)
+{
+    int stride = 1;
+    while ((columns - 1) % (stride * 2) == 0 && (rows - 1) % (stride * 2) == 0
+           && (columns - 1) / (stride * 2) >= 3 && (rows - 1) / (stride * 2) >= 3) stride *= 2;
+
+    return stride;
+}
+
+void AdaptiveProbing::setValue(QPoint const &point, double value)
+{
+    int const i = index(point);
+
+    // Queued points hold prediction until probed
+    m_residuals[i] = qIsNaN(m_values[i]) ? 0 : value - m_values[i];
+    m_values[i] = value;
+    m_probed[i] = 1;
+}
+
+int AdaptiveProbing::probedCount() const
+{
+    return static_cast<int>(std::count(m_probed.begin(), m_probed.end(), 1));
+}
+
+bool AdaptiveProbing::refine()
+{
+    m_points.clear();
+
+    while (m_stride > 1) {
+        if (refineLevel()) return true;
+    }
+
+    return false;
+}
+
+double AdaptiveProbing::bend(int column, int row, int stride) const
+{
+    // Deviation of surface from plane over one cell, by second differences of level points
+    double result = 0;
+
+    if (column >= stride && column + stride < m_columns) {
+        result = std::max(result, fabs(m_values[index(column - stride, row)] - 2 * m_values[index(column, row)]
+                                       + m_values[index(column + stride, row)]) / 8);
+    }
+    if (row >= stride && row + stride < m_rows) {
+        result = std::max(result, fabs(m_values[index(column, row - stride)] - 2 * m_values[index(column, row)]
+                                       + m_values[index(column, row + stride)]) / 8);
+    }
+
+    return result;
+}
+
+bool AdaptiveProbing::refineLevel()
+{
+    int const stride = m_stride;
+    int const half = stride / 2;
+    int const levelColumns = (m_columns - 1) / stride + 1;
+    int const levelRows = (m_rows - 1) / stride + 1;
+
+    // Surface of current level points, all of them are known
+    std::vector<double> levelValues;
+    levelValues.reserve(static_cast<std::size_t>(levelColumns) * levelRows);
+    for (int row = 0; row < m_rows; row += stride)
+        for (int column = 0; column < m_columns; column += stride) levelValues.push_back(m_values[index(column, row)]);
+
+    HeightMapSurface const surface(m_borderRect, levelColumns, levelRows, std::move(levelValues));
+
+    // Mark points of refined cells
+    std::vector<char> queued(m_values.size(), 0);
+    for (int row = 0; row + stride < m_rows; row += stride) {
+        for (int column = 0; column + stride < m_columns; column += stride) {
+            double deviation = 0;
+            for (int r = row; r <= row + stride; r += stride) {
+                for (int c = column; c <= column + stride; c += stride) {
+                    deviation = std::max({ deviation, bend(c, r, stride), fabs(m_residuals[index(c, r)]) });
+                }
+            }
+            if (deviation <= m_tolerance) continue;
+
+            queued[index(column + half, row)] = 1;
+            queued[index(column, row + half)] = 1;
+            queued[index(column + half, row + half)] = 1;
+            queued[index(column + stride, row + half)] = 1;
+            queued[index(column + half, row + stride)] = 1;
+        }
+    }
+
+    // Predict new level points, queued ones keep prediction to calculate residual
+    double const stepX = m_columns > 1 ? m_borderRect.width() / (m_columns - 1) : 0;
+    double const stepY = m_rows > 1 ? m_borderRect.height() / (m_rows - 1) : 0;
+
+    for (int row = 0, rowIndex = 0; row < m_rows; row += half, rowIndex++) {
+        int const first = static_cast<int>(m_points.size());
+        for (int column = 0; column < m_columns; column += half) {
+            if (row % stride == 0 && column % stride == 0) continue;
+
+            int const i = index(column, row);
+            m_values[i] = surface.evaluate(m_borderRect.x() + stepX * column, m_borderRect.y() + stepY * row);
+            m_residuals[i] = 0;
+            if (queued[i]) m_points.emplace_back(column, row);
+        }
+        if (rowIndex % 2) std::reverse(m_points.begin() + first, m_points.end());
+    }
+
+    m_stride = half;
+
+    return !m_points.empty();
+}
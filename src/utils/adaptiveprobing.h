@@ -0,0 +1,65 @@
+// This file is a part of "Candle" application.
+// Copyright 2015-2016 Hayrullin Denis Ravilevich
+
+#ifndef ADAPTIVEPROBING_H
+#define ADAPTIVEPROBING_H
+
+#include <QPoint>
+#include <QRectF>
+#include <vector>
+
+/// \brief Coarse to fine probing of heightmap grid
+/// Probing starts with every stride-th point of the grid. Each refinement halves the stride and
+/// probes new points only in cells where the surface bends or previous probes missed
+/// prediction by more than tolerance, other points are filled with bicubic prediction of
+/// coarser level. Probed points form quadtree-like non-uniform samples, while values always
+/// cover the whole grid, so heightmap surface is evaluated the same way as for uniform probing.
+class AdaptiveProbing
+{
+public:
+    AdaptiveProbing() = default;
+    AdaptiveProbing(QRectF const &borderRect, int columns, int rows, double tolerance);
+
+    /// \brief largest power of 2 stride splitting grid to coarse grid of at least 4x4 points
+    static int coarseStride(int columns, int rows);
+
+    [[nodiscard]] bool isValid() const { return m_columns > 1 && m_rows > 1; }
+    [[nodiscard]] int columns() const { return m_columns; }
+    [[nodiscard]] int rows() const { return m_rows; }
+    [[nodiscard]] int stride() const { return m_stride; }
+    /// \brief maximum expected deviation of predicted points, used for next refinements
+    [[nodiscard]] double tolerance() const { return m_tolerance; }
+    void setTolerance(double tolerance) { m_tolerance = tolerance; }
+
+    /// \brief grid points (x - column, y - row) to probe on current level, serpentine order
+    [[nodiscard]] std::vector<QPoint> const &points() const { return m_points; }
+    void setValue(QPoint const &point, double value);
+    [[nodiscard]] bool isProbed(QPoint const &point) const { return m_probed[index(point)] != 0; }
+    [[nodiscard]] int probedCount() const;
+
+    /// \brief go to next level after current points are probed, levels without points to probe are skipped
+    /// \return false if grid is complete
+    bool refine();
+
+    /// \brief probed and predicted values, row by row
+    [[nodiscard]] std::vector<double> const &values() const { return m_values; }
+
+private:
+    QRectF m_borderRect;
+    int m_columns = 0;
+    int m_rows = 0;
+    int m_stride = 1;
+    double m_tolerance = 0;
+
+    std::vector<double> m_values;
+    std::vector<double> m_residuals; // Probed value minus prediction, 0 if not predicted
+    std::vector<char> m_probed;
+    std::vector<QPoint> m_points;
+
+    [[nodiscard]] int index(int column, int row) const { return row * m_columns + column; }
+    [[nodiscard]] int index(QPoint const &point) const { return index(point.x(), point.y()); }
+    [[nodiscard]] double bend(int column, int row, int stride) const;
+    bool refineLevel();
+};
+
+#endif // ADAPTIVEPROBING_H
@@ -0,0 +1,224 @@
+// This file is a part of "Candle" application.
+// Copyright 2015-2016 Hayrullin Denis Ravilevich
+
+#include <QFile>
+#include <QLocale>
+#include <QSaveFile>
+#include <QStringList>
+#include <QTextStream>
+#include <QtEndian>
+#include <cstring>
+#include <limits>
+#include "heightmapfile.h"
+
+namespace
+{
+    char const signature[8] = { 'C', 'N', 'D', 'L', 'H', 'M', 'A', 'P' };
+    constexpr int headerSize = 88; // Keeps values 8 bytes aligned
+
+    // Sequential little-endian header fields
+    class HeaderWriter
+    {
+    public:
+        explicit HeaderWriter(uchar *data) : m_data(data) {}
+
+        void putUInt32(quint32 value) { qToLittleEndian(value, m_data); m_data += 4; }
+        void putInt32(qint32 value) { qToLittleEndian(value, m_data); m_data += 4; }
+        void putDouble(double value)
+        {
+            quint64 bits;
+            memcpy(&bits, &value, 8);
+            qToLittleEndian(bits, m_data);
+            m_data += 8;
+        }
+
+    private:
+        uchar *m_data;
+    };
+
+    class HeaderReader
+    {
+    public:
+        explicit HeaderReader(uchar const *data) : m_data(data) {}
+
+        quint32 uint32() { quint32 value = qFromLittleEndian<quint32>(m_data); m_data += 4; return value; }
+        qint32 int32() { qint32 value = qFromLittleEndian<qint32>(m_data); m_data += 4; return value; }
+        double float64()
+        {
+            quint64 const bits = qFromLittleEndian<quint64>(m_data);
+            m_data += 8;
+            double value;
+            memcpy(&value, &bits, 8);
+            return value;
+        }
+
+    private:
+        uchar const *m_data;
+    };
+}
+
+bool HeightMapFile::save(QString const &fileName, Format format) const
+{
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) return false;
+
+    if (format == Text) {
+        auto const number = [](double value) { return QString::number(value, 'g', QLocale::FloatingPointShortest); };
+
+        QTextStream textStream(&file);
+        textStream << number(borderRect.x()) << ";" << number(borderRect.y()) << ";"
+                   << number(borderRect.width()) << ";" << number(borderRect.height()) << '\n';
+        textStream << columns << ";" << rows << ";" << number(zBottom) << ";" << number(zTop) << '\n';
+        textStream << interpolationType << ";" << interpolationPointsX << ";" << interpolationPointsY << '\n';
+
+        for (int i = 0; i < rows; i++) {
+            for (int j = 0; j < columns; j++) {
+                textStream << number(values[i * columns + j]) << ((j == columns - 1) ? "" : ";");
+            }
+            textStream << '\n';
+        }
+        textStream.flush();
+
+        return file.commit();
+    }
+
+    uchar header[headerSize] = {};
+    memcpy(header, signature, sizeof(signature));
+
+    HeaderWriter writer(header + sizeof(signature));
+    writer.putUInt32(version);
+    writer.putUInt32(headerSize);
+    writer.putDouble(borderRect.x());
+    writer.putDouble(borderRect.y());
+    writer.putDouble(borderRect.width());
+    writer.putDouble(borderRect.height());
+    writer.putInt32(columns);
+    writer.putInt32(rows);
+    writer.putDouble(zBottom);
+    writer.putDouble(zTop);
+    writer.putInt32(interpolationType);
+    writer.putInt32(interpolationPointsX);
+    writer.putInt32(interpolationPointsY);
+
+    file.write(reinterpret_cast<char const*>(header), headerSize);
+
+    // Raw grid
+    qint64 const bytes = static_cast<qint64>(values.size()) * sizeof(double);
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    file.write(reinterpret_cast<char const*>(values.data()), bytes);
+#else
+    QByteArray grid(bytes, Qt::Uninitialized);
+    for (std::size_t i = 0; i < values.size(); i++) {
+        quint64 bits;
+        memcpy(&bits, &values[i], 8);
+        qToLittleEndian(bits, grid.data() + i * 8);
+    }
+    file.write(grid);
+#endif
+
+    return file.commit();
+}
+
+bool HeightMapFile::load(QString const &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) return false;
+
+    char fileSignature[sizeof(signature)] = {};
+    if (file.peek(fileSignature, sizeof(signature)) != sizeof(signature)
+            || memcmp(fileSignature, signature, sizeof(signature)) != 0) {
+        file.close();
+        return loadText(fileName);
+    }
+
+    // Values are copied straight from mapped file
+    qint64 const size = file.size();
+    uchar *data = file.map(0, size);
+    if (data) {
+        bool const result = loadBinary(data, size);
+        file.unmap(data);
+        return result;
+    }
+
+    QByteArray const bytes = file.readAll();
+    return loadBinary(reinterpret_cast<uchar const*>(bytes.constData()), bytes.size());
+}
+
+bool HeightMapFile::loadBinary(uchar const *data, qint64 size)
+{
+    if (size < static_cast<qint64>(sizeof(signature)) + 8) return false;
+
+    HeaderReader reader(data + sizeof(signature));
+    quint32 const fileVersion = reader.uint32();
+    quint32 const fileHeaderSize = reader.uint32();
+
+    // Newer versions may only append header fields
+    if (fileVersion < 1 || fileHeaderSize < headerSize || fileHeaderSize > size) return false;
+
+    double const x = reader.float64();
+    double const y = reader.float64();
+    double const width = reader.float64();
+    double const height = reader.float64();
+    borderRect = QRectF(x, y, width, height);
+    columns = reader.int32();
+    rows = reader.int32();
+    zBottom = reader.float64();
+    zTop = reader.float64();
+    interpolationType = reader.int32();
+    interpolationPointsX = reader.int32();
+    interpolationPointsY = reader.int32();
+
+    if (columns < 0 || rows < 0 || columns > maxGridPoints || rows > maxGridPoints) return false;
+
+    // Header fields are untrusted, grid must fit file without overflowing byte count
+    std::size_t const count = static_cast<std::size_t>(columns) * rows;
+    if (count > static_cast<quint64>(size - fileHeaderSize) / sizeof(double)) return false;
+
+    values.resize(count);
+    uchar const *grid = data + fileHeaderSize;
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    memcpy(values.data(), grid, count * sizeof(double));
+#else
+    for (std::size_t i = 0; i < count; i++) {
+        quint64 const bits = qFromLittleEndian<quint64>(grid + i * 8);
+        memcpy(&values[i], &bits, 8);
+    }
+#endif
+
+    return true;
+}
+
+bool HeightMapFile::loadText(QString const &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) return false;
+
+    QTextStream textStream(&file);
+
+    QStringList list = textStream.readLine().split(";");
+    if (list.size() < 4) return false;
+    borderRect = QRectF(list[0].toDouble(), list[1].toDouble(), list[2].toDouble(), list[3].toDouble());
+
+    list = textStream.readLine().split(";");
+    if (list.size() < 4) return false;
+    columns = list[0].toDouble();
+    rows = list[1].toDouble();
+    zBottom = list[2].toDouble();
+    zTop = list[3].toDouble();
+
+    list = textStream.readLine().split(";");
+    if (list.size() < 3) return false;
+    interpolationType = list[0].toInt();
+    interpolationPointsX = list[1].toDouble();
+    interpolationPointsY = list[2].toDouble();
+
+    if (columns < 0 || rows < 0 || columns > maxGridPoints || rows > maxGridPoints) return false;
+
+    values.assign(static_cast<std::size_t>(columns) * rows, std::numeric_limits<double>::quiet_NaN());
+    for (int i = 0; i < rows; i++) {
+        QStringList const row = textStream.readLine().split(";");
+        for (int j = 0; j < columns && j < row.size(); j++) values[i * columns + j] = row[j].toDouble();
+    }
+
+    return true;
+}
@@ -0,0 +1,47 @@
+// This file is a part of "Candle" application.
+// Copyright 2015-2016 Hayrullin Denis Ravilevich
+
+#ifndef HEIGHTMAPFILE_H
+#define HEIGHTMAPFILE_H
+
+#include <QRectF>
+#include <QString>
+#include <vector>
+
+/// \brief Heightmap file contents
+/// Binary file: 88 bytes little-endian header, then rows * columns float64 values row by row.
+/// Values start at header size offset, so grid can be read directly from mapped file.
+/// Header: "CNDLHMAP", version, header size (uint32), border x, y, width, height (float64),
+/// columns, rows (int32), probe Z bottom, top (float64), interpolation type, points X, Y (int32).
+/// Text files of previous versions are detected by missing signature and imported.
+struct HeightMapFile
+{
+    enum Format {
+        Binary,
+        Text
+    };
+
+    static constexpr quint32 version = 1;
+    /// \brief grid points per axis, files with larger grid are treated as damaged
+    static constexpr int maxGridPoints = 10000;
+
+    QRectF borderRect;
+    int columns = 0;
+    int rows = 0;
+    double zBottom = 0;
+    double zTop = 0;
+    int interpolationType = 0;
+    int interpolationPointsX = 0;
+    int interpolationPointsY = 0;
+    std::vector<double> values; // Row index grows along Y, same as HeightMapTableModel user role
+
+    bool save(QString const &fileName, Format format = Binary) const;
+    /// \return false if file can't be read or is damaged, contents are undefined then
+    bool load(QString const &fileName);
+
+private:
+    bool loadBinary(uchar const *data, qint64 size);
+    bool loadText(QString const &fileName);
+};
+
+#endif // HEIGHTMAPFILE_H
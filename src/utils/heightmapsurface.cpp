@@ -0,0 +1,142 @@
+// This file is a part of "Candle" application.
+// Copyright 2015-2016 Hayrullin Denis Ravilevich
+
+#include <QAbstractTableModel>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "heightmapsurface.h"
+
+namespace
+{
+    // Catmull-Rom cubic as polynomial, same as Interpolation::cubicInterpolate:
+    // a[i] = sum(M[i][k] * p[k]), f(t) = a0 + a1 * t + a2 * t^2 + a3 * t^3
+    constexpr double M[4][4] = {
+        {  0.0,  1.0,  0.0,  0.0 },
+        { -0.5,  0.0,  0.5,  0.0 },
+        {  1.0, -2.5,  2.0, -0.5 },
+        { -0.5,  1.5, -1.5,  0.5 }
+    };
+}
+
+HeightMapSurface::HeightMapSurface(QRectF const &borderRect, int columns, int rows, std::vector<double> values)
+    : m_borderRect(borderRect), m_columns(columns), m_rows(rows), m_values(std::move(values))
+{
+    m_values.resize(static_cast<std::size_t>(std::max(0, columns * rows)), std::numeric_limits<double>::quiet_NaN());
+    m_unprobed = static_cast<int>(std::count_if(m_values.begin(), m_values.end(), [](double value) { return std::isnan(value); }));
+    updateCoefficients();
+}
+
+HeightMapSurface::HeightMapSurface(QRectF const &borderRect, QAbstractTableModel const *model)
+{
+    int const columns = model ? model->columnCount() : 0;
+    int const rows = model ? model->rowCount() : 0;
+
+    std::vector<double> values;
+    values.reserve(static_cast<std::size_t>(columns * rows));
+    for (int row = 0; row < rows; row++) for (int column = 0; column < columns; column++)
+        values.push_back(model->data(model->index(row, column), Qt::UserRole).toDouble());
+
+    *this = HeightMapSurface(borderRect, columns, rows, std::move(values));
+}
+
+void HeightMapSurface::setValue(int column, int row, double value)
+{
+    double &current = m_values[row * m_columns + column];
+    m_unprobed += static_cast<int>(std::isnan(value)) - static_cast<int>(std::isnan(current));
+    current = value;
+
+    // Point is used by cells of 4x4 neighbourhood
+    for (int r = std::max(0, row - 2); r <= std::min(m_rows - 2, row + 1); r++)
+        for (int c = std::max(0, column - 2); c <= std::min(m_columns - 2, column + 1); c++)
+            updateCoefficients(c, r);
+}
+
+double HeightMapSurface::point(int column, int row) const
+{
+    return m_values[std::clamp(row, 0, m_rows - 1) * m_columns + std::clamp(column, 0, m_columns - 1)];
+}
+
+void HeightMapSurface::updateCoefficients()
+{
+    m_stepX = m_columns > 1 ? m_borderRect.width() / (m_columns - 1) : 0;
+    m_stepY = m_rows > 1 ? m_borderRect.height() / (m_rows - 1) : 0;
+
+    if (!isValid()) {
+        m_coefficients.clear();
+        return;
+    }
+
+    m_coefficients.assign(static_cast<std::size_t>((m_columns - 1) * (m_rows - 1)) * 16, 0);
+    for (int row = 0; row < m_rows - 1; row++)
+        for (int column = 0; column < m_columns - 1; column++)
+            updateCoefficients(column, row);
+}
+
+void HeightMapSurface::updateCoefficients(int column, int row)
+{
+    // 16 base points, edge points are repeated
+    double p[4][4];
+    for (int j = 0; j < 4; j++) for (int i = 0; i < 4; i++) p[j][i] = point(column + i - 1, row + j - 1);
+
+    // C = M * P * M^T
+    double mp[4][4];
+    for (int j = 0; j < 4; j++) for (int i = 0; i < 4; i++)
+        mp[j][i] = M[j][0] * p[0][i] + M[j][1] * p[1][i] + M[j][2] * p[2][i] + M[j][3] * p[3][i];
+
+    double *c = &m_coefficients[static_cast<std::size_t>(row * (m_columns - 1) + column) * 16];
+    for (int j = 0; j < 4; j++) for (int i = 0; i < 4; i++)
+        c[j * 4 + i] = mp[j][0] * M[i][0] + mp[j][1] * M[i][1] + mp[j][2] * M[i][2] + mp[j][3] * M[i][3];
+}
+
+double HeightMapSurface::evaluate(double x, double y) const
+{
+    double z;
+    evaluate(&x, &y, &z, 1);
+    return z;
+}
+
+void HeightMapSurface::evaluate(double const *xs, double const *ys, double *out, std::size_t count) const
+{
+    if (!isValid()) {
+        std::fill(out, out + count, std::numeric_limits<double>::quiet_NaN());
+        return;
+    }
+
+    double const originX = m_borderRect.x();
+    double const originY = m_borderRect.y();
+    double const scaleX = 1.0 / m_stepX;
+    double const scaleY = 1.0 / m_stepY;
+    double const maxX = m_columns - 2;
+    double const maxY = m_rows - 2;
+    int const cellsX = m_columns - 1;
+    double const *coefficients = m_coefficients.data();
+
+    for (std::size_t k = 0; k < count; k++) {
+        double const u = (xs[k] - originX) * scaleX;
+        double const v = (ys[k] - originY) * scaleY;
+
+        // Cell index, clamped without branches, NaN coordinates go to first cell
+        double const cx = std::max(0.0, std::min(std::trunc(u), maxX));
+        double const cy = std::max(0.0, std::min(std::trunc(v), maxY));
+        double const tx = u - cx;
+        double const ty = v - cy;
+
+        double const *c = coefficients + (static_cast<std::size_t>(cy) * cellsX + static_cast<std::size_t>(cx)) * 16;
+
+        // Horner by x for each power of y, then by y
+        double const r0 = c[0] + tx * (c[1] + tx * (c[2] + tx * c[3]));
+        double const r1 = c[4] + tx * (c[5] + tx * (c[6] + tx * c[7]));
+        double const r2 = c[8] + tx * (c[9] + tx * (c[10] + tx * c[11]));
+        double const r3 = c[12] + tx * (c[13] + tx * (c[14] + tx * c[15]));
+
+        out[k] = r0 + ty * (r1 + ty * (r2 + ty * r3));
+    }
+}
+
+void HeightMapSurface::evaluate(std::vector<double> const &xs, std::vector<double> const &ys, std::vector<double> &out) const
+{
+    std::size_t const count = std::min(xs.size(), ys.size());
+    out.resize(count);
+    evaluate(xs.data(), ys.data(), out.data(), count);
+}
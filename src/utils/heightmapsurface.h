@@ -0,0 +1,54 @@
+// This file is a part of "Candle" application.
+// Copyright 2015-2016 Hayrullin Denis Ravilevich
+
+#ifndef HEIGHTMAPSURFACE_H
+#define HEIGHTMAPSURFACE_H
+
+#include <QRectF>
+#include <cstddef>
+#include <vector>
+
+class QAbstractTableModel;
+
+/// \brief Bicubic heightmap surface with contiguous storage
+/// Base points are stored row by row, row index grows along Y. Each grid cell keeps
+/// 16 precomputed polynomial coefficients, so evaluation doesn't touch neighbour points.
+class HeightMapSurface
+{
+public:
+    HeightMapSurface() = default;
+    HeightMapSurface(QRectF const &borderRect, int columns, int rows, std::vector<double> values);
+    /// \brief surface of model base points read with Qt::UserRole
+    HeightMapSurface(QRectF const &borderRect, QAbstractTableModel const *model);
+
+    [[nodiscard]] bool isValid() const { return m_columns > 1 && m_rows > 1; }
+    /// \brief all base points are probed, evaluation near unprobed point returns NaN
+    [[nodiscard]] bool isComplete() const { return m_unprobed == 0; }
+    [[nodiscard]] QRectF borderRect() const { return m_borderRect; }
+    [[nodiscard]] int columns() const { return m_columns; }
+    [[nodiscard]] int rows() const { return m_rows; }
+    [[nodiscard]] double value(int column, int row) const { return m_values[row * m_columns + column]; }
+    void setValue(int column, int row, double value);
+
+    /// \brief interpolated height at x, y, points outside border are extrapolated from edge cells
+    [[nodiscard]] double evaluate(double x, double y) const;
+    /// \brief out[i] = evaluate(xs[i], ys[i]) for i in [0, count)
+    void evaluate(double const *xs, double const *ys, double *out, std::size_t count) const;
+    void evaluate(std::vector<double> const &xs, std::vector<double> const &ys, std::vector<double> &out) const;
+
+private:
+    QRectF m_borderRect;
+    int m_columns = 0;
+    int m_rows = 0;
+    int m_unprobed = 0;
+    double m_stepX = 0;
+    double m_stepY = 0;
+    std::vector<double> m_values;
+    std::vector<double> m_coefficients; // 16 per cell, c[j * 4 + i] is coefficient of x^i * y^j
+
+    void updateCoefficients(int column, int row);
+    void updateCoefficients();
+    [[nodiscard]] double point(int column, int row) const;
+};
+
+#endif // HEIGHTMAPSURFACE_H
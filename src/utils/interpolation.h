@@ -6,7 +6,6 @@
 
 #include <QVector>
 #include <QRectF>
-#include <QAbstractTableModel>
 #include <cmath>
 
 namespace Interpolation
@@ -27,51 +26,6 @@ namespace Interpolation
         };
         return cubicInterpolate(arr, y);
     }
-
-    constexpr double bicubicInterpolate(QRectF borderRect, QAbstractTableModel *basePoints, double x, double y)
-    {
-        // Setup grid
-        int gridPointsX = basePoints->columnCount();
-        int gridPointsY = basePoints->rowCount();
-
-        double gridStepX = gridPointsX > 1 ? borderRect.width() / (gridPointsX - 1) : 0;
-        double gridStepY = gridPointsY > 1 ? borderRect.height() / (gridPointsY - 1) : 0;
-
-        // Get 16 points
-        x -= borderRect.x();
-        y -= borderRect.y();
-
-        int ix = trunc(x / gridStepX);
-        int iy = trunc(y / gridStepY);
-
-        if (ix > basePoints->columnCount() - 2) ix = basePoints->columnCount() - 2;
-        if (iy > basePoints->rowCount() - 2) iy = basePoints->rowCount() - 2;
-
-        double p[4][4]{};
-
-        p[0][0] = basePoints->data(basePoints->index((iy > 0 ? iy - 1 : iy), (ix > 0 ? ix - 1 : ix)), Qt::UserRole).toDouble();
-        p[0][1] = basePoints->data(basePoints->index((iy > 0 ? iy - 1 : iy), ix), Qt::UserRole).toDouble();
-        p[0][2] = basePoints->data(basePoints->index((iy > 0 ? iy - 1 : iy), ix + 1), Qt::UserRole).toDouble();
-        p[0][3] = basePoints->data(basePoints->index((iy > 0 ? iy - 1 : iy), (ix < basePoints->columnCount() - 2 ? ix + 2: ix + 1)), Qt::UserRole).toDouble();
-
-        p[1][0] = basePoints->data(basePoints->index(iy, ix > 0 ? ix - 1 : ix), Qt::UserRole).toDouble();
-        p[1][1] = basePoints->data(basePoints->index(iy, ix), Qt::UserRole).toDouble();
-        p[1][2] = basePoints->data(basePoints->index(iy, ix + 1), Qt::UserRole).toDouble();
-        p[1][3] = basePoints->data(basePoints->index(iy, ix < basePoints->columnCount() - 2 ? ix + 2: ix + 1), Qt::UserRole).toDouble();
-
-        p[2][0] = basePoints->data(basePoints->index(iy + 1, ix > 0 ? ix - 1 : ix), Qt::UserRole).toDouble();
-        p[2][1] = basePoints->data(basePoints->index(iy + 1, ix), Qt::UserRole).toDouble();
-        p[2][2] = basePoints->data(basePoints->index(iy + 1, ix + 1), Qt::UserRole).toDouble();
-        p[2][3] = basePoints->data(basePoints->index(iy + 1, ix < basePoints->columnCount() - 2 ? ix + 2 : ix + 1), Qt::UserRole).toDouble();
-
-        p[3][0] = basePoints->data(basePoints->index(iy < basePoints->rowCount() - 2 ? iy + 2 : iy + 1, ix > 0 ? ix - 1 : ix), Qt::UserRole).toDouble();
-        p[3][1] = basePoints->data(basePoints->index(iy < basePoints->rowCount() - 2 ? iy + 2 : iy + 1, ix), Qt::UserRole).toDouble();
-        p[3][2] = basePoints->data(basePoints->index(iy < basePoints->rowCount() - 2 ? iy + 2 : iy + 1, ix + 1), Qt::UserRole).toDouble();
-        p[3][3] = basePoints->data(basePoints->index(iy < basePoints->rowCount() - 2 ? iy + 2 : iy + 1, ix < basePoints->columnCount() - 2 ? ix + 2 : ix + 1), Qt::UserRole).toDouble();
-
-        // Interpolate
-        return Interpolation::bicubicInterpolate(p, x / gridStepX - ix, y / gridStepY - iy);
-    }
 }
 
 #endif // INTERPOLATION
@@ -0,0 +1,72 @@
+// This file is a part of "Candle" application.
+// Copyright 2015-2016 Hayrullin Denis Ravilevich
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace Parallel
+{
+    /// \brief progress and cancellation shared by workers and waiting thread
+    struct Progress
+    {
+        std::atomic<long long> done{0};
+        std::atomic<bool> cancelled{false};
+    };
+
+    /// \brief upper limit of worker threads, 0 - use all hardware threads
+    inline int &maxThreads()
+    {
+        static int value = 0;
+        return value;
+    }
+
+    inline int threadCount()
+    {
+        int threads = maxThreads() > 0 ? maxThreads() : static_cast<int>(std::thread::hardware_concurrency());
+        return std::max(1, threads);
+    }
+
+    /// \brief number of chunks \a count items should be split to, so no chunk is smaller than \a minChunk
+    inline int chunkCount(std::size_t count, std::size_t minChunk = 65536)
+    {
+        std::size_t const chunks = count / std::max<std::size_t>(1, minChunk);
+        return static_cast<int>(std::clamp<std::size_t>(chunks, 1, static_cast<std::size_t>(threadCount())));
+    }
+
+    /// \brief split [first, last) to \a chunks contiguous ranges of nearly equal size
+    /// \return chunks + 1 ascending boundaries, range i is [result[i], result[i + 1])
+    inline std::vector<int> splitRange(int first, int last, int chunks)
+    {
+        std::vector<int> bounds;
+        bounds.reserve(chunks + 1);
+        long long const count = std::max(0, last - first);
+        for (int i = 0; i <= chunks; i++) bounds.push_back(first + static_cast<int>(count * i / chunks));
+        return bounds;
+    }
+
+    /// \brief call fn(i) for every i in [0, chunks) concurrently, first chunk runs on calling thread
+    /// Returns after all chunks are done. fn must not throw.
+    template<typename Fn>
+    void forEachChunk(int chunks, Fn &&fn)
+    {
+        if (chunks <= 0) return;
+        if (chunks == 1) {
+            fn(0);
+            return;
+        }
+
+        std::vector<std::thread> workers;
+        workers.reserve(chunks - 1);
+        for (int i = 1; i < chunks; i++) workers.emplace_back([&fn, i] { fn(i); });
+        fn(0);
+        for (auto &worker : workers) worker.join();
+    }
+}
+
+#endif // PARALLEL_H
@@ -48,12 +48,18 @@ GLWidget::GLWidget(QWidget *parent) : QOpenGLWidget(parent), m_shaderProgram(0)
 
     m_vsync = false;
     m_targetFps = 60;
+    m_idleFps = 1;
 
     QTimer::singleShot(1000, this, SLOT(onFramesTimer()));
 }
 
 GLWidget::~GLWidget()
 {
+    makeCurrent();
+    delete m_overlayTexture;
+    if (m_overlayBlitter.isCreated()) m_overlayBlitter.destroy();
+    doneCurrent();
+
     delete m_shaderProgram;
 }
 
@@ -64,6 +70,8 @@ double GLWidget::calculateVolume(QVector3D size) {
 void GLWidget::addDrawable(ShaderDrawable *drawable)
 {
     m_shaderDrawables.append(drawable);
+    m_needsRepaint = true;
+    m_viewScaleChanged = true;
 }
 
 void GLWidget::fitDrawable(ShaderDrawable *drawable)
@@ -101,6 +109,8 @@ void GLWidget::fitDrawable(ShaderDrawable *drawable)
         m_xSize = 0;
         m_ySize = 0;
         m_zSize = 0;
+
+        invalidateOverlay();
     }
 
     m_xPan = 0;
@@ -123,6 +133,8 @@ void GLWidget::updateExtremes(ShaderDrawable *drawable)
     m_xSize = m_xMax - m_xMin;
     m_ySize = m_yMax - m_yMin;
     m_zSize = m_zMax - m_zMin;
+
+    invalidateOverlay();
 }
 
 bool GLWidget::antialiasing() const
@@ -132,11 +144,14 @@ bool GLWidget::antialiasing() const
 
 void GLWidget::setAntialiasing(bool antialiasing)
 {
+    if (m_antialiasing != antialiasing) m_needsRepaint = true;
     m_antialiasing = antialiasing;
 }
 
 void GLWidget::onFramesTimer()
 {
+    // Counter is shown on next repaint, idle scene is not repainted for it
+    if (m_fps != m_frames) m_overlayChanged = true;
     m_fps = m_frames;
     m_frames = 0;
 
@@ -145,7 +160,7 @@ void GLWidget::onFramesTimer()
 
 void GLWidget::viewAnimation()
 {
-    double t = (double)m_animationFrame++ / (m_fps * 0.2);
+    double t = (double)m_animationFrame++ / (m_targetFps * 0.2);
 
     if (t >= 1) stopViewAnimation();
 
@@ -165,6 +180,7 @@ QString GLWidget::pinState() const
 
 void GLWidget::setPinState(const QString &pinState)
 {
+    if (m_pinState != pinState) invalidateOverlay();
     m_pinState = pinState;
 }
 
@@ -175,6 +191,7 @@ QString GLWidget::speedState() const
 
 void GLWidget::setSpeedState(const QString &additionalStatus)
 {
+    if (m_speedState != additionalStatus) invalidateOverlay();
     m_speedState = additionalStatus;
 }
 
@@ -195,6 +212,7 @@ bool GLWidget::msaa() const
 
 void GLWidget::setMsaa(bool msaa)
 {
+    if (m_msaa != msaa) m_needsRepaint = true;
     m_msaa = msaa;
 }
 
@@ -205,6 +223,7 @@ bool GLWidget::zBuffer() const
 
 void GLWidget::setZBuffer(bool zBuffer)
 {
+    if (m_zBuffer != zBuffer) m_needsRepaint = true;
     m_zBuffer = zBuffer;
 }
 
@@ -215,6 +234,7 @@ QString GLWidget::bufferState() const
 
 void GLWidget::setBufferState(const QString &bufferState)
 {
+    if (m_bufferState != bufferState) invalidateOverlay();
     m_bufferState = bufferState;
 }
 
@@ -225,6 +245,7 @@ QString GLWidget::parserStatus() const
 
 void GLWidget::setParserStatus(const QString &parserStatus)
 {
+    if (m_parserStatus != parserStatus) invalidateOverlay();
     m_parserStatus = parserStatus;
 }
 
@@ -236,6 +257,7 @@ double GLWidget::lineWidth() const
 
 void GLWidget::setLineWidth(double lineWidth)
 {
+    if (m_lineWidth != lineWidth) m_needsRepaint = true;
     m_lineWidth = lineWidth;
 }
 
@@ -289,6 +311,7 @@ QColor GLWidget::colorText() const
 
 void GLWidget::setColorText(const QColor &colorText)
 {
+    if (m_colorText != colorText) invalidateOverlay();
     m_colorText = colorText;
 }
 
@@ -299,6 +322,7 @@ QColor GLWidget::colorBackground() const
 
 void GLWidget::setColorBackground(const QColor &colorBackground)
 {
+    if (m_colorBackground != colorBackground) m_needsRepaint = true;
     m_colorBackground = colorBackground;
 }
 
@@ -308,7 +332,45 @@ void GLWidget::setFps(int fps)
     if (fps <= 0) return;
     m_targetFps = fps;
     m_timerPaint.stop();
-    m_timerPaint.start(m_vsync ? 0 : 1000 / fps, Qt::PreciseTimer, this);
+    // Timer only polls for scene changes, vsync limits frame rate of actual repaints
+    m_timerPaint.start(1000 / fps, Qt::PreciseTimer, this);
+}
+
+int GLWidget::idleFps() const
+{
+    return m_idleFps;
+}
+
+void GLWidget::setIdleFps(int idleFps)
+{
+    m_idleFps = qMax(0, idleFps);
+}
+
+int GLWidget::framesRendered() const
+{
+    return m_framesRendered;
+}
+
+int GLWidget::framesSkipped() const
+{
+    return m_framesSkipped;
+}
+
+void GLWidget::invalidateOverlay()
+{
+    m_overlayChanged = true;
+    m_needsRepaint = true;
+}
+
+bool GLWidget::sceneChanged() const
+{
+    if (m_needsRepaint || m_animateView) return true;
+
+    foreach (ShaderDrawable *drawable, m_shaderDrawables)
+        if (drawable->needsRepaint()) return true;
+
+    // Fall back to low idle rate
+    return m_idleFps > 0 && (!m_lastPaint.isValid() || m_lastPaint.elapsed() >= 1000 / m_idleFps);
 }
 
 QTime GLWidget::estimatedTime() const
@@ -318,9 +380,21 @@ QTime GLWidget::estimatedTime() const
 
 void GLWidget::setEstimatedTime(const QTime &estimatedTime)
 {
+    if (m_estimatedTime != estimatedTime) invalidateOverlay();
     m_estimatedTime = estimatedTime;
 }
 
+QTime GLWidget::remainingTime() const
+{
+    return m_remainingTime;
+}
+
+void GLWidget::setRemainingTime(const QTime &remainingTime)
+{
+    if (m_remainingTime != remainingTime) invalidateOverlay();
+    m_remainingTime = remainingTime;
+}
+
 QTime GLWidget::spendTime() const
 {
     return m_spendTime;
@@ -328,6 +402,7 @@ QTime GLWidget::spendTime() const
 
 void GLWidget::setSpendTime(const QTime &spendTime)
 {
+    if (m_spendTime != spendTime) invalidateOverlay();
     m_spendTime = spendTime;
 }
 
@@ -348,17 +423,24 @@ void GLWidget::initializeGL()
         m_shaderProgram->link();
         qDebug() << "shader program created";
     }
+
+    // Create overlay blitter
+    m_overlayBlitter.create();
 }
 
 void GLWidget::resizeGL(int width, int height)
 {
     glViewport(0, 0, width, height);
     updateProjection();
+    invalidateOverlay();
     emit resized();
 }
 
 void GLWidget::updateProjection()
 {
+    m_needsRepaint = true;
+    m_viewScaleChanged = true;
+
     // Reset projection
     m_projectionMatrix.setToIdentity();
 
@@ -368,6 +450,9 @@ void GLWidget::updateProjection()
 
 void GLWidget::updateView()
 {
+    m_needsRepaint = true;
+    m_viewScaleChanged = true;
+
     // Set view matrix
     m_viewMatrix.setToIdentity();
 
@@ -388,8 +473,21 @@ void GLWidget::updateView()
     m_viewMatrix.rotate(-90, 1.0, 0.0, 0.0);
 }
 
+ViewScale GLWidget::viewScale() const
+{
+    // Frustum is 1 unit high at near plane depth of 2, scene is scaled by zoom
+    ViewScale scale;
+    scale.view = m_viewMatrix;
+    scale.nearDepth = 2;
+    if (height() > 0) scale.depthScale = 1.0 / (2 * height() * m_zoom);
+
+    return scale;
+}
+
 void GLWidget::paintGL()
 {
+    m_needsRepaint = false;
+    m_lastPaint.start();
 
     // Segment counter
     int vertices = 0;
@@ -423,6 +521,13 @@ void GLWidget::paintGL()
         m_shaderProgram->setUniformValue("mvp_matrix", m_projectionMatrix * m_viewMatrix);
         m_shaderProgram->setUniformValue("mv_matrix", m_viewMatrix);
 
+        // Drawables adapting geometry to screen are rescaled before update
+        if (m_viewScaleChanged) {
+            m_viewScaleChanged = false;
+            ViewScale const scale = viewScale();
+            foreach (ShaderDrawable *drawable, m_shaderDrawables) drawable->setViewScale(scale);
+        }
+
         // Update geometries in current opengl context
         foreach (ShaderDrawable *drawable, m_shaderDrawables)
             if (drawable->needsUpdateGeometry()) drawable->updateGeometry(m_shaderProgram);
@@ -442,7 +547,44 @@ void GLWidget::paintGL()
     glDisable(GL_LINE_SMOOTH);
     glDisable(GL_BLEND);
 
-    QPainter painter(this);
+    if (vertices != m_vertices) {
+        m_vertices = vertices;
+        m_overlayChanged = true;
+    }
+    if (m_overlayChanged) updateOverlay();
+
+    if (m_overlayTexture && m_overlayBlitter.isCreated()) {
+        // Overlay pixels are premultiplied
+        glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+        glEnable(GL_BLEND);
+
+        m_overlayBlitter.bind();
+        m_overlayBlitter.blit(m_overlayTexture->textureId(), QMatrix4x4(), QOpenGLTextureBlitter::OriginTopLeft);
+        m_overlayBlitter.release();
+
+        glDisable(GL_BLEND);
+    }
+
+    m_frames++;
+    m_framesRendered++;
+}
+
+void GLWidget::updateOverlay()
+{
+    m_overlayChanged = false;
+
+    qreal const ratio = devicePixelRatioF();
+    QSize const size = this->size() * ratio;
+    if (size.isEmpty()) return;
+
+    if (m_overlayImage.size() != size) {
+        m_overlayImage = QImage(size, QImage::Format_RGBA8888_Premultiplied);
+        m_overlayImage.setDevicePixelRatio(ratio);
+    }
+    m_overlayImage.fill(Qt::transparent);
+
+    QPainter painter(&m_overlayImage);
+    painter.setFont(font());
     QPen pen(m_colorText);
     painter.setPen(pen);
 
@@ -460,18 +602,37 @@ void GLWidget::paintGL()
     painter.drawText(QPoint(x, fm.height() * 2 + 10), m_speedState);
     painter.drawText(QPoint(x, fm.height() * 3 + 10), m_pinState);
 
-    QString str = QString(tr("Vertices: %1")).arg(vertices);
+    QString str = QString(tr("Vertices: %1")).arg(m_vertices);
     painter.drawText(QPoint(this->width() - fm.horizontalAdvance(str) - 10, y + 30), str);
-    str = QString("FPS: %1").arg(m_fps);
+    // Rendered frames versus paint timer ticks skipped on unchanged scene
+    str = QString(tr("Frames: %1 / skipped: %2  FPS: %3")).arg(m_framesRendered).arg(m_framesSkipped).arg(m_fps);
     painter.drawText(QPoint(this->width() - fm.horizontalAdvance(str) - 10, y + 45), str);
 
     str = m_spendTime.toString("hh:mm:ss") + " / " + m_estimatedTime.toString("hh:mm:ss");
+    if (m_remainingTime.isValid()) str = QString(tr("Left: %1")).arg(m_remainingTime.toString("hh:mm:ss")) + "  " + str;
     painter.drawText(QPoint(this->width() - fm.horizontalAdvance(str) - 10, y), str);
 
     str = m_bufferState;
     painter.drawText(QPoint(this->width() - fm.horizontalAdvance(str) - 10, y + 15), str);
 
-    m_frames++;
+    painter.end();
+
+    // Upload to texture
+    if (m_overlayTexture && (m_overlayTexture->width() != size.width() || m_overlayTexture->height() != size.height())) {
+        delete m_overlayTexture;
+        m_overlayTexture = nullptr;
+    }
+    if (!m_overlayTexture) {
+        m_overlayTexture = new QOpenGLTexture(QOpenGLTexture::Target2D);
+        m_overlayTexture->setFormat(QOpenGLTexture::RGBA8_UNorm);
+        m_overlayTexture->setSize(size.width(), size.height());
+        m_overlayTexture->setMipLevels(1);
+        m_overlayTexture->setMinMagFilters(QOpenGLTexture::Nearest, QOpenGLTexture::Nearest);
+        m_overlayTexture->allocateStorage(QOpenGLTexture::RGBA, QOpenGLTexture::UInt8);
+    }
+
+    // Storage is kept while size is same, pixels only are uploaded
+    m_overlayTexture->setData(QOpenGLTexture::RGBA, QOpenGLTexture::UInt8, m_overlayImage.constBits());
 }
 
 void GLWidget::mousePressEvent(QMouseEvent *event)
@@ -532,7 +693,7 @@ void GLWidget::timerEvent(QTimerEvent *te)
     if (te->timerId() == m_timerPaint.timerId()) {
         if (m_animateView)
             viewAnimation();
-        update();
+        if (sceneChanged()) update(); else m_framesSkipped++;
     } else {
         QOpenGLWidget::timerEvent(te);
     }
@@ -5,9 +5,11 @@
 #define GLWIDGET_H
 
 #include <QOpenGLWidget>
+#include <QOpenGLTextureBlitter>
 
 #include <QTimer>
 #include <QTime>
+#include <QElapsedTimer>
 #include "drawers/shaderdrawable.h"
 
 class GLWidget : public QOpenGLWidget, protected QOpenGLFunctions
@@ -28,6 +30,9 @@ public:
     QTime estimatedTime() const;
     void setEstimatedTime(const QTime &estimatedTime);
 
+    QTime remainingTime() const;
+    void setRemainingTime(const QTime &remainingTime);
+
     double lineWidth() const;
     void setLineWidth(double lineWidth);
 
@@ -39,6 +44,13 @@ public:
     int fps();
     void setFps(int fps);
 
+    int idleFps() const;
+    void setIdleFps(int idleFps);
+
+    /// \brief frames painted and paint timer ticks skipped as scene was unchanged, since start
+    int framesRendered() const;
+    int framesSkipped() const;
+
     QString parserStatus() const;
     void setParserStatus(const QString &parserStatus);
 
@@ -96,9 +108,17 @@ private:
     int m_frames = 0;
     int m_fps = 0;
     int m_targetFps;
+    int m_idleFps;
+    bool m_needsRepaint = true;
+    bool m_viewScaleChanged = true;
+    int m_framesRendered = 0;
+    int m_framesSkipped = 0;
+    QElapsedTimer m_lastPaint;
+    int m_vertices = 0;
     int m_animationFrame;
     QTime m_spendTime;
     QTime m_estimatedTime;
+    QTime m_remainingTime;
     QBasicTimer m_timerPaint;
     double m_xRotTarget, m_yRotTarget;
     double m_xRotStored, m_yRotStored;
@@ -112,6 +132,9 @@ private:
     static double calculateVolume(QVector3D size);
     void beginViewAnimation();
     void stopViewAnimation();
+    bool sceneChanged() const;
+    void invalidateOverlay();
+    void updateOverlay();
 
     QList<ShaderDrawable*> m_shaderDrawables;
     QOpenGLShaderProgram *m_shaderProgram;
@@ -121,11 +144,18 @@ private:
     QColor m_colorBackground;
     QColor m_colorText;
 
+    // 2D overlay, redrawn to texture only on its data change
+    QImage m_overlayImage;
+    QOpenGLTexture *m_overlayTexture = nullptr;
+    QOpenGLTextureBlitter m_overlayBlitter;
+    bool m_overlayChanged = true;
+
 protected:
     void initializeGL() override;
     void resizeGL(int width, int height) override;
     void updateProjection();
     void updateView();
+    ViewScale viewScale() const;
     void paintGL() override;
 
     void mousePressEvent(QMouseEvent *event) override;